@@ -0,0 +1,160 @@
+#ifndef AGGREGATE_INDEX_H
+#define AGGREGATE_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tableLayout.h"
+
+/**
+ * Per-block aggregates of every column (the .aggregates file), laid out for range aggregates in O(log n)
+ *
+ * For every column, over the blocks of the data file:
+ *   prefix_sums[b]: the sum of the column over blocks 0 to b - 1 (number_of_blocks + 1 entries), so the
+ *                   sum over blocks [first, last] is prefix_sums[last + 1] - prefix_sums[first]
+ *   min_tree, max_tree: segment trees of the block minima and maxima, 2 * tree_leaves entries each,
+ *                   node 1 is the root, the children of node i are 2i and 2i + 1, block b is leaf tree_leaves + b
+ *
+ * A range of whole blocks is then answered without reading them; only the partial blocks at both ends
+ * of a key range are scanned. Sums are modulo 2^64 (exact as long as the sum over the table fits).
+ *
+ * File: struct aggregate_file_header, then for every column prefix_sums, min_tree and max_tree.
+ */
+#define AGGREGATE_MAGIC 0x58444e4952474741ULL   // "AGGRINDX"
+#define AGGREGATE_VERSION 1
+
+struct aggregate_file_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t col_count;
+    uint64_t number_of_blocks;
+    uint64_t tree_leaves;           // smallest power of two >= number_of_blocks
+};
+
+// SUM, MIN, MAX and COUNT of a column over a set of tuples (AVG is sum / count)
+struct column_aggregates
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+static inline void column_aggregates_init(struct column_aggregates *aggregates)
+{
+    aggregates->count = 0;
+    aggregates->sum = 0;
+    aggregates->min = UINT64_MAX;
+    aggregates->max = 0;
+}
+
+static inline void column_aggregates_merge(struct column_aggregates *into, const struct column_aggregates *other)
+{
+    into->count += other->count;
+    into->sum += other->sum;
+    into->min = other->min < into->min ? other->min : into->min;
+    into->max = other->max > into->max ? other->max : into->max;
+}
+
+static inline uint64_t aggregate_tree_leaves(uint64_t number_of_blocks)
+{
+    uint64_t leaves = 1;
+    while (leaves < number_of_blocks)
+        leaves *= 2;
+    return leaves;
+}
+
+// Entries (uint64_t) of the section of one column
+static inline size_t aggregate_column_size(const struct aggregate_file_header *header)
+{
+    return header->number_of_blocks + 1 + 4 * header->tree_leaves;
+}
+
+static inline size_t aggregate_file_size_in_bytes(const struct aggregate_file_header *header)
+{
+    return sizeof(*header) + header->col_count * aggregate_column_size(header) * sizeof(uint64_t);
+}
+
+// The prefix sums of "column" in a file (or a buffer laid out like one); min_tree and max_tree follow
+static inline uint64_t *aggregate_prefix_sums(const struct aggregate_file_header *header, int column)
+{
+    return (uint64_t *)(header + 1) + column * aggregate_column_size(header);
+}
+
+static inline uint64_t *aggregate_min_tree(const struct aggregate_file_header *header, int column)
+{
+    return aggregate_prefix_sums(header, column) + header->number_of_blocks + 1;
+}
+
+static inline uint64_t *aggregate_max_tree(const struct aggregate_file_header *header, int column)
+{
+    return aggregate_min_tree(header, column) + 2 * header->tree_leaves;
+}
+
+// Byte offsets of the sections of "column" in the file
+static inline uint64_t aggregate_prefix_sums_offset(const struct aggregate_file_header *header, int column)
+{
+    return sizeof(*header) + column * aggregate_column_size(header) * sizeof(uint64_t);
+}
+
+static inline uint64_t aggregate_min_tree_offset(const struct aggregate_file_header *header, int column)
+{
+    return aggregate_prefix_sums_offset(header, column) + (header->number_of_blocks + 1) * sizeof(uint64_t);
+}
+
+static inline uint64_t aggregate_max_tree_offset(const struct aggregate_file_header *header, int column)
+{
+    return aggregate_min_tree_offset(header, column) + 2 * header->tree_leaves * sizeof(uint64_t);
+}
+
+/**
+ * Inner nodes of both trees from the level below (the unused leaves must hold UINT64_MAX and 0): node i
+ * of a run of number_of_nodes nodes gets the minimum and maximum of its children 2i and 2i + 1 of the run below
+ */
+static inline void aggregate_build_tree_level(const uint64_t *min_children, const uint64_t *max_children, uint64_t *min_nodes, uint64_t *max_nodes, size_t number_of_nodes)
+{
+    for (size_t i = 0; i < number_of_nodes; i++)
+    {
+        min_nodes[i] = min_children[2 * i] < min_children[2 * i + 1] ? min_children[2 * i] : min_children[2 * i + 1];
+        max_nodes[i] = max_children[2 * i] > max_children[2 * i + 1] ? max_children[2 * i] : max_children[2 * i + 1];
+    }
+}
+
+/**
+ * Aggregates of "column" over the whole blocks [first_block, last_block]: one subtraction for the sum,
+ * a bottom-up walk of about 2 log2(number_of_blocks) nodes for the minimum and the maximum
+ */
+static inline void aggregate_blocks(const struct aggregate_file_header *header, int column, uint64_t first_block, uint64_t last_block, struct column_aggregates *aggregates)
+{
+    column_aggregates_init(aggregates);
+    if (last_block < first_block)
+        return;
+    const uint64_t *prefix_sums = aggregate_prefix_sums(header, column);
+    const uint64_t *min_tree = aggregate_min_tree(header, column);
+    const uint64_t *max_tree = aggregate_max_tree(header, column);
+
+    uint64_t end_tuple = (last_block + 1) * TUPLES_PER_BLOCK < header->row_count ? (last_block + 1) * TUPLES_PER_BLOCK : header->row_count;
+    aggregates->count = end_tuple - first_block * TUPLES_PER_BLOCK;
+    aggregates->sum = prefix_sums[last_block + 1] - prefix_sums[first_block];
+    for (uint64_t low = first_block + header->tree_leaves, high = last_block + header->tree_leaves + 1; low < high; low /= 2, high /= 2)
+    {
+        if (low & 1)
+        {
+            aggregates->min = min_tree[low] < aggregates->min ? min_tree[low] : aggregates->min;
+            aggregates->max = max_tree[low] > aggregates->max ? max_tree[low] : aggregates->max;
+            low++;
+        }
+        if (high & 1)
+        {
+            high--;
+            aggregates->min = min_tree[high] < aggregates->min ? min_tree[high] : aggregates->min;
+            aggregates->max = max_tree[high] > aggregates->max ? max_tree[high] : aggregates->max;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "tableLayout.h"
+#include "deltaSegment.h"
+#include "tableUtilities.h"
+
+uint64_t row_count = 0;
+int col_count = 0;
+char filenameSkeleteon[1024];
+enum table_layout data_layout = LAYOUT_ROW_MAJOR;
+
+/**
+ * Appends a batch of rows to a table without touching its data and index files: the rows go to the
+ * delta segment (<filename>.delta, see deltaSegment.h) as one sorted run, and the queries see them at
+ * once through the delta index. mergeDelta later folds the delta segment into the data file.
+ *
+ * The rows are generated like the rows of createDataFast: keys after the largest key of the table
+ * (-k after, a table that grows) or anywhere below it (-k anywhere), columns 2 to 4 uniform over their
+ * domains, the counters continued from the last row.
+ */
+enum append_keys
+{
+    APPEND_KEYS_AFTER = 0,
+    APPEND_KEYS_ANYWHERE = 1
+};
+
+enum append_keys append_keys = APPEND_KEYS_AFTER;
+
+int read_metadata(const char *metadata_filename)
+{
+    FILE *fptr = fopen(metadata_filename, "r");
+    if (fptr == NULL)
+    {
+        perror("Error opening metadata file");
+        exit(EXIT_FAILURE);
+    }
+    char layout[16];
+    int fields = fscanf(fptr, "%1023s\n%lu\n%d\n%15s", filenameSkeleteon, &row_count, &col_count, layout);
+    if (fields == 4)
+        data_layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+    fclose(fptr);
+    return fields == 4;
+}
+
+// Largest key of the table: the key of the last tuple of the data file, or of a run of the delta segment
+uint64_t largest_key(int delta_fd, const struct delta_file_header *delta_header)
+{
+    uint64_t max_key = 0;
+    char *data_filename = filename_with_extension(filenameSkeleteon, ".data");
+    int data_fd = open(data_filename, O_RDONLY);
+    struct data_file_geometry geometry;
+    if (data_fd != -1 && row_count > 0 && read_data_file_geometry(data_fd, data_layout, col_count, &geometry) == 0)
+    {
+        off_t offset = item_in_file(&geometry, row_count - 1, 0) * sizeof(uint64_t);
+        if (pread(data_fd, &max_key, sizeof(max_key), offset) != sizeof(max_key))
+            max_key = 0;
+    }
+    if (data_fd != -1)
+        close(data_fd);
+    free(data_filename);
+
+    off_t offset = sizeof(*delta_header);
+    for (uint64_t r = 0; r < delta_header->number_of_runs; r++)
+    {
+        struct delta_run_header run;
+        if (pread(delta_fd, &run, sizeof(run), offset) != sizeof(run))
+            break;
+        max_key = run.max_key > max_key ? run.max_key : max_key;
+        offset += sizeof(run) + run.number_of_rows * col_count * sizeof(uint64_t);
+    }
+    return max_key;
+}
+
+void generate_rows(uint64_t *rows, size_t n, uint64_t max_key, uint64_t first_row, uint64_t seed)
+{
+    uint64_t state = seed;
+    uint64_t key = max_key;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t *row = rows + i * col_count;
+        uint64_t rc = first_row + i;
+        for (int j = 0; j < col_count; j++)
+        {
+            if (j == 0)
+            {
+                key = append_keys == APPEND_KEYS_AFTER ? key + 1 + next_random(&state) % 19 : next_random(&state) % (max_key + 1);
+                row[j] = key;
+            }
+            else if (j == 1)
+                row[j] = next_random(&state) % (10 * (first_row + n));
+            else if (j <= 4)
+                row[j] = next_random(&state) % (j == 2 ? 1000 : j == 3 ? 10000 : 100000);
+            else
+                row[j] = rc * (col_count - 5) + (j - 5);
+        }
+    }
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s <metadata file> <row count> [-s seed] [-k after|anywhere]\n", program);
+    printf("  -s  seed of the generated rows (default: the time)\n");
+    printf("  -k  keys after the largest key of the table (default), or anywhere below it\n");
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t seed = time(NULL);
+    int option;
+    while ((option = getopt(argc, argv, "s:k:")) != -1)
+    {
+        if (option == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else if (option == 'k' && strcmp(optarg, "after") == 0)
+            append_keys = APPEND_KEYS_AFTER;
+        else if (option == 'k' && strcmp(optarg, "anywhere") == 0)
+            append_keys = APPEND_KEYS_ANYWHERE;
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 >= argc || atol(argv[optind + 1]) <= 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *metadata_filename = argv[optind];
+    size_t number_of_rows = atol(argv[optind + 1]);
+
+    clock_t start_a = clock();
+
+    // Step 1: lock the delta segment of the table; a merge may have switched the table to new files
+    // between reading the metadata and taking the lock, then the metadata names another delta segment
+    struct delta_file_header header;
+    char *delta_filename;
+    int fd;
+    while (1)
+    {
+        if (!read_metadata(metadata_filename))
+        {
+            printf("Metadata file %s is not valid\n", metadata_filename);
+            return EXIT_FAILURE;
+        }
+        char skeleton[1024];
+        strcpy(skeleton, filenameSkeleteon);
+        delta_filename = filename_with_extension(filenameSkeleteon, ".delta");
+        fd = delta_open_locked(delta_filename, col_count, &header);
+        if (fd == -1)
+        {
+            printf("%s is not a delta segment of a %d-column table\n", delta_filename, col_count);
+            return EXIT_FAILURE;
+        }
+        read_metadata(metadata_filename);
+        if (strcmp(skeleton, filenameSkeleteon) == 0)
+            break;
+        delta_close(fd);
+        free(delta_filename);
+    }
+
+    // Step 2: generate the rows and append them as one run
+    uint64_t *rows = malloc(number_of_rows * col_count * sizeof(uint64_t));
+    if (rows == NULL)
+    {
+        perror("Memory allocation error for the rows");
+        return EXIT_FAILURE;
+    }
+    generate_rows(rows, number_of_rows, largest_key(fd, &header), row_count + header.number_of_rows, seed);
+    int failed = delta_append_run(fd, &header, rows, number_of_rows);
+    delta_close(fd);
+
+    clock_t end_a = clock();
+    float seconds_a = (float)(end_a - start_a) / CLOCKS_PER_SEC;
+    if (failed)
+        perror(delta_filename);
+    else
+        printf("Appended %zu rows (keys %lu to %lu) to %s: %lu rows in %lu runs, table of %lu rows\n", number_of_rows, rows[0],
+               rows[(number_of_rows - 1) * col_count], delta_filename, header.number_of_rows, header.number_of_runs, row_count + header.number_of_rows);
+    printf("Time Taken to append rows: %f \n", seconds_a);
+
+    free(rows);
+    free(delta_filename);
+    return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,452 @@
+#ifndef ASYNC_BLOCK_READER_H
+#define ASYNC_BLOCK_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/**
+ * Asynchronous block reader: keeps up to queue_depth block reads in flight ahead of the scanner,
+ * so the disk works on the next blocks while the CPU counts the current one
+ *
+ * Blocks are handed out strictly in order by block_reader_next. Every block has its own slot
+ * (slot = position in the scan % queue_depth); the slot of the block returned by the previous
+ * call is recycled for a new read on the next call, so a returned buffer stays valid until then.
+ *
+ * Two backends:
+ *   BLOCK_READER_IO_URING: one ring, IORING_OP_READ per block (raw syscalls, no liburing needed)
+ *   BLOCK_READER_THREADS:  a pool of threads issuing pread, used when io_uring is not available
+ *
+ * With O_DIRECT (direct = 1) the reads bypass the page cache: every read starts and ends on a page
+ * boundary of the file into a page aligned buffer, and block_reader_next returns the block inside it.
+ * Blocks of a multiple of the page size (createDataFast -b page) are read exactly, other blocks read
+ * the pages around them.
+ */
+enum block_reader_backend
+{
+    BLOCK_READER_IO_URING = 0,
+    BLOCK_READER_THREADS = 1
+};
+
+enum block_reader_slot_state
+{
+    SLOT_FREE = 0,
+    SLOT_QUEUED,        // waiting for a pool thread (threads backend only)
+    SLOT_IN_FLIGHT,
+    SLOT_DONE
+};
+
+struct block_reader_slot
+{
+    uint64_t *buffer;
+    size_t block_index;
+    size_t skip_in_bytes;               // from the start of the read to the block (O_DIRECT alignment)
+    enum block_reader_slot_state state;
+    ssize_t result;
+};
+
+struct block_reader
+{
+    enum block_reader_backend backend;
+    int fd;
+    int direct;                         // fd is opened with O_DIRECT
+    size_t alignment;                   // reads start and end on multiples of it (1 without O_DIRECT)
+    size_t data_offset_in_bytes;        // position of the first block in the file
+    size_t block_stride_in_bytes;       // distance between two blocks in the file
+    size_t read_size_in_bytes;          // bytes read from the start of every block (a whole block or only its key minipage)
+    int queue_depth;
+    struct block_reader_slot *slots;
+
+    size_t first_block;                 // scan state: blocks [first_block, last_block]
+    size_t last_block;
+    size_t next_block_to_submit;
+    size_t next_block_to_consume;
+    int previous_slot;                  // slot handed out by the last block_reader_next (-1 if none)
+
+    // io_uring backend
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // threads backend
+    pthread_t *workers;
+    int number_of_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    pthread_cond_t work_done;
+    int shutting_down;
+};
+
+static inline const char *block_reader_backend_name(enum block_reader_backend backend)
+{
+    return backend == BLOCK_READER_IO_URING ? "io_uring" : "threads";
+}
+
+// Where the read of a block starts in the file, and how many bytes it reads
+static inline size_t block_reader_read_offset(const struct block_reader *reader, size_t block_index)
+{
+    size_t offset = reader->data_offset_in_bytes + block_index * reader->block_stride_in_bytes;
+    return offset / reader->alignment * reader->alignment;
+}
+
+static inline size_t block_reader_read_length(const struct block_reader *reader, size_t skip_in_bytes)
+{
+    return (skip_in_bytes + reader->read_size_in_bytes + reader->alignment - 1) / reader->alignment * reader->alignment;
+}
+
+// Read the rest of a block synchronously (short reads are legal for both backends)
+// Under O_DIRECT a read only stops short at the end of the file, the pages past it are not needed
+static void block_reader_finish_read(struct block_reader *reader, struct block_reader_slot *slot)
+{
+    size_t done = slot->result > 0 ? (size_t)slot->result : 0;
+    if (slot->result < 0)
+    {
+        fprintf(stderr, "Error reading block %zu: %s\n", slot->block_index, strerror((int)-slot->result));
+        exit(EXIT_FAILURE);
+    }
+    size_t needed = slot->skip_in_bytes + reader->read_size_in_bytes;
+    while (done < needed)
+    {
+        ssize_t bytes_read = reader->direct ? 0 : pread(reader->fd, (char *)slot->buffer + done, needed - done,
+                                                        block_reader_read_offset(reader, slot->block_index) + done);
+        if (bytes_read <= 0)
+        {
+            fprintf(stderr, "Block %zu is past the end of the data file\n", slot->block_index);
+            exit(EXIT_FAILURE);
+        }
+        done += bytes_read;
+    }
+}
+
+/* io_uring backend */
+
+static int block_reader_ring_setup(struct block_reader *reader)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    reader->ring_fd = (int)syscall(__NR_io_uring_setup, (unsigned)reader->queue_depth, &params);
+    if (reader->ring_fd < 0)
+        return -1;
+
+    reader->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    reader->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    reader->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    reader->sq_ring = mmap(NULL, reader->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, reader->ring_fd, IORING_OFF_SQ_RING);
+    reader->cq_ring = mmap(NULL, reader->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, reader->ring_fd, IORING_OFF_CQ_RING);
+    reader->sqes = mmap(NULL, reader->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, reader->ring_fd, IORING_OFF_SQES);
+    if (reader->sq_ring == MAP_FAILED || reader->cq_ring == MAP_FAILED || reader->sqes == MAP_FAILED)
+    {
+        close(reader->ring_fd);
+        return -1;
+    }
+
+    reader->sq_head = (unsigned *)((char *)reader->sq_ring + params.sq_off.head);
+    reader->sq_tail = (unsigned *)((char *)reader->sq_ring + params.sq_off.tail);
+    reader->sq_mask = (unsigned *)((char *)reader->sq_ring + params.sq_off.ring_mask);
+    reader->sq_array = (unsigned *)((char *)reader->sq_ring + params.sq_off.array);
+    reader->cq_head = (unsigned *)((char *)reader->cq_ring + params.cq_off.head);
+    reader->cq_tail = (unsigned *)((char *)reader->cq_ring + params.cq_off.tail);
+    reader->cq_mask = (unsigned *)((char *)reader->cq_ring + params.cq_off.ring_mask);
+    reader->cqes = (struct io_uring_cqe *)((char *)reader->cq_ring + params.cq_off.cqes);
+    return 0;
+}
+
+static void block_reader_ring_submit(struct block_reader *reader, int slot_index)
+{
+    struct block_reader_slot *slot = &reader->slots[slot_index];
+    unsigned tail = *reader->sq_tail;
+    unsigned index = tail & *reader->sq_mask;
+    struct io_uring_sqe *sqe = &reader->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reader->fd;
+    sqe->addr = (uint64_t)(uintptr_t)slot->buffer;
+    sqe->len = (unsigned)block_reader_read_length(reader, slot->skip_in_bytes);
+    sqe->off = block_reader_read_offset(reader, slot->block_index);
+    sqe->user_data = (uint64_t)slot_index;
+    reader->sq_array[index] = index;
+    __atomic_store_n(reader->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, reader->ring_fd, 1, 0, 0, NULL, 0) < 0)
+    {
+        perror("io_uring_enter");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Move every available completion to its slot, waiting for at least "wait_for" of them
+static void block_reader_ring_reap(struct block_reader *reader, unsigned wait_for)
+{
+    if (wait_for > 0 && syscall(__NR_io_uring_enter, reader->ring_fd, 0, wait_for, IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+    {
+        perror("io_uring_enter");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned head = *reader->cq_head;
+    unsigned tail = __atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &reader->cqes[head & *reader->cq_mask];
+        struct block_reader_slot *slot = &reader->slots[cqe->user_data];
+        slot->result = cqe->res;
+        slot->state = SLOT_DONE;
+        head++;
+    }
+    __atomic_store_n(reader->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* threads backend */
+
+static void *block_reader_worker(void *argument)
+{
+    struct block_reader *reader = argument;
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->shutting_down)
+    {
+        int slot_index = -1;
+        for (int s = 0; s < reader->queue_depth; s++)
+            if (reader->slots[s].state == SLOT_QUEUED)
+            {
+                slot_index = s;
+                break;
+            }
+        if (slot_index == -1)
+        {
+            pthread_cond_wait(&reader->work_available, &reader->lock);
+            continue;
+        }
+
+        struct block_reader_slot *slot = &reader->slots[slot_index];
+        slot->state = SLOT_IN_FLIGHT;
+        pthread_mutex_unlock(&reader->lock);
+
+        ssize_t result = pread(reader->fd, slot->buffer, block_reader_read_length(reader, slot->skip_in_bytes),
+                               block_reader_read_offset(reader, slot->block_index));
+
+        pthread_mutex_lock(&reader->lock);
+        slot->result = result < 0 ? -errno : result;
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&reader->work_done);
+    }
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+/* common interface */
+
+// Queue the read of the next block of the scan into a free slot
+static void block_reader_submit(struct block_reader *reader, int slot_index)
+{
+    struct block_reader_slot *slot = &reader->slots[slot_index];
+    slot->block_index = reader->next_block_to_submit++;
+    slot->skip_in_bytes = reader->data_offset_in_bytes + slot->block_index * reader->block_stride_in_bytes -
+                          block_reader_read_offset(reader, slot->block_index);
+    slot->result = 0;
+
+    if (reader->backend == BLOCK_READER_IO_URING)
+    {
+        slot->state = SLOT_IN_FLIGHT;
+        block_reader_ring_submit(reader, slot_index);
+    }
+    else
+    {
+        pthread_mutex_lock(&reader->lock);
+        slot->state = SLOT_QUEUED;
+        pthread_cond_signal(&reader->work_available);
+        pthread_mutex_unlock(&reader->lock);
+    }
+}
+
+static void block_reader_wait(struct block_reader *reader, int slot_index)
+{
+    struct block_reader_slot *slot = &reader->slots[slot_index];
+    if (reader->backend == BLOCK_READER_IO_URING)
+    {
+        block_reader_ring_reap(reader, 0);
+        while (slot->state != SLOT_DONE)
+            block_reader_ring_reap(reader, 1);
+    }
+    else
+    {
+        pthread_mutex_lock(&reader->lock);
+        while (slot->state != SLOT_DONE)
+            pthread_cond_wait(&reader->work_done, &reader->lock);
+        pthread_mutex_unlock(&reader->lock);
+    }
+}
+
+/**
+ * Open the data file for asynchronous block reads: blocks of block_stride_in_bytes from data_offset_in_bytes,
+ * read_size_in_bytes read from the start of every block, with O_DIRECT if direct is set
+ * Falls back to the threads backend when io_uring cannot be set up (old kernel, seccomp, ...),
+ * and to the page cache when the file system does not support O_DIRECT (tmpfs, ...)
+ */
+static void block_reader_open(struct block_reader *reader, const char *filename, size_t data_offset_in_bytes, size_t block_stride_in_bytes,
+                              size_t read_size_in_bytes, int queue_depth, enum block_reader_backend backend, int direct)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = direct ? open(filename, O_RDONLY | O_DIRECT) : -1;
+    if (direct && reader->fd == -1 && errno == EINVAL)
+        fprintf(stderr, "O_DIRECT is not supported for %s, reading through the page cache\n", filename);
+    reader->direct = reader->fd != -1;
+    if (reader->fd == -1)
+        reader->fd = open(filename, O_RDONLY);
+    if (reader->fd == -1)
+    {
+        perror("Error opening data file");
+        exit(EXIT_FAILURE);
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    reader->alignment = reader->direct ? page_size : 1;
+    reader->data_offset_in_bytes = data_offset_in_bytes;
+    reader->block_stride_in_bytes = block_stride_in_bytes;
+    reader->read_size_in_bytes = read_size_in_bytes;
+    reader->queue_depth = queue_depth < 1 ? 1 : queue_depth;
+    reader->previous_slot = -1;
+
+    // Buffers are page aligned, with room for the partial pages around a block under O_DIRECT
+    size_t buffer_size = (read_size_in_bytes + page_size - 1) / page_size * page_size + (reader->direct ? page_size : 0);
+    reader->slots = calloc(reader->queue_depth, sizeof(struct block_reader_slot));
+    for (int s = 0; s < reader->queue_depth; s++)
+    {
+        reader->slots[s].buffer = aligned_alloc(page_size, buffer_size);
+        if (reader->slots[s].buffer == NULL)
+        {
+            perror("Memory allocation error for block reader buffers");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (backend == BLOCK_READER_IO_URING && block_reader_ring_setup(reader) != 0)
+    {
+        fprintf(stderr, "io_uring is not available (%s), using the threads block reader\n", strerror(errno));
+        backend = BLOCK_READER_THREADS;
+    }
+    reader->backend = backend;
+
+    if (backend == BLOCK_READER_THREADS)
+    {
+        pthread_mutex_init(&reader->lock, NULL);
+        pthread_cond_init(&reader->work_available, NULL);
+        pthread_cond_init(&reader->work_done, NULL);
+        reader->number_of_workers = reader->queue_depth;
+        reader->workers = malloc(reader->number_of_workers * sizeof(pthread_t));
+        for (int w = 0; w < reader->number_of_workers; w++)
+            pthread_create(&reader->workers[w], NULL, block_reader_worker, reader);
+    }
+}
+
+// Start a scan over the blocks [first_block, last_block]: the first queue_depth reads are issued right away
+static void block_reader_start(struct block_reader *reader, size_t first_block, size_t last_block)
+{
+    reader->first_block = first_block;
+    reader->last_block = last_block;
+    reader->next_block_to_submit = first_block;
+    reader->next_block_to_consume = first_block;
+    reader->previous_slot = -1;
+
+    for (int s = 0; s < reader->queue_depth && reader->next_block_to_submit <= last_block; s++)
+        block_reader_submit(reader, s);
+}
+
+// Next block of the scan (in order), NULL once last_block has been handed out
+static const uint64_t *block_reader_next(struct block_reader *reader)
+{
+    // the previous block is consumed, its slot reads the block queue_depth positions further
+    if (reader->previous_slot != -1)
+    {
+        reader->slots[reader->previous_slot].state = SLOT_FREE;
+        if (reader->next_block_to_submit <= reader->last_block)
+            block_reader_submit(reader, reader->previous_slot);
+        reader->previous_slot = -1;
+    }
+
+    if (reader->next_block_to_consume > reader->last_block)
+        return NULL;
+
+    int slot_index = (int)((reader->next_block_to_consume - reader->first_block) % reader->queue_depth);
+    block_reader_wait(reader, slot_index);
+    block_reader_finish_read(reader, &reader->slots[slot_index]);
+
+    reader->next_block_to_consume++;
+    reader->previous_slot = slot_index;
+    return (const uint64_t *)((const char *)reader->slots[slot_index].buffer + reader->slots[slot_index].skip_in_bytes);
+}
+
+// End the scan (possibly before last_block): wait for the reads still in flight so the slots can be reused
+static void block_reader_stop(struct block_reader *reader)
+{
+    if (reader->backend == BLOCK_READER_IO_URING)
+    {
+        for (int s = 0; s < reader->queue_depth; s++)
+        {
+            if (reader->slots[s].state == SLOT_IN_FLIGHT)
+                block_reader_wait(reader, s);
+            reader->slots[s].state = SLOT_FREE;
+        }
+    }
+    else
+    {
+        // reads no thread has picked up yet are simply dropped
+        pthread_mutex_lock(&reader->lock);
+        for (int s = 0; s < reader->queue_depth; s++)
+        {
+            if (reader->slots[s].state == SLOT_QUEUED)
+                reader->slots[s].state = SLOT_FREE;
+            while (reader->slots[s].state == SLOT_IN_FLIGHT)
+                pthread_cond_wait(&reader->work_done, &reader->lock);
+            reader->slots[s].state = SLOT_FREE;
+        }
+        pthread_mutex_unlock(&reader->lock);
+    }
+    reader->previous_slot = -1;
+}
+
+static void block_reader_close(struct block_reader *reader)
+{
+    block_reader_stop(reader);
+    if (reader->backend == BLOCK_READER_IO_URING)
+    {
+        munmap(reader->sqes, reader->sqes_size);
+        munmap(reader->cq_ring, reader->cq_ring_size);
+        munmap(reader->sq_ring, reader->sq_ring_size);
+        close(reader->ring_fd);
+    }
+    else
+    {
+        pthread_mutex_lock(&reader->lock);
+        reader->shutting_down = 1;
+        pthread_cond_broadcast(&reader->work_available);
+        pthread_mutex_unlock(&reader->lock);
+        for (int w = 0; w < reader->number_of_workers; w++)
+            pthread_join(reader->workers[w], NULL);
+        free(reader->workers);
+        pthread_mutex_destroy(&reader->lock);
+        pthread_cond_destroy(&reader->work_available);
+        pthread_cond_destroy(&reader->work_done);
+    }
+    for (int s = 0; s < reader->queue_depth; s++)
+        free(reader->slots[s].buffer);
+    free(reader->slots);
+    close(reader->fd);
+}
+
+#endif
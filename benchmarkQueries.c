@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "tableHandle.h"
+#include "latencyHistogram.h"
+#include "tableUtilities.h"
+
+/**
+ * Benchmark driver of the primary key range queries (tableHandle.h) over query workloads:
+ *
+ * uniform:   ranges of -w keys starting anywhere in the key space
+ * zipf:      ranges of -w keys in hot spots, the key space cut into 1000 slices picked zipf distributed
+ * point:     single keys of the table (from = to)
+ * sweep:     uniform ranges covering 0.001%, 0.01%, 0.1%, 1% and 10% of the key space, one workload each
+ * file:      the ranges of a file (-f), one "from to" pair per line
+ *
+ * Every query is timed on its own with the wall clock (clock_gettime, which unlike clock() includes the time
+ * spent waiting for the device) into a latency histogram (latencyHistogram.h). A warm run follows an
+ * untimed pass over the same queries; a cold run evicts the table files from the page cache before every
+ * query (table_drop_caches, not timed). The results are printed, and written as CSV (appended, one line
+ * per workload, method and cache mode, so runs of successive versions add up in one file) or JSON.
+ */
+#define NUMBER_OF_SWEEP_STEPS 5
+#define ZIPF_HOT_SLICES 1000
+#define ZIPF_EXPONENT 1.2
+#define MAX_RESULTS 64
+
+const double sweep_fractions[NUMBER_OF_SWEEP_STEPS] = {0.00001, 0.0001, 0.001, 0.01, 0.1};
+
+enum cache_mode
+{
+    CACHE_WARM = 1,
+    CACHE_COLD = 2,
+    CACHE_BOTH = 3
+};
+
+struct workload
+{
+    char name[32];
+    struct range_query *queries;
+    size_t number_of_queries;
+};
+
+struct benchmark_result
+{
+    char workload[32];
+    enum table_method method;
+    enum cache_mode cache;
+    uint64_t number_of_queries;
+    uint64_t match_count;
+    double seconds;
+    uint64_t mean, p50, p90, p99, p999, max;        // nanoseconds
+};
+
+struct table table;
+struct benchmark_result results[MAX_RESULTS];
+int number_of_results = 0;
+
+// Wall clock in nanoseconds
+static inline uint64_t now_in_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Whether a comma-separated list has the item name
+int list_contains(const char *list, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *item = list; item != NULL; item = strchr(item, ','), item = item != NULL ? item + 1 : NULL)
+        if (strncmp(item, name, length) == 0 && (item[length] == ',' || item[length] == '\0'))
+            return 1;
+    return 0;
+}
+
+void allocate_workload(struct workload *workload, const char *name, size_t number_of_queries)
+{
+    snprintf(workload->name, sizeof(workload->name), "%s", name);
+    workload->number_of_queries = number_of_queries;
+    workload->queries = malloc(number_of_queries * sizeof(struct range_query) + 1);
+    if (workload->queries == NULL)
+    {
+        perror("Memory allocation error for the workload");
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint64_t min_key()
+{
+    return table.row_count > 0 ? table.dense.keys[0] : 0;
+}
+
+uint64_t max_key()
+{
+    return table.row_count > 0 ? table.dense.keys[table.row_count - 1] : 0;
+}
+
+// Ranges of width keys starting anywhere in the key space (tableUtilities.h)
+void generate_uniform_workload(struct workload *workload, uint64_t width, uint64_t *state)
+{
+    generate_uniform_ranges(&table, workload->queries, workload->number_of_queries, width, state);
+}
+
+/**
+ * Ranges in hot spots: slice k of the key space is picked with probability proportional to 1 / rank^1.2,
+ * the ranks scattered over the slices (rank r is slice r * 7919 % 1000) so the hot spots are not all at
+ * the start of the table; the range starts anywhere in its slice
+ */
+void generate_zipf_ranges(struct workload *workload, uint64_t width, uint64_t *state)
+{
+    double cdf[ZIPF_HOT_SLICES];
+    double sum = 0;
+    for (int k = 1; k <= ZIPF_HOT_SLICES; k++)
+        sum += 1.0 / pow(k, ZIPF_EXPONENT);
+    double running = 0;
+    for (int k = 1; k <= ZIPF_HOT_SLICES; k++)
+    {
+        running += 1.0 / pow(k, ZIPF_EXPONENT) / sum;
+        cdf[k - 1] = running;
+    }
+    cdf[ZIPF_HOT_SLICES - 1] = 1.0;
+
+    uint64_t slice_width = (max_key() - min_key()) / ZIPF_HOT_SLICES + 1;
+    for (size_t q = 0; q < workload->number_of_queries; q++)
+    {
+        double u = next_random_double(state);
+        int low = 0, high = ZIPF_HOT_SLICES - 1;
+        while (low < high)
+        {
+            int mid = low + (high - low) / 2;
+            if (cdf[mid] < u)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        uint64_t slice = (uint64_t)low * 7919 % ZIPF_HOT_SLICES;
+        workload->queries[q].from = min_key() + slice * slice_width + next_random(state) % slice_width;
+        workload->queries[q].to = workload->queries[q].from + width;
+    }
+}
+
+void generate_point_lookups(struct workload *workload, uint64_t *state)
+{
+    for (size_t q = 0; q < workload->number_of_queries; q++)
+    {
+        uint64_t key = table.row_count > 0 ? table.dense.keys[next_random(state) % table.row_count] : 0;
+        workload->queries[q].from = key;
+        workload->queries[q].to = key;
+    }
+}
+
+// Read "from to" pairs, one per line; returns the number of queries read
+size_t load_workload_file(struct workload *workload, const char *filename)
+{
+    FILE *fptr = fopen(filename, "r");
+    if (fptr == NULL)
+    {
+        perror("Error opening workload file");
+        exit(EXIT_FAILURE);
+    }
+    size_t capacity = 1024;
+    allocate_workload(workload, "file", capacity);
+    size_t n = 0;
+    uint64_t from, to;
+    while (fscanf(fptr, "%lu %lu", &from, &to) == 2)
+    {
+        if (n == capacity)
+        {
+            capacity *= 2;
+            workload->queries = realloc(workload->queries, capacity * sizeof(struct range_query));
+            if (workload->queries == NULL)
+            {
+                perror("Memory allocation error for the workload");
+                exit(EXIT_FAILURE);
+            }
+        }
+        workload->queries[n].from = from;
+        workload->queries[n].to = to;
+        n++;
+    }
+    fclose(fptr);
+    workload->number_of_queries = n;
+    return n;
+}
+
+/**
+ * Run the queries of a workload with one method and cache mode, checking the counts against expected[]
+ * Returns the number of wrong counts
+ */
+size_t run_workload(const struct workload *workload, enum table_method method, enum cache_mode cache, size_t number_of_queries,
+                    const uint64_t *expected)
+{
+    static struct latency_histogram histogram;
+    latency_histogram_init(&histogram);
+    if (cache == CACHE_WARM)
+        for (size_t q = 0; q < number_of_queries; q++)
+            table_count(&table, method, workload->queries[q].from, workload->queries[q].to);
+
+    size_t errors = 0;
+    uint64_t match_count = 0;
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        if (cache == CACHE_COLD)
+            table_drop_caches(&table);
+        uint64_t start = now_in_nanoseconds();
+        uint64_t count = table_count(&table, method, workload->queries[q].from, workload->queries[q].to);
+        latency_histogram_record(&histogram, now_in_nanoseconds() - start);
+        errors += count != expected[q];
+        match_count += count;
+    }
+
+    if (number_of_results == MAX_RESULTS)
+        return errors;
+    struct benchmark_result *result = &results[number_of_results++];
+    snprintf(result->workload, sizeof(result->workload), "%s", workload->name);
+    result->method = method;
+    result->cache = cache;
+    result->number_of_queries = number_of_queries;
+    result->match_count = match_count;
+    result->seconds = histogram.sum / 1e9;
+    result->mean = (uint64_t)latency_histogram_mean(&histogram);
+    result->p50 = latency_histogram_percentile(&histogram, 50);
+    result->p90 = latency_histogram_percentile(&histogram, 90);
+    result->p99 = latency_histogram_percentile(&histogram, 99);
+    result->p999 = latency_histogram_percentile(&histogram, 99.9);
+    result->max = histogram.max;
+    printf("%-14s %-10s %-4s %8lu %12.0f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %12lu\n", result->workload, table_method_name(method),
+           cache == CACHE_COLD ? "cold" : "warm", result->number_of_queries, result->number_of_queries / result->seconds,
+           result->mean / 1e3, result->p50 / 1e3, result->p90 / 1e3, result->p99 / 1e3, result->p999 / 1e3, result->max / 1e3, match_count);
+    return errors;
+}
+
+// Append the results to a CSV file, with the header line if the file is new
+void write_csv(const char *filename, const char *label)
+{
+    FILE *fptr = fopen(filename, "a");
+    if (fptr == NULL)
+    {
+        perror("Error opening output file");
+        exit(EXIT_FAILURE);
+    }
+    if (ftell(fptr) == 0)
+        fprintf(fptr, "label,table,rows,layout,workload,method,cache,queries,matches,seconds,qps,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+    for (int r = 0; r < number_of_results; r++)
+    {
+        const struct benchmark_result *result = &results[r];
+        fprintf(fptr, "%s,%s,%lu,%s,%s,%s,%s,%lu,%lu,%f,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", label, table.skeleton, table.row_count,
+                layout_name(table.layout), result->workload, table_method_name(result->method), result->cache == CACHE_COLD ? "cold" : "warm",
+                result->number_of_queries, result->match_count, result->seconds, result->number_of_queries / result->seconds,
+                result->mean / 1e3, result->p50 / 1e3, result->p90 / 1e3, result->p99 / 1e3, result->p999 / 1e3, result->max / 1e3);
+    }
+    fclose(fptr);
+}
+
+void write_json(const char *filename, const char *label)
+{
+    FILE *fptr = fopen(filename, "w");
+    if (fptr == NULL)
+    {
+        perror("Error opening output file");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fptr, "{\n  \"label\": \"%s\",\n  \"table\": \"%s\",\n  \"rows\": %lu,\n  \"layout\": \"%s\",\n  \"results\": [\n",
+            label, table.skeleton, table.row_count, layout_name(table.layout));
+    for (int r = 0; r < number_of_results; r++)
+    {
+        const struct benchmark_result *result = &results[r];
+        fprintf(fptr, "    {\"workload\": \"%s\", \"method\": \"%s\", \"cache\": \"%s\", \"queries\": %lu, \"matches\": %lu, \"seconds\": %f, "
+                      "\"qps\": %.0f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f}%s\n",
+                result->workload, table_method_name(result->method), result->cache == CACHE_COLD ? "cold" : "warm", result->number_of_queries,
+                result->match_count, result->seconds, result->number_of_queries / result->seconds, result->mean / 1e3, result->p50 / 1e3,
+                result->p90 / 1e3, result->p99 / 1e3, result->p999 / 1e3, result->max / 1e3, r + 1 < number_of_results ? "," : "");
+    }
+    fprintf(fptr, "  ]\n}\n");
+    fclose(fptr);
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s <metadata file> [-W workloads] [-f workload file] [-m methods] [-c warm|cold|both] [-q queries] [-C cold queries] "
+           "[-w width] [-s seed] [-o output file] [-F csv|json] [-L label]\n", program);
+    printf("  -W  comma-separated workloads among uniform,zipf,point,sweep (default all of them)\n");
+    printf("  -f  file of \"from to\" ranges, one per line, run as the workload \"file\"\n");
+    printf("  -m  comma-separated methods among dense_only,dense,sparse (default all of them)\n");
+    printf("  -c  warm runs, cold runs (the table files evicted from the page cache before every query) or both (default)\n");
+    printf("  -q  queries per workload (default 10000)\n");
+    printf("  -C  queries of a cold run, the first ones of the workload (default 200)\n");
+    printf("  -w  width of the uniform and zipf ranges (default 1000)\n");
+    printf("  -s  seed of the workloads (default 42)\n");
+    printf("  -o  write the results to a file, appended to a CSV file or as a JSON document\n");
+    printf("  -F  format of the output file (default csv)\n");
+    printf("  -L  label of the results in the output file, e.g. the version (default \"unlabeled\")\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *workload_names = "uniform,zipf,point,sweep";
+    const char *method_names = "dense_only,dense,sparse";
+    const char *workload_filename = NULL, *output_filename = NULL, *label = "unlabeled";
+    int json = 0;
+    enum cache_mode cache = CACHE_BOTH;
+    size_t number_of_queries = 10000, number_of_cold_queries = 200;
+    uint64_t width = 1000, seed = 42;
+    int option;
+    while ((option = getopt(argc, argv, "W:f:m:c:q:C:w:s:o:F:L:")) != -1)
+    {
+        if (option == 'W')
+            workload_names = optarg;
+        else if (option == 'f')
+            workload_filename = optarg;
+        else if (option == 'm')
+            method_names = optarg;
+        else if (option == 'c' && strcmp(optarg, "warm") == 0)
+            cache = CACHE_WARM;
+        else if (option == 'c' && strcmp(optarg, "cold") == 0)
+            cache = CACHE_COLD;
+        else if (option == 'c' && strcmp(optarg, "both") == 0)
+            cache = CACHE_BOTH;
+        else if (option == 'q' && atol(optarg) > 0)
+            number_of_queries = atol(optarg);
+        else if (option == 'C' && atol(optarg) > 0)
+            number_of_cold_queries = atol(optarg);
+        else if (option == 'w')
+            width = strtoull(optarg, NULL, 10);
+        else if (option == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else if (option == 'o')
+            output_filename = optarg;
+        else if (option == 'F' && (strcmp(optarg, "csv") == 0 || strcmp(optarg, "json") == 0))
+            json = strcmp(optarg, "json") == 0;
+        else if (option == 'L')
+            label = optarg;
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (table_open(&table, argv[optind], 0) != 0)
+        return EXIT_FAILURE;
+    printf("Table %s: %lu rows, %d columns, %s layout, %lu delta rows\n", table.skeleton, table.row_count, table.col_count,
+           layout_name(table.layout), table.delta.header.number_of_rows);
+    printf("Range count kernel: %s\n", select_range_count_kernel()->name);
+
+    // Step 1: the workloads
+    struct workload workloads[4 + NUMBER_OF_SWEEP_STEPS];
+    int number_of_workloads = 0;
+    uint64_t state = seed;
+    if (list_contains(workload_names, "uniform"))
+    {
+        allocate_workload(&workloads[number_of_workloads], "uniform", number_of_queries);
+        generate_uniform_workload(&workloads[number_of_workloads++], width, &state);
+    }
+    if (list_contains(workload_names, "zipf"))
+    {
+        allocate_workload(&workloads[number_of_workloads], "zipf", number_of_queries);
+        generate_zipf_ranges(&workloads[number_of_workloads++], width, &state);
+    }
+    if (list_contains(workload_names, "point"))
+    {
+        allocate_workload(&workloads[number_of_workloads], "point", number_of_queries);
+        generate_point_lookups(&workloads[number_of_workloads++], &state);
+    }
+    if (list_contains(workload_names, "sweep"))
+    {
+        for (int s = 0; s < NUMBER_OF_SWEEP_STEPS; s++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "sweep_%g%%", sweep_fractions[s] * 100);
+            allocate_workload(&workloads[number_of_workloads], name, number_of_queries);
+            generate_uniform_workload(&workloads[number_of_workloads++], (uint64_t)((max_key() - min_key()) * sweep_fractions[s]), &state);
+        }
+    }
+    if (workload_filename != NULL && load_workload_file(&workloads[number_of_workloads++], workload_filename) == 0)
+        number_of_workloads--;
+
+    // Step 2: every workload with every method, warm then cold; the dense-index-only counts are the reference
+    printf("%-14s %-10s %-4s %8s %12s %10s %10s %10s %10s %10s %10s %12s\n", "workload", "method", "cache", "queries", "queries/s",
+           "mean us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us", "tuples");
+    size_t errors = 0;
+    for (int w = 0; w < number_of_workloads; w++)
+    {
+        struct workload *workload = &workloads[w];
+        uint64_t *expected = malloc(workload->number_of_queries * sizeof(uint64_t) + 1);
+        if (expected == NULL)
+        {
+            perror("Memory allocation error for the expected counts");
+            return EXIT_FAILURE;
+        }
+        for (size_t q = 0; q < workload->number_of_queries; q++)
+            expected[q] = table_count(&table, TABLE_DENSE_INDEX_ONLY, workload->queries[q].from, workload->queries[q].to);
+
+        for (enum table_method method = TABLE_DENSE_INDEX_ONLY; method <= TABLE_SPARSE_INDEX; method++)
+        {
+            if (!list_contains(method_names, table_method_name(method)))
+                continue;
+            if (cache & CACHE_WARM)
+                errors += run_workload(workload, method, CACHE_WARM, workload->number_of_queries, expected);
+            if (cache & CACHE_COLD)
+                errors += run_workload(workload, method, CACHE_COLD,
+                                       number_of_cold_queries < workload->number_of_queries ? number_of_cold_queries : workload->number_of_queries, expected);
+        }
+        free(expected);
+        free(workload->queries);
+    }
+    if (errors > 0)
+        printf("Error or incomplete implementation: %zu wrong counts\n", errors);
+
+    if (output_filename != NULL)
+    {
+        if (json)
+            write_json(output_filename, label);
+        else
+            write_csv(output_filename, label);
+        printf("Results written to %s\n", output_filename);
+    }
+    table_close(&table);
+    return errors > 0 ? EXIT_FAILURE : 0;
+}
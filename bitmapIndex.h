@@ -0,0 +1,437 @@
+#ifndef BITMAP_INDEX_H
+#define BITMAP_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * Compressed bitmaps (Roaring): the set of tuples (row ids < 2^32) is split in chunks of 65536 row ids,
+ * the 16 high bits of a row id pick the chunk's container and the 16 low bits are stored in it:
+ *   ROARING_ARRAY:  a sorted array of the low bits, for at most ROARING_ARRAY_MAX rows (2 bytes per row)
+ *   ROARING_BITSET: a bitset of 65536 bits (8 KiB), for denser chunks
+ * Empty chunks have no container, so a bitmap of a rare value is a few bytes.
+ */
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITSET_WORDS 1024
+
+enum roaring_container_type
+{
+    ROARING_ARRAY = 0,
+    ROARING_BITSET = 1
+};
+
+struct roaring_container
+{
+    uint16_t key;               // high 16 bits of the row ids
+    uint16_t type;
+    uint32_t cardinality;
+    uint32_t capacity;          // values allocated for an array the bitmap owns
+    uint16_t *values;           // ROARING_ARRAY
+    uint64_t *words;            // ROARING_BITSET
+};
+
+struct roaring_bitmap
+{
+    struct roaring_container *containers;
+    uint32_t number_of_containers;
+    uint32_t capacity;
+};
+
+static inline void roaring_init(struct roaring_bitmap *bitmap)
+{
+    memset(bitmap, 0, sizeof(*bitmap));
+}
+
+static inline void roaring_free(struct roaring_bitmap *bitmap)
+{
+    for (uint32_t c = 0; c < bitmap->number_of_containers; c++)
+    {
+        free(bitmap->containers[c].values);
+        free(bitmap->containers[c].words);
+    }
+    free(bitmap->containers);
+    bitmap->containers = NULL;
+    bitmap->number_of_containers = bitmap->capacity = 0;
+}
+
+static inline void *roaring_allocate(size_t size_in_bytes)
+{
+    void *memory = malloc(size_in_bytes);
+    if (memory == NULL)
+    {
+        perror("Memory allocation error for a bitmap");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+// A new empty container at the end of the bitmap
+static inline struct roaring_container *roaring_push_container(struct roaring_bitmap *bitmap, uint16_t key)
+{
+    if (bitmap->number_of_containers == bitmap->capacity)
+    {
+        bitmap->capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+        bitmap->containers = realloc(bitmap->containers, bitmap->capacity * sizeof(struct roaring_container));
+        if (bitmap->containers == NULL)
+        {
+            perror("Memory allocation error for a bitmap");
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct roaring_container *container = &bitmap->containers[bitmap->number_of_containers++];
+    memset(container, 0, sizeof(*container));
+    container->key = key;
+    container->type = ROARING_ARRAY;
+    return container;
+}
+
+static inline void roaring_array_to_bitset(struct roaring_container *container)
+{
+    uint64_t *words = roaring_allocate(ROARING_BITSET_WORDS * sizeof(uint64_t));
+    memset(words, 0, ROARING_BITSET_WORDS * sizeof(uint64_t));
+    for (uint32_t i = 0; i < container->cardinality; i++)
+        words[container->values[i] >> 6] |= 1ULL << (container->values[i] & 63);
+    free(container->values);
+    container->values = NULL;
+    container->capacity = 0;
+    container->words = words;
+    container->type = ROARING_BITSET;
+}
+
+static inline uint64_t roaring_cardinality(const struct roaring_bitmap *bitmap)
+{
+    uint64_t cardinality = 0;
+    for (uint32_t c = 0; c < bitmap->number_of_containers; c++)
+        cardinality += bitmap->containers[c].cardinality;
+    return cardinality;
+}
+
+static inline int roaring_bitset_contains(const uint64_t *words, uint16_t low)
+{
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+// Store a result container: arrays of more than ROARING_ARRAY_MAX values become bitsets
+static inline void roaring_push_array(struct roaring_bitmap *out, uint16_t key, const uint16_t *values, uint32_t cardinality)
+{
+    if (cardinality == 0)
+        return;
+    struct roaring_container *container = roaring_push_container(out, key);
+    container->values = roaring_allocate(cardinality * sizeof(uint16_t));
+    memcpy(container->values, values, cardinality * sizeof(uint16_t));
+    container->capacity = container->cardinality = cardinality;
+    if (cardinality > ROARING_ARRAY_MAX)
+        roaring_array_to_bitset(container);
+}
+
+// ... and bitsets of at most ROARING_ARRAY_MAX bits become arrays
+static inline void roaring_push_bitset(struct roaring_bitmap *out, uint16_t key, uint64_t *words)
+{
+    uint32_t cardinality = 0;
+    for (int w = 0; w < ROARING_BITSET_WORDS; w++)
+        cardinality += __builtin_popcountll(words[w]);
+    if (cardinality == 0)
+    {
+        free(words);
+        return;
+    }
+    struct roaring_container *container = roaring_push_container(out, key);
+    container->cardinality = cardinality;
+    if (cardinality > ROARING_ARRAY_MAX)
+    {
+        container->type = ROARING_BITSET;
+        container->words = words;
+        return;
+    }
+    container->values = roaring_allocate(cardinality * sizeof(uint16_t));
+    container->capacity = cardinality;
+    uint32_t n = 0;
+    for (int w = 0; w < ROARING_BITSET_WORDS; w++)
+        for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1)
+            container->values[n++] = (uint16_t)(w * 64 + __builtin_ctzll(bits));
+    free(words);
+}
+
+static inline uint64_t *roaring_container_to_words(const struct roaring_container *container)
+{
+    uint64_t *words = roaring_allocate(ROARING_BITSET_WORDS * sizeof(uint64_t));
+    if (container->type == ROARING_BITSET)
+        memcpy(words, container->words, ROARING_BITSET_WORDS * sizeof(uint64_t));
+    else
+    {
+        memset(words, 0, ROARING_BITSET_WORDS * sizeof(uint64_t));
+        for (uint32_t i = 0; i < container->cardinality; i++)
+            words[container->values[i] >> 6] |= 1ULL << (container->values[i] & 63);
+    }
+    return words;
+}
+
+// out = a OR b (out is initialized here)
+static inline void roaring_or(struct roaring_bitmap *out, const struct roaring_bitmap *a, const struct roaring_bitmap *b)
+{
+    roaring_init(out);
+    uint16_t merged[2 * ROARING_ARRAY_MAX];
+    uint32_t i = 0, j = 0;
+    while (i < a->number_of_containers || j < b->number_of_containers)
+    {
+        const struct roaring_container *ca = i < a->number_of_containers ? &a->containers[i] : NULL;
+        const struct roaring_container *cb = j < b->number_of_containers ? &b->containers[j] : NULL;
+        if (cb == NULL || (ca != NULL && ca->key < cb->key))
+        {
+            if (ca->type == ROARING_ARRAY)
+                roaring_push_array(out, ca->key, ca->values, ca->cardinality);
+            else
+                roaring_push_bitset(out, ca->key, roaring_container_to_words(ca));
+            i++;
+        }
+        else if (ca == NULL || cb->key < ca->key)
+        {
+            if (cb->type == ROARING_ARRAY)
+                roaring_push_array(out, cb->key, cb->values, cb->cardinality);
+            else
+                roaring_push_bitset(out, cb->key, roaring_container_to_words(cb));
+            j++;
+        }
+        else
+        {
+            if (ca->type == ROARING_ARRAY && cb->type == ROARING_ARRAY)
+            {
+                // merge of the two sorted arrays
+                uint32_t x = 0, y = 0, n = 0;
+                while (x < ca->cardinality && y < cb->cardinality)
+                {
+                    uint16_t va = ca->values[x], vb = cb->values[y];
+                    merged[n++] = va < vb ? va : vb;
+                    x += va <= vb;
+                    y += vb <= va;
+                }
+                while (x < ca->cardinality)
+                    merged[n++] = ca->values[x++];
+                while (y < cb->cardinality)
+                    merged[n++] = cb->values[y++];
+                roaring_push_array(out, ca->key, merged, n);
+            }
+            else
+            {
+                const struct roaring_container *other = ca->type == ROARING_BITSET ? cb : ca;
+                uint64_t *words = roaring_container_to_words(ca->type == ROARING_BITSET ? ca : cb);
+                if (other->type == ROARING_BITSET)
+                    for (int w = 0; w < ROARING_BITSET_WORDS; w++)
+                        words[w] |= other->words[w];
+                else
+                    for (uint32_t v = 0; v < other->cardinality; v++)
+                        words[other->values[v] >> 6] |= 1ULL << (other->values[v] & 63);
+                roaring_push_bitset(out, ca->key, words);
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+// out = a AND b (out is initialized here)
+static inline void roaring_and(struct roaring_bitmap *out, const struct roaring_bitmap *a, const struct roaring_bitmap *b)
+{
+    roaring_init(out);
+    uint16_t common[ROARING_ARRAY_MAX];
+    uint32_t i = 0, j = 0;
+    while (i < a->number_of_containers && j < b->number_of_containers)
+    {
+        const struct roaring_container *ca = &a->containers[i], *cb = &b->containers[j];
+        if (ca->key != cb->key)
+        {
+            i += ca->key < cb->key;
+            j += cb->key < ca->key;
+            continue;
+        }
+
+        if (ca->type == ROARING_BITSET && cb->type == ROARING_BITSET)
+        {
+            uint64_t *words = roaring_allocate(ROARING_BITSET_WORDS * sizeof(uint64_t));
+            for (int w = 0; w < ROARING_BITSET_WORDS; w++)
+                words[w] = ca->words[w] & cb->words[w];
+            roaring_push_bitset(out, ca->key, words);
+        }
+        else if (ca->type == ROARING_ARRAY && cb->type == ROARING_ARRAY)
+        {
+            uint32_t x = 0, y = 0, n = 0;
+            while (x < ca->cardinality && y < cb->cardinality)
+            {
+                uint16_t va = ca->values[x], vb = cb->values[y];
+                if (va == vb)
+                    common[n++] = va;
+                x += va <= vb;
+                y += vb <= va;
+            }
+            roaring_push_array(out, ca->key, common, n);
+        }
+        else
+        {
+            // the array values that are set in the bitset
+            const struct roaring_container *array = ca->type == ROARING_ARRAY ? ca : cb;
+            const struct roaring_container *bitset = ca->type == ROARING_ARRAY ? cb : ca;
+            uint32_t n = 0;
+            for (uint32_t v = 0; v < array->cardinality; v++)
+            {
+                common[n] = array->values[v];
+                n += roaring_bitset_contains(bitset->words, array->values[v]);
+            }
+            roaring_push_array(out, ca->key, common, n);
+        }
+        i++;
+        j++;
+    }
+}
+
+/**
+ * Bitmap index on the low-cardinality columns (the .bitmap_index file): the compressed bitmap of the
+ * tuples holding every value of columns 2, 3 and 4, stored chunk by chunk
+ *
+ *   struct bitmap_index_header
+ *   per indexed column: number_of_chunks + 1 file offsets, chunk k is the bytes [offset[k], offset[k + 1]),
+ *   then the chunks of the column
+ * A chunk holds the containers of the values of its 65536 tuples (the container of every value's bitmap
+ * for that chunk), so the builder writes it as soon as it has seen the tuples of the chunk:
+ *   uint32 number_of_values, uint32 values[number_of_values] (increasing), uint32 ends[number_of_values]
+ *   the containers, in the order of the values: container i is the bytes [ends[i - 1], ends[i]) after the ends
+ *   (a bitset of ROARING_BITSET_WORDS words when the value has ROARING_ARRAY_MAX tuples or more in the chunk,
+ *   else the sorted low 16 bits of its tuples), padding to 8 bytes
+ * A column is only indexed when all its values are below BITMAP_INDEX_MAX_VALUES.
+ */
+#define BITMAP_INDEX_MAGIC 0x5845444e494d4252ULL    // "RBMINDEX"
+#define BITMAP_INDEX_VERSION 2
+#define BITMAP_INDEX_FIRST_COLUMN 2
+#define BITMAP_INDEX_COLUMNS 3
+#define BITMAP_INDEX_MAX_VALUES (1 << 20)
+#define BITMAP_CHUNK_ROWS 65536
+#define BITMAP_CHUNK_MAX_SIZE (8 + 10 * BITMAP_CHUNK_ROWS)     // a value and an end per tuple, 2 bytes per tuple
+
+struct bitmap_index_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t number_of_values[BITMAP_INDEX_COLUMNS];    // 0 for a column that is not indexed
+    uint64_t chunks_offset[BITMAP_INDEX_COLUMNS];       // where the offsets of the column's chunks are
+};
+
+struct bitmap_index
+{
+    const char *file;           // mapping of the file
+    size_t file_size_in_bytes;
+    const struct bitmap_index_header *header;
+};
+
+static inline size_t bitmap_index_number_of_chunks(uint64_t row_count)
+{
+    return (row_count + BITMAP_CHUNK_ROWS - 1) / BITMAP_CHUNK_ROWS;
+}
+
+/**
+ * Serialize a chunk of a column into buffer (at most BITMAP_CHUNK_MAX_SIZE bytes), returns its size
+ * The tuples of the chunk are sorted by value: value i is values[i], its tuples are the low 16 bits
+ * rows[first_row[i]] to rows[first_row[i + 1] - 1], increasing
+ */
+static inline size_t bitmap_chunk_serialize(const uint32_t *values, const uint32_t *first_row, uint32_t number_of_values, const uint16_t *rows, char *buffer)
+{
+    uint32_t *ends = (uint32_t *)(buffer + 4) + number_of_values;
+    char *containers = (char *)(ends + number_of_values);
+    memcpy(buffer, &number_of_values, 4);
+    memcpy(buffer + 4, values, number_of_values * sizeof(uint32_t));
+
+    size_t end = 0;
+    for (uint32_t i = 0; i < number_of_values; i++)
+    {
+        uint32_t cardinality = first_row[i + 1] - first_row[i];
+        const uint16_t *low = rows + first_row[i];
+        if (cardinality >= ROARING_ARRAY_MAX)
+        {
+            uint64_t words[ROARING_BITSET_WORDS];
+            memset(words, 0, sizeof(words));
+            for (uint32_t r = 0; r < cardinality; r++)
+                words[low[r] >> 6] |= 1ULL << (low[r] & 63);
+            memcpy(containers + end, words, sizeof(words));
+            end += sizeof(words);
+        }
+        else
+        {
+            memcpy(containers + end, low, cardinality * sizeof(uint16_t));
+            end += cardinality * sizeof(uint16_t);
+        }
+        ends[i] = (uint32_t)end;
+    }
+
+    size_t size_in_bytes = containers + end - buffer;
+    size_t padded_size_in_bytes = (size_in_bytes + 7) / 8 * 8;
+    memset(buffer + size_in_bytes, 0, padded_size_in_bytes - size_in_bytes);
+    return padded_size_in_bytes;
+}
+
+// Is column indexed?
+static inline int bitmap_index_has_column(const struct bitmap_index *index, int column)
+{
+    int c = column - BITMAP_INDEX_FIRST_COLUMN;
+    return c >= 0 && c < BITMAP_INDEX_COLUMNS && index->header->number_of_values[c] > 0;
+}
+
+/**
+ * out = the tuples whose "column" is in [from, to], the OR of the bitmaps of those values
+ * In every chunk the values of the range are consecutive: their containers are OR-ed into one bitset,
+ * turned into the chunk's container, so a wide range costs one pass over its containers
+ */
+static inline void bitmap_index_range(const struct bitmap_index *index, int column, uint64_t from, uint64_t to, struct roaring_bitmap *out)
+{
+    roaring_init(out);
+    const uint64_t *offsets = (const uint64_t *)(index->file + index->header->chunks_offset[column - BITMAP_INDEX_FIRST_COLUMN]);
+    size_t number_of_chunks = bitmap_index_number_of_chunks(index->header->row_count);
+    for (size_t key = 0; key < number_of_chunks; key++)
+    {
+        const char *chunk = index->file + offsets[key];
+        uint32_t number_of_values;
+        memcpy(&number_of_values, chunk, 4);
+        const uint32_t *values = (const uint32_t *)(chunk + 4);
+        const uint32_t *ends = values + number_of_values;
+        const char *containers = (const char *)(ends + number_of_values);
+
+        // first value of the chunk >= from
+        uint32_t low = 0, high = number_of_values;
+        while (low < high)
+        {
+            uint32_t middle = low + (high - low) / 2;
+            if (values[middle] < from)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == number_of_values || values[low] > to)
+            continue;
+
+        uint64_t *words = roaring_allocate(ROARING_BITSET_WORDS * sizeof(uint64_t));
+        memset(words, 0, ROARING_BITSET_WORDS * sizeof(uint64_t));
+        for (uint32_t i = low; i < number_of_values && values[i] <= to; i++)
+        {
+            uint32_t start = i == 0 ? 0 : ends[i - 1];
+            if (ends[i] - start == ROARING_BITSET_WORDS * sizeof(uint64_t))
+            {
+                // the bitsets are not 8-byte aligned in the file
+                for (int w = 0; w < ROARING_BITSET_WORDS; w++)
+                {
+                    uint64_t word;
+                    memcpy(&word, containers + start + w * sizeof(uint64_t), sizeof(word));
+                    words[w] |= word;
+                }
+                continue;
+            }
+            const uint16_t *rows = (const uint16_t *)(containers + start);
+            for (uint32_t r = 0; r < (ends[i] - start) / sizeof(uint16_t); r++)
+                words[rows[r] >> 6] |= 1ULL << (rows[r] & 63);
+        }
+        roaring_push_bitset(out, (uint16_t)key, words);
+    }
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef BTREE_INDEX_H
+#define BTREE_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * On-disk B+-tree over the clustered primary key (the .btree_index file)
+ *
+ * The file is a sequence of 4 KiB pages:
+ *   page 0:                         struct btree_file_header
+ *   pages [level_first_page[0], ..): the leaves, (key, pointer) for every tuple in key order,
+ *                                   the pointer is the position of the tuple in number of items (as in the dense index)
+ *   pages [level_first_page[k], ..): level k, (first key, page number) for every page of level k - 1
+ * The top level has a single page, the root.
+ *
+ * Every page is a 16 byte struct btree_page_header followed by up to BTREE_ENTRIES_PER_PAGE 16 byte
+ * entries, which fills 4 KiB exactly. The tree is bulk-loaded bottom-up and packed: page p of level k
+ * holds the entries [p * 255, (p + 1) * 255) of its level, so the position of every entry is known
+ * from the tuple it describes and the builder threads write the pages of their blocks independently.
+ */
+#define BTREE_PAGE_SIZE 4096
+#define BTREE_ENTRIES_PER_PAGE 255
+#define BTREE_MAX_LEVELS 8
+#define BTREE_MAGIC 0x5845444e49425442ULL        // "BTBINDEX"
+#define BTREE_VERSION 1
+
+struct btree_page_header
+{
+    uint32_t level;                 // 0 for the leaves
+    uint32_t number_of_entries;
+    uint64_t reserved;
+};
+
+struct btree_file_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t page_size;
+    uint64_t row_count;
+    uint64_t number_of_levels;
+    uint64_t root_page;
+    uint64_t level_first_page[BTREE_MAX_LEVELS];
+    uint64_t level_number_of_pages[BTREE_MAX_LEVELS];
+};
+
+// Shape of the packed tree over row_count keys
+static inline void btree_geometry(uint64_t row_count, struct btree_file_header *header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = BTREE_MAGIC;
+    header->version = BTREE_VERSION;
+    header->page_size = BTREE_PAGE_SIZE;
+    header->row_count = row_count;
+
+    uint64_t entries = row_count;
+    uint64_t first_page = 1;
+    int level = 0;
+    do
+    {
+        uint64_t pages = (entries + BTREE_ENTRIES_PER_PAGE - 1) / BTREE_ENTRIES_PER_PAGE;
+        if (pages == 0)
+            pages = 1;
+        header->level_first_page[level] = first_page;
+        header->level_number_of_pages[level] = pages;
+        first_page += pages;
+        entries = pages;
+        level++;
+    } while (entries > 1 && level < BTREE_MAX_LEVELS);
+
+    header->number_of_levels = level;
+    header->root_page = header->level_first_page[level - 1];
+}
+
+static inline uint64_t btree_total_number_of_pages(const struct btree_file_header *header)
+{
+    int top = (int)header->number_of_levels - 1;
+    return header->level_first_page[top] + header->level_number_of_pages[top];
+}
+
+/**
+ * Reader side: pages are read on demand through a small cache of BTREE_CACHE_PAGES frames (LRU),
+ * so opening the index reads one page and a lookup touches number_of_levels pages
+ */
+#define BTREE_CACHE_PAGES 64
+
+struct btree_cache_frame
+{
+    uint64_t page_number;           // UINT64_MAX for an empty frame
+    uint64_t last_used;
+    uint64_t *page;
+};
+
+struct btree_index
+{
+    int fd;
+    struct btree_file_header header;
+    struct btree_cache_frame frames[BTREE_CACHE_PAGES];
+    uint64_t clock;
+    uint64_t page_reads;            // pages read from the file (cache misses)
+};
+
+// Open the .btree_index file, returns -1 if it is missing or not a B+-tree index of this version
+static inline int btree_open(struct btree_index *index, const char *filename)
+{
+    memset(index, 0, sizeof(*index));
+    index->fd = open(filename, O_RDONLY);
+    if (index->fd == -1)
+        return -1;
+    if (pread(index->fd, &index->header, sizeof(index->header), 0) != sizeof(index->header) ||
+        index->header.magic != BTREE_MAGIC || index->header.version != BTREE_VERSION ||
+        index->header.page_size != BTREE_PAGE_SIZE)
+    {
+        close(index->fd);
+        return -1;
+    }
+    for (int f = 0; f < BTREE_CACHE_PAGES; f++)
+    {
+        index->frames[f].page_number = UINT64_MAX;
+        index->frames[f].page = malloc(BTREE_PAGE_SIZE);
+    }
+    return 0;
+}
+
+static inline void btree_close(struct btree_index *index)
+{
+    for (int f = 0; f < BTREE_CACHE_PAGES; f++)
+        free(index->frames[f].page);
+    close(index->fd);
+}
+
+// Page "page_number" of the index, from the cache or read into the least recently used frame
+static inline const uint64_t *btree_page(struct btree_index *index, uint64_t page_number)
+{
+    struct btree_cache_frame *victim = &index->frames[0];
+    for (int f = 0; f < BTREE_CACHE_PAGES; f++)
+    {
+        struct btree_cache_frame *frame = &index->frames[f];
+        if (frame->page_number == page_number)
+        {
+            frame->last_used = ++index->clock;
+            return frame->page;
+        }
+        if (frame->last_used < victim->last_used)
+            victim = frame;
+    }
+
+    if (pread(index->fd, victim->page, BTREE_PAGE_SIZE, page_number * BTREE_PAGE_SIZE) != BTREE_PAGE_SIZE)
+    {
+        fprintf(stderr, "Error reading page %lu of the B+-tree index\n", page_number);
+        exit(EXIT_FAILURE);
+    }
+    index->page_reads++;
+    victim->page_number = page_number;
+    victim->last_used = ++index->clock;
+    return victim->page;
+}
+
+// Largest entry of a page with a key <= value, -1 if every key of the page is greater
+static inline int btree_page_search(const uint64_t *page, uint64_t value)
+{
+    const struct btree_page_header *page_header = (const struct btree_page_header *)page;
+    const uint64_t *entries = page + 2;
+    int low = 0, high = (int)page_header->number_of_entries - 1, result = -1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        if (entries[2 * mid] <= value)
+        {
+            result = mid;
+            low = mid + 1;
+        }
+        else
+            high = mid - 1;
+    }
+    return result;
+}
+
+/**
+ * Pointer (position of the tuple in number of items) of the largest key <= value, the same answer as
+ * binarySearch over the dense index; UINT64_MAX if value is smaller than every key
+ */
+static inline uint64_t btree_lookup(struct btree_index *index, uint64_t value)
+{
+    uint64_t page_number = index->header.root_page;
+    for (int level = (int)index->header.number_of_levels - 1; level >= 0; level--)
+    {
+        const uint64_t *page = btree_page(index, page_number);
+        int entry = btree_page_search(page, value);
+        if (entry < 0)
+            return UINT64_MAX;          // only possible on the leftmost path: value is below the first key
+        page_number = page[2 + 2 * entry + 1];
+    }
+    return page_number;                 // at the leaves the "child" is the tuple pointer
+}
+
+#endif
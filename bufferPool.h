@@ -0,0 +1,175 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Buffer pool: a fixed number of frames, sized from a memory budget, that keep blocks read from the
+ * table files across queries
+ *
+ * A frame holds one block of one file, found through a chained hash table on (fd, block id).
+ * buffer_pool_pin returns the block (reading it into a frame on a miss) and keeps it in memory until the
+ * matching buffer_pool_unpin. A frame to reuse is picked by CLOCK: the hand sweeps the frames, skips
+ * the pinned ones, clears the reference bit of the recently used ones and evicts the first unpinned
+ * frame whose bit is already clear.
+ */
+#define BUFFER_POOL_NO_FRAME UINT32_MAX
+
+struct buffer_pool_frame
+{
+    int fd;                     // -1 for a free frame
+    uint64_t block_id;
+    uint32_t pin_count;
+    uint32_t referenced;        // CLOCK reference bit
+    uint32_t next;              // next frame of the same hash chain
+};
+
+struct buffer_pool
+{
+    size_t frame_size_in_bytes;
+    uint32_t number_of_frames;
+    char *memory;               // number_of_frames frames, page aligned
+    struct buffer_pool_frame *frames;
+    uint32_t *buckets;          // first frame of every hash chain
+    uint32_t bucket_mask;
+    uint32_t clock_hand;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+// Frames of frame_size_in_bytes for a budget of budget_in_bytes (at least one frame)
+static inline void buffer_pool_init(struct buffer_pool *pool, size_t frame_size_in_bytes, size_t budget_in_bytes)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->frame_size_in_bytes = (frame_size_in_bytes + 4095) / 4096 * 4096;
+    size_t number_of_frames = budget_in_bytes / pool->frame_size_in_bytes;
+    pool->number_of_frames = number_of_frames == 0 ? 1 : number_of_frames > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t)number_of_frames;
+
+    uint32_t number_of_buckets = 1;
+    while (number_of_buckets < pool->number_of_frames)
+        number_of_buckets *= 2;
+    pool->bucket_mask = number_of_buckets - 1;
+
+    pool->memory = aligned_alloc(4096, (size_t)pool->number_of_frames * pool->frame_size_in_bytes);
+    pool->frames = malloc(pool->number_of_frames * sizeof(struct buffer_pool_frame));
+    pool->buckets = malloc(number_of_buckets * sizeof(uint32_t));
+    if (pool->memory == NULL || pool->frames == NULL || pool->buckets == NULL)
+    {
+        perror("Memory allocation error for the buffer pool");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t f = 0; f < pool->number_of_frames; f++)
+    {
+        pool->frames[f].fd = -1;
+        pool->frames[f].pin_count = 0;
+        pool->frames[f].referenced = 0;
+        pool->frames[f].next = BUFFER_POOL_NO_FRAME;
+    }
+    for (uint32_t b = 0; b < number_of_buckets; b++)
+        pool->buckets[b] = BUFFER_POOL_NO_FRAME;
+}
+
+static inline void buffer_pool_free(struct buffer_pool *pool)
+{
+    free(pool->memory);
+    free(pool->frames);
+    free(pool->buckets);
+}
+
+static inline uint32_t buffer_pool_bucket(const struct buffer_pool *pool, int fd, uint64_t block_id)
+{
+    uint64_t hash = (block_id ^ ((uint64_t)fd << 48)) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(hash >> 32) & pool->bucket_mask;
+}
+
+static inline const uint64_t *buffer_pool_frame_data(const struct buffer_pool *pool, uint32_t frame)
+{
+    return (const uint64_t *)(pool->memory + (size_t)frame * pool->frame_size_in_bytes);
+}
+
+// CLOCK: the next unpinned frame whose reference bit is clear, taken out of its hash chain
+static inline uint32_t buffer_pool_evict(struct buffer_pool *pool)
+{
+    for (uint64_t swept = 0; swept < 2 * (uint64_t)pool->number_of_frames + 1; swept++)
+    {
+        uint32_t f = pool->clock_hand;
+        pool->clock_hand = pool->clock_hand + 1 == pool->number_of_frames ? 0 : pool->clock_hand + 1;
+        struct buffer_pool_frame *frame = &pool->frames[f];
+        if (frame->pin_count > 0)
+            continue;
+        if (frame->referenced)
+        {
+            frame->referenced = 0;
+            continue;
+        }
+
+        if (frame->fd != -1)
+        {
+            uint32_t *link = &pool->buckets[buffer_pool_bucket(pool, frame->fd, frame->block_id)];
+            while (*link != f)
+                link = &pool->frames[*link].next;
+            *link = frame->next;
+            pool->evictions++;
+        }
+        frame->fd = -1;
+        return f;
+    }
+
+    fprintf(stderr, "Buffer pool: all %u frames are pinned, give it a larger memory budget\n", pool->number_of_frames);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Pin block "block_id" of the file fd: it is read_size_in_bytes (at most the frame size) at file_offset.
+ * Returns the frame number (for buffer_pool_frame_data and buffer_pool_unpin)
+ */
+static inline uint32_t buffer_pool_pin(struct buffer_pool *pool, int fd, uint64_t block_id, off_t file_offset, size_t read_size_in_bytes)
+{
+    uint32_t bucket = buffer_pool_bucket(pool, fd, block_id);
+    for (uint32_t f = pool->buckets[bucket]; f != BUFFER_POOL_NO_FRAME; f = pool->frames[f].next)
+    {
+        struct buffer_pool_frame *frame = &pool->frames[f];
+        if (frame->fd == fd && frame->block_id == block_id)
+        {
+            frame->pin_count++;
+            frame->referenced = 1;
+            pool->hits++;
+            return f;
+        }
+    }
+
+    pool->misses++;
+    uint32_t f = buffer_pool_evict(pool);
+    struct buffer_pool_frame *frame = &pool->frames[f];
+    char *data = pool->memory + (size_t)f * pool->frame_size_in_bytes;
+    ssize_t bytes_read = pread(fd, data, read_size_in_bytes, file_offset);
+    if (bytes_read < 0)
+    {
+        perror("Buffer pool read error");
+        exit(EXIT_FAILURE);
+    }
+    if ((size_t)bytes_read < read_size_in_bytes)
+        memset(data + bytes_read, 0, read_size_in_bytes - bytes_read);     // the last block of a file can be short
+
+    frame->fd = fd;
+    frame->block_id = block_id;
+    frame->pin_count = 1;
+    frame->referenced = 1;
+    frame->next = pool->buckets[bucket];
+    pool->buckets[bucket] = f;
+    return f;
+}
+
+static inline void buffer_pool_unpin(struct buffer_pool *pool, uint32_t frame)
+{
+    if (frame != BUFFER_POOL_NO_FRAME && pool->frames[frame].pin_count > 0)
+        pool->frames[frame].pin_count--;
+}
+
+#endif
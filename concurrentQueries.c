@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "tableHandle.h"
+#include "queryExecutor.h"
+#include "tableUtilities.h"
+
+/**
+ * Throughput of independent range queries served concurrently: one table handle (tableHandle.h) shared
+ * read-only by the worker threads of a query executor (queryExecutor.h), queries/second for 1, 2, 4 ...
+ * threads up to the number of cores (or -t). Every run is checked against single-threaded results.
+ *
+ * The queries are COUNT(*) over a random key range of about -w keys:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ */
+
+// Wall clock in seconds: clock() adds up the CPU time of all the threads
+double now_in_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s <metadata file> [-q queries] [-t max threads] [-m dense_only|dense|sparse] [-w width] [-s seed]\n", program);
+    printf("  -q  queries per run (default 200000)\n");
+    printf("  -t  largest number of threads (default: the number of cores)\n");
+    printf("  -m  query method (default dense): dense_only reads only the dense index, dense and sparse count the keys in the data file\n");
+    printf("  -w  width of the key ranges (default 1000)\n");
+    printf("  -s  seed of the query ranges (default 42)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t number_of_queries = 200000;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    enum table_method method = TABLE_DENSE_INDEX;
+    uint64_t width = 1000;
+    uint64_t seed = 42;
+    int option;
+    while ((option = getopt(argc, argv, "q:t:m:w:s:")) != -1)
+    {
+        if (option == 'q' && atol(optarg) > 0)
+            number_of_queries = atol(optarg);
+        else if (option == 't' && atoi(optarg) > 0)
+            max_threads = atoi(optarg);
+        else if (option == 'm' && strcmp(optarg, "dense_only") == 0)
+            method = TABLE_DENSE_INDEX_ONLY;
+        else if (option == 'm' && strcmp(optarg, "dense") == 0)
+            method = TABLE_DENSE_INDEX;
+        else if (option == 'm' && strcmp(optarg, "sparse") == 0)
+            method = TABLE_SPARSE_INDEX;
+        else if (option == 'w')
+            width = strtoull(optarg, NULL, 10);
+        else if (option == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Step 1: open the table once, every thread queries the same handle
+    struct table table;
+    if (table_open(&table, argv[optind], MAP_POPULATE) != 0)
+        return EXIT_FAILURE;
+    printf("Table %s: %lu rows, %d columns, %s layout, %lu delta rows\n", table.skeleton, table.row_count, table.col_count,
+           layout_name(table.layout), table.delta.header.number_of_rows);
+    printf("Range count kernel: %s\n", select_range_count_kernel()->name);
+
+    // Step 2: the queries and their single-threaded results
+    struct range_query *queries = malloc(number_of_queries * sizeof(struct range_query));
+    uint64_t *expected = malloc(number_of_queries * sizeof(uint64_t));
+    uint64_t *results = malloc(number_of_queries * sizeof(uint64_t));
+    if (queries == NULL || expected == NULL || results == NULL)
+    {
+        perror("Memory allocation error for the queries");
+        return EXIT_FAILURE;
+    }
+    uint64_t state = seed;
+    generate_uniform_ranges(&table, queries, number_of_queries, width, &state);
+    uint64_t total_count = 0;
+    for (size_t q = 0; q < number_of_queries; q++)
+    {
+        expected[q] = table_count_by_dense_index_only(&table, queries[q].from, queries[q].to) + delta_index_count(&table.delta, queries[q].from, queries[q].to);
+        total_count += expected[q];
+    }
+    printf("%zu queries with the %s method, ranges of %lu keys, %lu tuples counted per run\n", number_of_queries,
+           table_method_name(method), width, total_count);
+
+    // Step 3: one run per thread count, 1, 2, 4 ... and max_threads
+    double single_thread_qps = 0;
+    int failed = 0;
+    for (int number_of_threads = 1; number_of_threads <= max_threads;
+         number_of_threads = number_of_threads * 2 > max_threads && number_of_threads < max_threads ? max_threads : number_of_threads * 2)
+    {
+        struct query_executor executor;
+        if (query_executor_start(&executor, number_of_threads) != 0)
+        {
+            perror("Error creating the executor threads");
+            return EXIT_FAILURE;
+        }
+        query_executor_run(&executor, &table, method, queries, results, number_of_queries < 1000 ? number_of_queries : 1000);       // warm up
+
+        memset(results, 0, number_of_queries * sizeof(uint64_t));
+        double start = now_in_seconds();
+        query_executor_run(&executor, &table, method, queries, results, number_of_queries);
+        double seconds = now_in_seconds() - start;
+        query_executor_stop(&executor);
+
+        if (memcmp(results, expected, number_of_queries * sizeof(uint64_t)) != 0)
+        {
+            printf("Error or incomplete implementation: %d threads\n", number_of_threads);
+            failed = 1;
+        }
+        double qps = number_of_queries / seconds;
+        single_thread_qps = number_of_threads == 1 ? qps : single_thread_qps;
+        printf("Threads %3d: %12.0f queries/s, speedup %5.2f, %f seconds\n", number_of_threads, qps, qps / single_thread_qps, seconds);
+    }
+
+    free(queries);
+    free(expected);
+    free(results);
+    table_close(&table);
+    return failed ? EXIT_FAILURE : 0;
+}
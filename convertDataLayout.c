@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tableLayout.h"
+#include "tableUtilities.h"
+
+uint64_t row_count = 0;
+int col_count = 0;
+char filenameSkeleteon[1024];
+enum table_layout source_layout = LAYOUT_ROW_MAJOR;
+
+/**
+ * Rewrite every block of the source data file in the target layout
+ * Blocks keep their size (padding included) and position, only the values inside a block move
+ * Returns 0, 1 if the source is short or the target cannot be written (the target is then incomplete)
+ */
+int convert_data_file(char *source_filename, char *target_filename, enum table_layout target_layout)
+{
+    int failed = 0;
+    size_t total_number_of_blocks_in_file = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+
+    int source_fd = open(source_filename, O_RDONLY);
+    if (source_fd == -1)
+    {
+        perror("Error opening source data file");
+        exit(EXIT_FAILURE);
+    }
+    struct data_file_geometry source_geometry, target_geometry;
+    if (read_data_file_geometry(source_fd, source_layout, col_count, &source_geometry) != 0)
+    {
+        printf("The header of %s does not match its metadata\n", source_filename);
+        close(source_fd);
+        exit(EXIT_FAILURE);
+    }
+    size_t block_size_in_bytes = block_stride_in_bytes(&source_geometry);
+    data_file_geometry_init(&target_geometry, target_layout, col_count, source_geometry.data_offset_in_items * sizeof(uint64_t), block_size_in_bytes);
+
+    int target_fd = open(target_filename, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (target_fd == -1)
+    {
+        perror("Error opening target data file");
+        close(source_fd);
+        exit(EXIT_FAILURE);
+    }
+    // a source without a header (packed blocks from offset 0) gives a target without one
+    if (target_geometry.data_offset_in_items > 0)
+    {
+        struct data_file_header header;
+        data_file_header_init(&header, row_count, &target_geometry);
+        if (ftruncate(target_fd, data_file_size_in_bytes(&target_geometry, total_number_of_blocks_in_file)) != 0 ||
+            pwrite(target_fd, &header, sizeof(header), 0) != sizeof(header))
+        {
+            perror("Error writing the target data file header");
+            failed = 1;
+        }
+    }
+
+    uint64_t *source_block = malloc(block_size_in_bytes);
+    uint64_t *target_block = calloc(1, block_size_in_bytes);       // the padding stays zero
+    if (source_block == NULL || target_block == NULL)
+    {
+        perror("Memory allocation error for the blocks");
+        failed = 1;
+    }
+
+    for (size_t block_index = 0; block_index < total_number_of_blocks_in_file && !failed; block_index++)
+    {
+        off_t file_offset = block_offset_in_bytes(&source_geometry, block_index);
+        if (pread(source_fd, source_block, block_size_in_bytes, file_offset) != block_size_in_bytes)
+        {
+            printf("Source data file is shorter than its metadata (block %zu)\n", block_index);
+            failed = 1;
+            break;
+        }
+
+        for (size_t t = 0; t < TUPLES_PER_BLOCK; t++)
+            for (int j = 0; j < col_count; j++)
+                target_block[item_in_block(target_layout, col_count, t, j)] = source_block[item_in_block(source_layout, col_count, t, j)];
+
+        if (pwrite(target_fd, target_block, block_size_in_bytes, file_offset) != block_size_in_bytes)
+        {
+            perror("Error writing target data file");
+            failed = 1;
+            break;
+        }
+    }
+
+    free(source_block);
+    free(target_block);
+    close(source_fd);
+    if (close(target_fd) == -1)
+    {
+        perror("Error closing target data file");
+        failed = 1;
+    }
+    return failed;
+}
+
+// Copy an index file as is: index pointers are logical tuple positions and do not depend on the layout
+void copy_index_file(char *source_filename, char *target_filename)
+{
+    int source_fd = open(source_filename, O_RDONLY);
+    if (source_fd == -1)
+    {
+        printf("No %s to copy, run createPrimaryKeyIndexFiles on the converted table\n", source_filename);
+        return;
+    }
+    int target_fd = open(target_filename, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (target_fd == -1)
+    {
+        perror("Error opening target index file");
+        exit(EXIT_FAILURE);
+    }
+
+    // A short or failed write would leave a truncated copy next to a valid metadata file: stop instead
+    char buffer[1 << 16];
+    ssize_t bytes_read;
+    while ((bytes_read = read(source_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t written = 0; written < bytes_read;)
+        {
+            ssize_t bytes_written = write(target_fd, buffer + written, bytes_read - written);
+            if (bytes_written <= 0)
+            {
+                perror("Error writing target index file");
+                exit(EXIT_FAILURE);
+            }
+            written += bytes_written;
+        }
+    }
+    if (bytes_read == -1)
+    {
+        perror("Error reading source index file");
+        exit(EXIT_FAILURE);
+    }
+
+    close(source_fd);
+    if (close(target_fd) == -1)
+    {
+        perror("Error closing target index file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        printf("Usage: %s <metadata file> <new filename> <row|pax>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int target_layout = parse_layout_name(argv[3]);
+    if (target_layout < 0)
+    {
+        printf("Unknown layout %s (expected row or pax)\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fptr;
+    char layout[16];
+    fptr = fopen(argv[1], "r");
+    if (fptr == NULL)
+    {
+        perror("Error opening metadata file");
+        return EXIT_FAILURE;
+    }
+    if (fscanf(fptr, "%s\n%lu\n%d\n%15s", filenameSkeleteon, &row_count, &col_count, layout) == 4)
+        source_layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+    fclose(fptr);
+
+    char *target_skeleton = argv[2];
+    char *source_data_filename = filename_with_extension(filenameSkeleteon, ".data");
+    char *target_data_filename = filename_with_extension(target_skeleton, ".data");
+
+    clock_t start_t = clock();
+    // No metadata for a partial target: it would open as a valid table and give wrong counts
+    if (convert_data_file(source_data_filename, target_data_filename, target_layout) != 0)
+    {
+        printf("Conversion of %s failed, %s is incomplete and no metadata was written for it\n", source_data_filename, target_data_filename);
+        free(source_data_filename);
+        free(target_data_filename);
+        return EXIT_FAILURE;
+    }
+
+    // The index files (and the packed copy, encoded column by column) only refer to tuples by their logical position, they are valid for both layouts
+    const char *index_extensions[] = {".dense_index", ".sparse_index", ".btree_index", ".learned_index", ".zonemap", ".bitmap_index", ".packed_data", ".aggregates"};
+    for (int i = 0; i < (int)(sizeof(index_extensions) / sizeof(index_extensions[0])); i++)
+    {
+        char *source_index_filename = filename_with_extension(filenameSkeleteon, index_extensions[i]);
+        char *target_index_filename = filename_with_extension(target_skeleton, index_extensions[i]);
+        copy_index_file(source_index_filename, target_index_filename);
+        free(source_index_filename);
+        free(target_index_filename);
+    }
+
+    // The delta segment (rows appended since the last merge) is row-major whatever the layout of the data file
+    char *source_delta_filename = filename_with_extension(filenameSkeleteon, ".delta");
+    char *target_delta_filename = filename_with_extension(target_skeleton, ".delta");
+    if (access(source_delta_filename, R_OK) == 0)
+        copy_index_file(source_delta_filename, target_delta_filename);
+    free(source_delta_filename);
+    free(target_delta_filename);
+
+    char *target_metadata_filename = filename_with_extension(target_skeleton, ".metadata");
+    fptr = fopen(target_metadata_filename, "w");
+    fprintf(fptr, "%s\n%lu\n%d\n%s", target_skeleton, row_count, col_count, layout_name(target_layout));
+    fclose(fptr);
+    clock_t end_t = clock();
+    float seconds_t = (float)(end_t - start_t) / CLOCKS_PER_SEC;
+
+    printf("Converted %s (%s) to %s (%s), Row Count %lu Column Count %d\n", source_data_filename, layout_name(source_layout),
+           target_data_filename, layout_name(target_layout), row_count, col_count);
+    printf("Time Taken to convert data: %f \n", seconds_t);
+
+    free(source_data_filename);
+    free(target_data_filename);
+    free(target_metadata_filename);
+    return 0;
+}
@@ -1,104 +1,499 @@
-#include <stdio.h>
-#include <stdint.h>
-#include <assert.h>
-#include <unistd.h>
-#include <time.h>
-#include <fcntl.h>
-#include <stdlib.h>
-#include <string.h>
-
-void createData(char* filename, int row_count, int column_count)
-{
-    int fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
-
-    // Allocating memory for One block of data
-    // Each block is comprised of 1024 tuples
-    int tuples_per_block = 400;
-    uint64_t tuple_size_in_bytes = column_count * sizeof(uint64_t);
-    uint64_t block_size_in_bytes = tuple_size_in_bytes * tuples_per_block; 
-    uint64_t *block_data = malloc(block_size_in_bytes);
-
-    off_t file_offset = 0;
-    uint64_t counter = 0;
-    int rc = 0;
-    for (int i = 0; i < row_count; i = i + tuples_per_block)
-    {
-        for (int b = 0; b < tuples_per_block; b++)
-        {
-            for (int j = 0; j < column_count; j++)
-            {
-                if (j == 0)
-                    block_data[b * column_count] = rc * 10 + rand() % 10;
-                else if (j == 1)
-                {
-                    if (i % 2 == 0)
-                        block_data[b * column_count + 1] = (row_count - rc) * 10 - rand() % 10;
-                    else
-                        block_data[b * column_count + 1] = (row_count - rc) * 10 + rand() % 10;
-                }
-                else if (j == 2)
-                    block_data[b * column_count + 2] = rand() % 1000;
-                else if (j == 3)
-                    block_data[b * column_count + 3] = rand() % 10000;
-                else if (j == 4)
-                    block_data[b * column_count + 4] = rand() % 100000;
-                else
-                    block_data[b * column_count + j] = counter++;
-            }
-            rc++;
-        }
-        
-        int write_count = pwrite(fd, block_data, block_size_in_bytes, file_offset);
-        if (write_count != block_size_in_bytes)
-        {
-            printf("SHOUT!!!!");
-            break;
-        }
-        
-        file_offset = file_offset + block_size_in_bytes;
-    }
-    free(block_data);
-    close(fd);
-}
-
-int main(int argc, char *argv[])
-{
-    srand(time(NULL));
-    
-    int row_count = atoi(argv[2]);
-    int col_count = atoi(argv[3]);
-    char *filename = argv[1];
-
-    char* data_finename_with_extension;
-    data_finename_with_extension = malloc(strlen(filename)+6);
-    strcpy(data_finename_with_extension, filename);
-    strcat(data_finename_with_extension, ".data"); 
-    
-
-    char* metadata_finename_with_extension;
-    metadata_finename_with_extension = malloc(strlen(filename)+10);
-    strcpy(metadata_finename_with_extension, filename); 
-    strcat(metadata_finename_with_extension, ".metadata"); 
-    
-
-    clock_t start_t = clock();
-    // data file
-    createData(data_finename_with_extension, row_count, col_count);
-
-    // MEtadata file
-    FILE *fptr;
-    fptr = fopen(metadata_finename_with_extension, "w");
-    fprintf(fptr, "%s\n%d\n%d", filename, row_count, col_count);
-    fclose(fptr);
-
-
-    clock_t end_t = clock();
-    float seconds_t = (float)(end_t - start_t) / CLOCKS_PER_SEC;
-
-    printf("Filenmae %s, %s Row Count %d Column Count %d\n", data_finename_with_extension, metadata_finename_with_extension, row_count, col_count);
-    printf("Time Taken to create data: %f \n", seconds_t);
-
-    free(metadata_finename_with_extension);
-    free(data_finename_with_extension);
-    return 0;
-}
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "tableLayout.h"
+
+/**
+ * Distribution of the primary keys (column 0), keys are always generated in increasing order
+ * (the data file is clustered on the key)
+ *
+ * KEYS_SEQUENTIAL: rc * 10 + rand() % 10, the original generator
+ * KEYS_UNIFORM:    gaps between consecutive keys uniform in [1, 19]
+ * KEYS_ZIPF:       gaps zipf distributed over [1, 1000], mostly dense keys with a heavy tail of large gaps
+ * KEYS_CLUSTERED:  runs of ~1000 nearly consecutive keys separated by gaps of 100000
+ *
+ * Distribution of the values of columns 2, 3 and 4 (domains of 1000, 10000 and 100000 values)
+ *
+ * VALUES_UNIFORM:  rand() % domain, the original generator
+ * VALUES_ZIPF:     zipf distributed over the domain, small values are the most frequent
+ */
+enum key_distribution
+{
+    KEYS_SEQUENTIAL = 0,
+    KEYS_UNIFORM,
+    KEYS_ZIPF,
+    KEYS_CLUSTERED
+};
+
+enum value_distribution
+{
+    VALUES_UNIFORM = 0,
+    VALUES_ZIPF
+};
+
+const char *key_distribution_names[] = {"sequential", "uniform", "zipf", "clustered"};
+const char *value_distribution_names[] = {"uniform", "zipf"};
+
+#define ZIPF_EXPONENT 1.2
+#define ZIPF_MAX_GAP 1000
+#define CLUSTERED_GAP 100000
+#define BLOCKS_PER_WRITE 64     // every pwrite writes up to 64 blocks
+
+/**
+ * xoshiro256** seeded through splitmix64
+ * Every block gets its own generators, seeded from (seed, block index, stream), so a data file only
+ * depends on the seed and not on the number of threads or on which thread generated which block
+ */
+struct xoshiro256
+{
+    uint64_t s[4];
+};
+
+uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void xoshiro256_seed(struct xoshiro256 *rng, uint64_t seed, uint64_t block_index, uint64_t stream)
+{
+    uint64_t state = seed ^ (block_index * 0xd1b54a32d192ed03ULL) ^ (stream << 62);
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&state);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro256_next(struct xoshiro256 *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Uniform double in [0, 1)
+static inline double xoshiro256_next_double(struct xoshiro256 *rng)
+{
+    return (xoshiro256_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Zipf distribution over [1, n], sampled by binary search in its cumulative distribution
+struct zipf_table
+{
+    double *cdf;
+    size_t n;
+};
+
+void zipf_table_init(struct zipf_table *table, size_t n, double exponent)
+{
+    table->n = n;
+    table->cdf = malloc(n * sizeof(double));
+    double sum = 0;
+    for (size_t k = 1; k <= n; k++)
+        sum += 1.0 / pow((double)k, exponent);
+    double running = 0;
+    for (size_t k = 1; k <= n; k++)
+    {
+        running += 1.0 / pow((double)k, exponent) / sum;
+        table->cdf[k - 1] = running;
+    }
+    table->cdf[n - 1] = 1.0;
+}
+
+static inline uint64_t zipf_sample(const struct zipf_table *table, struct xoshiro256 *rng)
+{
+    double u = xoshiro256_next_double(rng);
+    size_t low = 0, high = table->n - 1;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (table->cdf[mid] < u)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low + 1;
+}
+
+// Generator settings, shared read-only by all the threads
+int row_count = 0;
+int column_count = 0;
+enum table_layout layout = LAYOUT_ROW_MAJOR;
+const char *block_size_name = "compact";
+struct data_file_geometry geometry;     // header page, then blocks of the -b block size
+enum key_distribution key_distribution = KEYS_SEQUENTIAL;
+enum value_distribution value_distribution = VALUES_UNIFORM;
+uint64_t seed = 0;
+int fd = -1;
+
+struct zipf_table gap_zipf;             // key gaps (KEYS_ZIPF)
+struct zipf_table value_zipf[3];        // columns 2, 3 and 4 (VALUES_ZIPF)
+uint64_t *block_first_key_base;         // key of the tuple before each block (all distributions but KEYS_SEQUENTIAL)
+
+// Every thread owns the blocks [first_block, end_block)
+struct generator_thread
+{
+    pthread_t thread;
+    size_t first_block;
+    size_t end_block;
+    int failed;
+};
+
+// Gap between a key and the previous one
+static inline uint64_t next_key_gap(struct xoshiro256 *rng)
+{
+    switch (key_distribution)
+    {
+    case KEYS_UNIFORM:
+        return 1 + xoshiro256_next(rng) % 19;
+    case KEYS_ZIPF:
+        return zipf_sample(&gap_zipf, rng);
+    case KEYS_CLUSTERED:
+        return xoshiro256_next(rng) % 1000 == 0 ? CLUSTERED_GAP : 1 + xoshiro256_next(rng) % 2;
+    default:
+        return 10;
+    }
+}
+
+// First pass of the gap distributions: the key span of every block, turned into block bases by a prefix sum
+void *measure_key_spans(void *argument)
+{
+    struct generator_thread *thread = argument;
+    for (size_t block_index = thread->first_block; block_index < thread->end_block; block_index++)
+    {
+        struct xoshiro256 key_rng;
+        xoshiro256_seed(&key_rng, seed, block_index, 0);
+        uint64_t span = 0;
+        for (int b = 0; b < TUPLES_PER_BLOCK; b++)
+            span += next_key_gap(&key_rng);
+        block_first_key_base[block_index + 1] = span;
+    }
+    return NULL;
+}
+
+// Fill one block (TUPLES_PER_BLOCK tuples starting at tuple rc) in the layout of the data file
+void generate_block(uint64_t *block_data, size_t block_index)
+{
+    struct xoshiro256 key_rng, value_rng;
+    xoshiro256_seed(&key_rng, seed, block_index, 0);
+    xoshiro256_seed(&value_rng, seed, block_index, 1);
+
+    uint64_t rc = block_index * TUPLES_PER_BLOCK;
+    uint64_t i = rc;                                    // row of the first tuple of the block
+    uint64_t key = key_distribution == KEYS_SEQUENTIAL ? 0 : block_first_key_base[block_index];
+    for (int b = 0; b < TUPLES_PER_BLOCK; b++)
+    {
+        for (int j = 0; j < column_count; j++)
+        {
+            // the layout decides where the value of column j of tuple b sits in the block
+            uint64_t *value = &block_data[item_in_block(layout, column_count, b, j)];
+            if (j == 0)
+            {
+                if (key_distribution == KEYS_SEQUENTIAL)
+                    key = rc * 10 + xoshiro256_next(&key_rng) % 10;
+                else
+                    key = key + next_key_gap(&key_rng);
+                *value = key;
+            }
+            else if (j == 1)
+            {
+                if (i % 2 == 0)
+                    *value = (row_count - rc) * 10 - xoshiro256_next(&value_rng) % 10;
+                else
+                    *value = (row_count - rc) * 10 + xoshiro256_next(&value_rng) % 10;
+            }
+            else if (j <= 4)
+            {
+                // columns 2, 3 and 4 have domains of 1000, 10000 and 100000 values
+                if (value_distribution == VALUES_ZIPF)
+                    *value = zipf_sample(&value_zipf[j - 2], &value_rng) - 1;
+                else
+                    *value = xoshiro256_next(&value_rng) % (j == 2 ? 1000 : j == 3 ? 10000 : 100000);
+            }
+            else
+                *value = rc * (column_count - 5) + (j - 5);     // the counter, continued across rows
+        }
+        rc++;
+    }
+}
+
+// Generate the blocks of a thread and write them, BLOCKS_PER_WRITE blocks per pwrite at their final offset
+void *generate_blocks(void *argument)
+{
+    struct generator_thread *thread = argument;
+    size_t block_stride_in_items = geometry.block_stride_in_items;
+    uint64_t *write_buffer = calloc(block_stride_in_items * BLOCKS_PER_WRITE, sizeof(uint64_t));      // the padding stays zero
+    if (write_buffer == NULL)
+    {
+        perror("Memory allocation error for write_buffer");
+        thread->failed = 1;
+        return NULL;
+    }
+
+    for (size_t batch_block = thread->first_block; batch_block < thread->end_block; batch_block += BLOCKS_PER_WRITE)
+    {
+        size_t blocks_in_batch = thread->end_block - batch_block < BLOCKS_PER_WRITE ? thread->end_block - batch_block : BLOCKS_PER_WRITE;
+        for (size_t k = 0; k < blocks_in_batch; k++)
+            generate_block(write_buffer + k * block_stride_in_items, batch_block + k);
+
+        size_t bytes_to_write = blocks_in_batch * block_stride_in_bytes(&geometry);
+        ssize_t write_count = pwrite(fd, write_buffer, bytes_to_write, block_offset_in_bytes(&geometry, batch_block));
+        if (write_count != (ssize_t)bytes_to_write)
+        {
+            printf("SHOUT!!!!");
+            thread->failed = 1;
+            break;
+        }
+    }
+    free(write_buffer);
+    return NULL;
+}
+
+/**
+ * Run "work" on number_of_threads threads, each owning a contiguous range of the blocks
+ * Returns 0, 1 if a thread could not be started or failed (only the threads started are joined)
+ */
+int run_on_threads(void *(*work)(void *), size_t total_number_of_blocks, int number_of_threads)
+{
+    struct generator_thread *threads = calloc(number_of_threads, sizeof(struct generator_thread));
+    if (threads == NULL)
+    {
+        perror("Memory allocation error for the generator threads");
+        return 1;
+    }
+    size_t blocks_per_thread = (total_number_of_blocks + number_of_threads - 1) / number_of_threads;
+    int failed = 0;
+    int number_of_started_threads = 0;
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        threads[t].first_block = t * blocks_per_thread < total_number_of_blocks ? t * blocks_per_thread : total_number_of_blocks;
+        threads[t].end_block = threads[t].first_block + blocks_per_thread < total_number_of_blocks ? threads[t].first_block + blocks_per_thread : total_number_of_blocks;
+        int error = pthread_create(&threads[t].thread, NULL, work, &threads[t]);
+        if (error != 0)
+        {
+            fprintf(stderr, "Error starting generator thread %d: %s\n", t, strerror(error));
+            failed = 1;
+            break;
+        }
+        number_of_started_threads++;
+    }
+
+    for (int t = 0; t < number_of_started_threads; t++)
+    {
+        pthread_join(threads[t].thread, NULL);
+        failed |= threads[t].failed;
+    }
+    free(threads);
+    return failed;
+}
+
+// Write the data file; returns 0, 1 if it could not be written in full
+int createData(char* filename, int number_of_threads)
+{
+    fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (fd == -1)
+    {
+        perror(filename);
+        return 1;
+    }
+
+    // Every block is comprised of 400 tuples, the last block is written in full, after the header page
+    size_t total_number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    if (ftruncate(fd, data_file_size_in_bytes(&geometry, total_number_of_blocks)) != 0)
+    {
+        perror("Error sizing data file");
+        return 1;
+    }
+    struct data_file_header header;
+    data_file_header_init(&header, row_count, &geometry);
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+        perror("Error writing the data file header");
+        return 1;
+    }
+
+    if (key_distribution == KEYS_ZIPF)
+        zipf_table_init(&gap_zipf, ZIPF_MAX_GAP, ZIPF_EXPONENT);
+    if (value_distribution == VALUES_ZIPF)
+        for (int c = 0; c < 3; c++)
+            zipf_table_init(&value_zipf[c], c == 0 ? 1000 : c == 1 ? 10000 : 100000, ZIPF_EXPONENT);
+
+    // The gap distributions need the key each block starts from: measure every block's span, then prefix sum
+    int failed = 0;
+    if (key_distribution != KEYS_SEQUENTIAL)
+    {
+        block_first_key_base = calloc(total_number_of_blocks + 1, sizeof(uint64_t));
+        if (block_first_key_base == NULL)
+        {
+            perror("Memory allocation error for the block key bases");
+            failed = 1;
+        }
+        else
+            failed = run_on_threads(measure_key_spans, total_number_of_blocks, number_of_threads);
+        for (size_t b = 1; b <= total_number_of_blocks && !failed; b++)
+            block_first_key_base[b] += block_first_key_base[b - 1];
+    }
+
+    if (!failed)
+        failed = run_on_threads(generate_blocks, total_number_of_blocks, number_of_threads);
+
+    free(block_first_key_base);
+    if (key_distribution == KEYS_ZIPF)
+        free(gap_zipf.cdf);
+    if (value_distribution == VALUES_ZIPF)
+        for (int c = 0; c < 3; c++)
+            free(value_zipf[c].cdf);
+    if (close(fd) == -1)
+    {
+        perror("Error closing data file");
+        failed = 1;
+    }
+    return failed;
+}
+
+int parse_distribution(const char *name, const char *names[], int count)
+{
+    for (int d = 0; d < count; d++)
+        if (strcmp(name, names[d]) == 0)
+            return d;
+    return -1;
+}
+
+void usage(char *program)
+{
+    printf("Usage: %s <filename> <row count> <column count> [row|pax] [-t threads] [-s seed]\n", program);
+    printf("          [-k sequential|uniform|zipf|clustered] [-v uniform|zipf] [-b compact|sector|page|bytes]\n");
+    printf("  -t  number of generator threads (default: number of cores)\n");
+    printf("  -s  seed, the same seed generates the same data file whatever the number of threads (default: time)\n");
+    printf("  -k  distribution of the primary keys (default sequential, rc * 10 + rand() %% 10)\n");
+    printf("  -v  distribution of the values of columns 2 to 4 (default uniform)\n");
+    printf("  -b  block size: the 400 tuples (compact, the default), rounded up to 512 bytes (sector) or 4096 bytes (page)\n");
+    printf("      so every block is aligned for O_DIRECT, or a number of bytes (a multiple of 512)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int number_of_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    seed = time(NULL);
+
+    int option;
+    while ((option = getopt(argc, argv, "t:s:k:v:b:")) != -1)
+    {
+        int parsed = 0;
+        if (option == 't')
+            parsed = number_of_threads = atoi(optarg);
+        else if (option == 's')
+        {
+            seed = strtoull(optarg, NULL, 10);
+            parsed = 1;
+        }
+        else if (option == 'k' && (parsed = parse_distribution(optarg, key_distribution_names, 4) + 1) > 0)
+            key_distribution = parsed - 1;
+        else if (option == 'v' && (parsed = parse_distribution(optarg, value_distribution_names, 2) + 1) > 0)
+            value_distribution = parsed - 1;
+        else if (option == 'b')
+        {
+            block_size_name = optarg;
+            parsed = 1;
+        }
+        if (parsed <= 0)
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind < 3)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *filename = argv[optind];
+    row_count = atoi(argv[optind + 1]);
+    column_count = atoi(argv[optind + 2]);
+
+    // Optional 4th argument: block layout of the data file ("row", the default, or "pax")
+    if (argc - optind > 3)
+    {
+        int parsed_layout = parse_layout_name(argv[optind + 3]);
+        if (parsed_layout < 0)
+        {
+            fprintf(stderr, "Unknown layout %s (expected row or pax)\n", argv[optind + 3]);
+            return EXIT_FAILURE;
+        }
+        layout = parsed_layout;
+    }
+
+    size_t block_size = parse_block_size(block_size_name, column_count);
+    if (block_size == 0)
+    {
+        fprintf(stderr, "Block size %s cannot hold %d tuples of %d columns (%zu bytes) or is not a multiple of %d\n", block_size_name,
+                TUPLES_PER_BLOCK, column_count, block_payload_in_bytes(column_count), DATA_FILE_SECTOR_SIZE);
+        return EXIT_FAILURE;
+    }
+    data_file_geometry_init(&geometry, layout, column_count, DATA_FILE_HEADER_SIZE, block_size);
+
+    char* data_finename_with_extension;
+    data_finename_with_extension = malloc(strlen(filename)+6);
+    strcpy(data_finename_with_extension, filename);
+    strcat(data_finename_with_extension, ".data");
+
+
+    char* metadata_finename_with_extension;
+    metadata_finename_with_extension = malloc(strlen(filename)+10);
+    strcpy(metadata_finename_with_extension, filename);
+    strcat(metadata_finename_with_extension, ".metadata");
+
+
+    // wall clock: clock() would add up the CPU time of all the generator threads
+    struct timespec start_t, end_t;
+    clock_gettime(CLOCK_MONOTONIC, &start_t);
+    // data file (no metadata for a partial one: it would open as a valid table and give wrong counts)
+    if (createData(data_finename_with_extension, number_of_threads) != 0)
+    {
+        printf("Could not write %s, no metadata was written for it\n", data_finename_with_extension);
+        free(metadata_finename_with_extension);
+        free(data_finename_with_extension);
+        return EXIT_FAILURE;
+    }
+
+    // MEtadata file
+    FILE *fptr;
+    fptr = fopen(metadata_finename_with_extension, "w");
+    fprintf(fptr, "%s\n%d\n%d\n%s", filename, row_count, column_count, layout_name(layout));
+    fclose(fptr);
+
+
+    clock_gettime(CLOCK_MONOTONIC, &end_t);
+    float seconds_t = (end_t.tv_sec - start_t.tv_sec) + (end_t.tv_nsec - start_t.tv_nsec) / 1e9;
+
+    printf("Filenmae %s, %s Row Count %d Column Count %d Layout %s\n", data_finename_with_extension, metadata_finename_with_extension, row_count, column_count, layout_name(layout));
+    printf("Keys %s, Values %s, Seed %lu, Threads %d, Blocks of %zu bytes (%zu of tuples)\n", key_distribution_names[key_distribution],
+           value_distribution_names[value_distribution], seed, number_of_threads, block_size, block_payload_in_bytes(column_count));
+    printf("Time Taken to create data: %f \n", seconds_t);
+
+    free(metadata_finename_with_extension);
+    free(data_finename_with_extension);
+    return 0;
+}
@@ -1,170 +1,216 @@
-#include <stdio.h>
-#include <stdint.h>
-#include <assert.h>
-#include <unistd.h>
-#include <time.h>
-#include <fcntl.h>
-#include <stdlib.h>
-#include <string.h>
-
-uint64_t row_count = 0;
-int col_count = 0;
-char filenameSkeleteon[1024];
-
-char *data_filename;            // Data file name (ending in .data)
-char *sparse_index_filename;    // sparse index file name (ending in .sparse_index)
-char *dense_index_filename;     // dense file name (ending in .dense_index)
-
-// Function to write dense index file
-void create_dense_clustering_key()
-{
-    // Step 1: Allocate block buffer to read data from the data file
-    size_t block_size_in_number_of_items = col_count * 400;     // Every block is composed of 400 rows
-    size_t block_size_in_bytes = block_size_in_number_of_items * sizeof(uint64_t);
-    size_t total_number_of_blocks_in_file = (row_count * col_count) / block_size_in_number_of_items;
-    uint64_t *block_data = malloc(block_size_in_bytes);
-
-    // Step 2: the index file is made up of two columns and "row_count" rows, 
-    // col1 stores the actual keys and col2 stores the file pointer (in terms of count, and not bytes)
-    size_t index_buffer_size_in_number_of_items = row_count * 2;
-    size_t index_buffer_size_in_bytes = index_buffer_size_in_number_of_items * sizeof(uint64_t);
-	uint64_t *index_buffer = malloc(index_buffer_size_in_bytes);
-
-    // Step 3: read the data file, block by block and populate the index_buffer
-    int tuple_count = 0;
-    int fd =  open(data_filename, O_RDONLY);
-    off_t file_offset = 0;
-    for (int i=0; i < total_number_of_blocks_in_file; i++)
-	{
-        pread(fd, block_data, block_size_in_bytes, file_offset);
-        file_offset = file_offset + block_size_in_bytes;
-
-        // Since data is stored in row-major order, we are iterating in strides of col_count    
-		for (int j=0; j < block_size_in_number_of_items; j=j+col_count)
-        {
-            // Step 4: create the entries of the dense index file
-			index_buffer[2 * tuple_count + 0] = block_data[j];
-			index_buffer[2 * tuple_count + 1] = tuple_count * col_count;
-            //printf("IB %d %d\n", index_buffer[2 * tuple_count + 0], index_buffer[2 * tuple_count + 1]);
-            tuple_count = tuple_count + 1;
-		}
-	}
-	close(fd);
-	
-    // Step 5: Write the index buffer to file (to be later opened while performing queries)
-	int indexF =  open(dense_index_filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
-    write(indexF, index_buffer, index_buffer_size_in_bytes);
-	close(indexF);
-
-	free(index_buffer);
-    free(block_data);
-}
-
-
-// TODO - Task 1 - Implement this function to generate sparse index file
-// The index file should be one magnitude smaller in size compared to the dense index file
-// (simplest way to implement this will be to store every 10th key in the sparse index file
-void create_sparse_clustering_key()
-{
-    // Assuming each row in your data file is structured as 'col_count' number of uint64_t values
-    size_t row_byte_size = col_count * sizeof(uint64_t);
-
-    // Open the data file
-    int fd = open(data_filename, O_RDONLY);
-    if (fd == -1) {
-        perror("Error opening data file");
-        exit(EXIT_FAILURE);
-    }
-
-    // Allocate memory for one row
-    uint64_t *row_data = malloc(row_byte_size);
-    if (row_data == NULL) {
-        perror("Memory allocation error for row_data");
-        close(fd);
-        exit(EXIT_FAILURE);
-    }
-
-    // Create the sparse index buffer
-    size_t sparse_index_entries = (row_count / 10) + (row_count % 10 != 0);
-    size_t sparse_index_buffer_size = sparse_index_entries * 2 * sizeof(uint64_t);
-    uint64_t *sparse_index_buffer = malloc(sparse_index_buffer_size);
-    if (sparse_index_buffer == NULL) {
-        perror("Memory allocation error for sparse_index_buffer");
-        close(fd);
-        free(row_data);
-        exit(EXIT_FAILURE);
-    }
-
-    // Read every 10th row and store in sparse index
-    for (size_t i = 0, j = 0; i < row_count; i++) {
-        pread(fd, row_data, row_byte_size, i * row_byte_size);
-        if (i % 10 == 0) {
-            sparse_index_buffer[j++] = row_data[0]; // First element as key
-            sparse_index_buffer[j++] = i * row_byte_size; // Byte offset
-        }
-    }
-
-    // Write sparse index to file
-    int sparse_index_fd = open(sparse_index_filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
-    if (sparse_index_fd == -1) {
-        perror("Error opening sparse index file");
-        free(row_data);
-        free(sparse_index_buffer);
-        close(fd);
-        exit(EXIT_FAILURE);
-    }
-    write(sparse_index_fd, sparse_index_buffer, sparse_index_buffer_size);
-    close(sparse_index_fd);
-
-    // Clean up
-    free(row_data);
-    free(sparse_index_buffer);
-    close(fd);
-}
-
-
-int main(int argc, char *argv[])
-{
-    char *filename = argv[1];
-    
-    FILE *fptr;
-    fptr = fopen(filename, "r");
-    fscanf(fptr, "%s\n%lu\n%d", filenameSkeleteon, &row_count, &col_count);
-    fclose(fptr);
-
-    data_filename = malloc(strlen(filenameSkeleteon) + 6);
-    strcpy(data_filename, filenameSkeleteon);
-    strcat(data_filename, ".data");
-
-    sparse_index_filename = malloc(strlen(filenameSkeleteon) + 14);
-    strcpy(sparse_index_filename, filenameSkeleteon);
-    strcat(sparse_index_filename, ".sparse_index");
-
-    dense_index_filename = malloc(strlen(filenameSkeleteon) + 13);
-    strcpy(dense_index_filename, filenameSkeleteon);
-    strcat(dense_index_filename, ".dense_index");
-
-    printf("Data file name %s\n", data_filename);
-    printf("Index file name %s\n", dense_index_filename);
-
-
-    clock_t start_di = clock();
-    create_dense_clustering_key();        
-    clock_t end_di = clock();
-    float seconds_di = (float)(end_di - start_di) / CLOCKS_PER_SEC;
-
-
-    clock_t start_si = clock();
-    create_sparse_clustering_key();        
-    clock_t end_si = clock();
-    float seconds_si = (float)(end_si - start_si) / CLOCKS_PER_SEC;
-
-    printf("Time Taken to create Dense Index file, %s: %f \n", dense_index_filename, seconds_di);
-    printf("Time Taken to create Sparse Index file, %s: %f \n", sparse_index_filename, seconds_si);
-
-    free(data_filename);
-    free(sparse_index_filename);
-    free(dense_index_filename);
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "tableLayout.h"
+#include "indexBuilder.h"
+
+uint64_t row_count = 0;
+int col_count = 0;
+char filenameSkeleteon[1024];
+enum table_layout data_layout = LAYOUT_ROW_MAJOR;    // block layout of the data file (row-major or PAX)
+struct data_file_geometry data_geometry;            // where the blocks are in the data file (its header)
+
+char *data_filename;            // Data file name (ending in .data)
+uint64_t learned_index_error_bound = LEARNED_INDEX_DEFAULT_ERROR_BOUND;
+
+#define SPARSE_INDEX_INTERVAL KEY_INDEX_SPARSE_DEFAULT_STRIDE      // the sparse index keeps the key of every 10th row by default
+#define BLOCKS_PER_READ 64                      // every pread of a builder thread reads up to 64 blocks
+uint64_t sparse_index_interval = SPARSE_INDEX_INTERVAL;     // tuples per sparse index entry (-g)
+
+struct index_build build;       // the index files, their names and what the builder threads share
+
+/**
+ * The index builder makes ONE pass over the data file and writes all the index files from it (see indexBuilder.h)
+ *
+ * The blocks of the data file are split in contiguous ranges, one per thread. Every thread reads its
+ * blocks BLOCKS_PER_READ at a time and hands every block to index_block, which appends its entries to
+ * each index output at the thread's precomputed offsets. The last bitmap chunk starting in a range ends
+ * in the next one: the thread reads its other tuples before finishing.
+ */
+
+// Bitmap index: the last chunk starting in the thread's range ends in the next range, its other tuples are read here
+void index_last_chunk_bitmaps(struct builder_thread *thread, int fd, uint64_t *block_data)
+{
+    uint64_t end_tuple = thread->end_block * TUPLES_PER_BLOCK < row_count ? thread->end_block * TUPLES_PER_BLOCK : row_count;
+    if (build.bitmap_chunk_sizes[0] == NULL || end_tuple <= thread->first_bitmap_tuple || end_tuple % BITMAP_CHUNK_ROWS == 0 || end_tuple == row_count)
+        return;
+    uint64_t chunk_end_tuple = (end_tuple / BITMAP_CHUNK_ROWS + 1) * BITMAP_CHUNK_ROWS;
+    chunk_end_tuple = chunk_end_tuple < row_count ? chunk_end_tuple : row_count;
+    size_t chunk_end_block = (chunk_end_tuple + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+
+    for (size_t batch_block = thread->end_block; batch_block < chunk_end_block && !thread->failed; batch_block += BLOCKS_PER_READ)
+    {
+        size_t blocks_in_batch = chunk_end_block - batch_block < BLOCKS_PER_READ ? chunk_end_block - batch_block : BLOCKS_PER_READ;
+        ssize_t bytes_read = pread(fd, block_data, blocks_in_batch * block_stride_in_bytes(&data_geometry), block_offset_in_bytes(&data_geometry, batch_block));
+        if (bytes_read < (ssize_t)(blocks_in_batch * block_stride_in_bytes(&data_geometry)))
+        {
+            fprintf(stderr, "Data file %s is shorter than its metadata (block %zu)\n", data_filename, batch_block);
+            thread->failed = 1;
+            break;
+        }
+        for (size_t k = 0; k < blocks_in_batch; k++)
+            for (size_t j = 0; j < TUPLES_PER_BLOCK; j++)
+            {
+                uint64_t tuple_index = (batch_block + k) * TUPLES_PER_BLOCK + j;
+                if (tuple_index >= chunk_end_tuple)
+                    break;
+                index_tuple_bitmaps(thread, tuple_index, block_data + k * data_geometry.block_stride_in_items, j);
+            }
+    }
+}
+
+void *build_index_range(void *argument)
+{
+    struct builder_thread *thread = argument;
+    size_t block_size_in_number_of_items = data_geometry.block_stride_in_items;     // Every block is composed of 400 rows and its padding
+    size_t block_size_in_bytes = block_stride_in_bytes(&data_geometry);
+
+    uint64_t *block_data = malloc(block_size_in_bytes * BLOCKS_PER_READ);
+    int fd = open(data_filename, O_RDONLY);
+    if (fd == -1 || block_data == NULL)
+    {
+        perror("Error opening data file");
+        thread->failed = 1;
+    }
+
+    for (size_t batch_block = thread->first_block; batch_block < thread->end_block && !thread->failed; batch_block += BLOCKS_PER_READ)
+    {
+        size_t blocks_in_batch = thread->end_block - batch_block < BLOCKS_PER_READ ? thread->end_block - batch_block : BLOCKS_PER_READ;
+        ssize_t bytes_read = pread(fd, block_data, blocks_in_batch * block_size_in_bytes, block_offset_in_bytes(&data_geometry, batch_block));
+        if (bytes_read < (ssize_t)(blocks_in_batch * block_size_in_bytes))
+        {
+            fprintf(stderr, "Data file %s is shorter than its metadata (block %zu)\n", data_filename, batch_block);
+            thread->failed = 1;
+            break;
+        }
+
+        for (size_t k = 0; k < blocks_in_batch; k++)
+            index_block(thread, batch_block + k, block_data + k * block_size_in_number_of_items);
+    }
+    if (!thread->failed)
+        index_last_chunk_bitmaps(thread, fd, block_data);
+
+    builder_thread_finish(thread);
+    if (fd != -1)
+        close(fd);
+    free(block_data);
+    return NULL;
+}
+
+// Write the dense, sparse, B+-tree, learned index, zone map, bitmap index, packed data and aggregates files in one pass over the data file
+int create_index_files(int number_of_threads)
+{
+    size_t total_number_of_blocks_in_file = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    index_build_open(&build);
+
+    struct builder_thread *threads = calloc(number_of_threads, sizeof(struct builder_thread));
+    size_t blocks_per_thread = (total_number_of_blocks_in_file + number_of_threads - 1) / number_of_threads;
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        size_t first_block = t * blocks_per_thread < total_number_of_blocks_in_file ? t * blocks_per_thread : total_number_of_blocks_in_file;
+        size_t end_block = first_block + blocks_per_thread < total_number_of_blocks_in_file ? first_block + blocks_per_thread : total_number_of_blocks_in_file;
+        builder_thread_start(&build, &threads[t], first_block, end_block);
+        pthread_create(&threads[t].thread, NULL, build_index_range, &threads[t]);
+    }
+    for (int t = 0; t < number_of_threads; t++)
+        pthread_join(threads[t].thread, NULL);
+
+    int failed = index_build_finish(&build, threads, number_of_threads);
+    free(threads);
+    return failed;
+}
+
+
+// Tuples per sparse index entry of a -g option: a number of tuples, "block" or "<n>blocks" (n blocks of 400 tuples)
+// Returns 0 for anything else
+uint64_t parse_sparse_granularity(const char *name)
+{
+    char *end;
+    uint64_t n = strtoull(name, &end, 10);
+    if (strcmp(name, "block") == 0)
+        return TUPLES_PER_BLOCK;
+    if (end != name && strcmp(end, "blocks") == 0)
+        return n * TUPLES_PER_BLOCK;
+    return end != name && *end == '\0' ? n : 0;
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s <metadata file> [-t threads] [-e learned index error bound] [-g sparse granularity]\n", program);
+    printf("  -t  number of builder threads (default: number of cores)\n");
+    printf("  -e  largest distance between a key's predicted and real position in the learned index (default %d)\n", LEARNED_INDEX_DEFAULT_ERROR_BOUND);
+    printf("  -g  tuples per sparse index entry: a number (default %d), block (one entry per block) or <n>blocks\n", SPARSE_INDEX_INTERVAL);
+}
+
+int main(int argc, char *argv[])
+{
+    int number_of_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int option;
+    while ((option = getopt(argc, argv, "t:e:g:")) != -1)
+    {
+        if (option == 't' && atoi(optarg) > 0)
+            number_of_threads = atoi(optarg);
+        else if (option == 'e' && atoi(optarg) > 0)
+            learned_index_error_bound = atoi(optarg);
+        else if (option == 'g' && parse_sparse_granularity(optarg) > 0)
+            sparse_index_interval = parse_sparse_granularity(optarg);
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *filename = argv[optind];
+
+    FILE *fptr;
+    char layout[16];
+    fptr = fopen(filename, "r");
+    if (fscanf(fptr, "%s\n%lu\n%d\n%15s", filenameSkeleteon, &row_count, &col_count, layout) == 4)
+        data_layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+    fclose(fptr);
+
+    data_filename = filename_with_extension(filenameSkeleteon, ".data");
+
+    int data_fd = open(data_filename, O_RDONLY);
+    if (data_fd == -1 || read_data_file_geometry(data_fd, data_layout, col_count, &data_geometry) != 0)
+    {
+        fprintf(stderr, "Data file %s is missing or its header does not match the metadata\n", data_filename);
+        return EXIT_FAILURE;
+    }
+    close(data_fd);
+    index_build_init(&build, filenameSkeleteon, row_count, col_count, data_layout, &data_geometry, sparse_index_interval, learned_index_error_bound);
+
+    printf("Data file name %s (blocks of %zu bytes)\n", data_filename, block_stride_in_bytes(&data_geometry));
+    printf("Index file name %s\n", build.dense_index_filename);
+    printf("Sparse index: one entry per %lu tuples\n", sparse_index_interval);
+
+
+    // wall clock: clock() would add up the CPU time of all the builder threads
+    struct timespec start_i, end_i;
+    clock_gettime(CLOCK_MONOTONIC, &start_i);
+    int failed = create_index_files(number_of_threads);
+    clock_gettime(CLOCK_MONOTONIC, &end_i);
+    float seconds_i = (end_i.tv_sec - start_i.tv_sec) + (end_i.tv_nsec - start_i.tv_nsec) / 1e9;
+
+    printf("Time Taken to create Dense Index file, %s, Sparse Index file, %s, B+-tree Index file, %s, Learned Index file, %s, Zone map, %s, Bitmap index, %s, Packed data, %s and Aggregates, %s (one pass, %d threads): %f \n",
+           build.dense_index_filename, build.sparse_index_filename, build.btree_index_filename, build.learned_index_filename, build.zonemap_filename,
+           build.bitmap_index_filename, build.packed_data_filename, build.aggregate_filename, number_of_threads, seconds_i);
+
+    free(data_filename);
+    index_build_free(&build);
+
+    return failed ? EXIT_FAILURE : 0;
+}
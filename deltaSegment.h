@@ -0,0 +1,240 @@
+#ifndef DELTA_SEGMENT_H
+#define DELTA_SEGMENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+/**
+ * Delta segment of a table (the .delta file): the rows appended since the data file was last merged
+ *
+ * Every append writes one run, a batch of rows sorted on the key (row-major, col_count values per row,
+ * like a tuple of the data file), at the end of the file. The header is rewritten after the run, so it
+ * is the commit point: a reader only looks at the number_of_runs runs in the first size_in_bytes bytes,
+ * and a crash during an append leaves the previous runs as they were. Appends (and the final step of a
+ * merge) hold an exclusive flock on the file; readers never lock.
+ *
+ * Readers merge the runs into a delta index (struct delta_index): the keys of all the delta rows,
+ * sorted, each with the position of its row in the file, so a key range is two binary searches.
+ *
+ * File: struct delta_file_header, then the runs, each a struct delta_run_header followed by its rows.
+ */
+#define DELTA_MAGIC 0x47455341544c4544ULL      // "DELTASEG"
+#define DELTA_VERSION 1
+
+struct delta_file_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t col_count;
+    uint64_t number_of_runs;
+    uint64_t number_of_rows;
+    uint64_t size_in_bytes;         // end of the last committed run
+};
+
+struct delta_run_header
+{
+    uint64_t number_of_rows;
+    uint64_t min_key;
+    uint64_t max_key;
+    uint64_t reserved;
+};
+
+static inline void delta_header_init(struct delta_file_header *header, uint64_t col_count)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = DELTA_MAGIC;
+    header->version = DELTA_VERSION;
+    header->col_count = col_count;
+    header->size_in_bytes = sizeof(*header);
+}
+
+/**
+ * Open (or create) a delta file for appending, with the exclusive lock held, and read its header
+ * Returns the descriptor, -1 if the file cannot be opened or is not a delta segment of col_count columns
+ */
+static inline int delta_open_locked(const char *filename, uint64_t col_count, struct delta_file_header *header)
+{
+    int fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (fd == -1)
+        return -1;
+    if (flock(fd, LOCK_EX) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    ssize_t bytes_read = pread(fd, header, sizeof(*header), 0);
+    if (bytes_read == 0)
+        delta_header_init(header, col_count);
+    else if (bytes_read != sizeof(*header) || header->magic != DELTA_MAGIC || header->version != DELTA_VERSION || header->col_count != col_count)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Release the lock and close
+static inline void delta_close(int fd)
+{
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static int delta_compare_rows(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;       // the key is the first value of a row
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Append n rows (col_count values each, sorted here on the key) as one run, through a descriptor of
+ * delta_open_locked; the run is written and synced before the header that commits it
+ * Returns 0, -1 on a write error (the header is then left as it was)
+ */
+static inline int delta_append_run(int fd, struct delta_file_header *header, uint64_t *rows, size_t n)
+{
+    if (n == 0)
+        return 0;
+    size_t row_size_in_bytes = header->col_count * sizeof(uint64_t);
+    qsort(rows, n, row_size_in_bytes, delta_compare_rows);
+
+    struct delta_run_header run = {n, rows[0], rows[(n - 1) * header->col_count], 0};
+    off_t offset = header->size_in_bytes;
+    if (pwrite(fd, &run, sizeof(run), offset) != sizeof(run) ||
+        pwrite(fd, rows, n * row_size_in_bytes, offset + sizeof(run)) != (ssize_t)(n * row_size_in_bytes) ||
+        fdatasync(fd) != 0)
+        return -1;
+
+    struct delta_file_header committed = *header;
+    committed.number_of_runs++;
+    committed.number_of_rows += n;
+    committed.size_in_bytes += sizeof(run) + n * row_size_in_bytes;
+    if (pwrite(fd, &committed, sizeof(committed), 0) != sizeof(committed) || fdatasync(fd) != 0)
+        return -1;
+    *header = committed;
+    return 0;
+}
+
+/**
+ * Reader side: the delta index over the committed runs of a mapped delta file
+ * keys[i] is the i-th smallest key of the delta, rows[i] the position (in items) of its row in the file
+ */
+struct delta_index
+{
+    struct delta_file_header header;
+    const uint64_t *file;           // the mapping of the delta file
+    uint64_t *keys;
+    uint64_t *rows;
+};
+
+static int delta_compare_entries(const void *a, const void *b)
+{
+    const uint64_t *x = a, *y = b;      // (key, row) pairs, equal keys keep their order in the file
+    return x[0] != y[0] ? (x[0] < y[0] ? -1 : 1) : (x[1] < y[1] ? -1 : x[1] > y[1]);
+}
+
+/**
+ * Build the delta index of a mapped delta file of col_count columns
+ * Returns 0, -1 if the file is not such a delta segment or is shorter than its header says
+ */
+static inline int delta_index_build(struct delta_index *index, const void *mapping, size_t size_in_bytes, uint64_t col_count)
+{
+    memset(index, 0, sizeof(*index));
+    if (size_in_bytes < sizeof(struct delta_file_header))
+        return -1;
+    index->header = *(const struct delta_file_header *)mapping;
+    const struct delta_file_header *header = &index->header;
+    if (header->magic != DELTA_MAGIC || header->version != DELTA_VERSION || header->col_count != col_count || header->size_in_bytes > size_in_bytes)
+        return -1;
+    index->file = mapping;
+
+    // Step 1: (key, row) of every row of every run
+    uint64_t *entries = malloc(header->number_of_rows * 2 * sizeof(uint64_t) + 1);
+    if (entries == NULL)
+    {
+        perror("Memory allocation error for the delta index");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t number_of_rows = 0;
+    size_t offset = sizeof(*header);
+    for (uint64_t r = 0; r < header->number_of_runs; r++)
+    {
+        const struct delta_run_header *run = (const struct delta_run_header *)((const char *)mapping + offset);
+        uint64_t first_item = (offset + sizeof(*run)) / sizeof(uint64_t);
+        if (offset + sizeof(*run) + run->number_of_rows * col_count * sizeof(uint64_t) > header->size_in_bytes ||
+            number_of_rows + run->number_of_rows > header->number_of_rows)
+        {
+            free(entries);
+            return -1;
+        }
+        for (uint64_t i = 0; i < run->number_of_rows; i++)
+        {
+            entries[2 * number_of_rows] = index->file[first_item + i * col_count];
+            entries[2 * number_of_rows + 1] = first_item + i * col_count;
+            number_of_rows++;
+        }
+        offset += sizeof(*run) + run->number_of_rows * col_count * sizeof(uint64_t);
+    }
+
+    // Step 2: the runs are each sorted, the index is their merge
+    qsort(entries, number_of_rows, 2 * sizeof(uint64_t), delta_compare_entries);
+    index->header.number_of_rows = number_of_rows;
+    index->keys = malloc(number_of_rows * sizeof(uint64_t) + 1);
+    index->rows = malloc(number_of_rows * sizeof(uint64_t) + 1);
+    if (index->keys == NULL || index->rows == NULL)
+    {
+        perror("Memory allocation error for the delta index");
+        exit(EXIT_FAILURE);
+    }
+    for (uint64_t i = 0; i < number_of_rows; i++)
+    {
+        index->keys[i] = entries[2 * i];
+        index->rows[i] = entries[2 * i + 1];
+    }
+    free(entries);
+    return 0;
+}
+
+static inline void delta_index_free(struct delta_index *index)
+{
+    free(index->keys);
+    free(index->rows);
+    memset(index, 0, sizeof(*index));
+}
+
+// Position of the first delta key >= value (number_of_rows if there is none)
+static inline uint64_t delta_index_lower_bound(const struct delta_index *index, uint64_t value)
+{
+    uint64_t low = 0, high = index->header.number_of_rows;
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        if (index->keys[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Delta rows with a key in [from, to]
+static inline uint64_t delta_index_count(const struct delta_index *index, uint64_t from, uint64_t to)
+{
+    if (to < from)
+        return 0;
+    uint64_t end = to == UINT64_MAX ? index->header.number_of_rows : delta_index_lower_bound(index, to + 1);
+    return end - delta_index_lower_bound(index, from);
+}
+
+// The i-th delta row in key order
+static inline const uint64_t *delta_index_row(const struct delta_index *index, uint64_t i)
+{
+    return index->file + index->rows[i];
+}
+
+#endif
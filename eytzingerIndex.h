@@ -0,0 +1,95 @@
+#ifndef EYTZINGER_INDEX_H
+#define EYTZINGER_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Eytzinger (BFS) layout of a sorted key array, built when an index is loaded
+ *
+ * keys[1] is the root of an implicit binary search tree, the children of keys[k] are keys[2k] and
+ * keys[2k + 1]. A search walks down from the root without any data-dependent branch
+ * (k = 2k + (keys[k] < value)), and the first levels of the tree share a few hot cache lines.
+ * The 8 great-great-grandchildren of k are the 64 byte line starting at keys[16k], which is prefetched
+ * four levels ahead, so the memory latency of the deep levels overlaps with the comparisons.
+ *
+ * rank[k] is the position of keys[k] in the sorted array, so the answers are the same positions
+ * binary search over the sorted array gives (and index the pointers of the dense/sparse index).
+ */
+struct eytzinger_index
+{
+    uint64_t *keys;         // 1-based, keys[0] unused
+    uint64_t *rank;         // sorted position of keys[k]
+    size_t n;
+};
+
+// In-order walk of the implicit tree: the i-th smallest key goes to the i-th node visited
+static inline size_t eytzinger_fill(struct eytzinger_index *index, const uint64_t *sorted_keys, size_t stride, size_t i, size_t k)
+{
+    if (k <= index->n)
+    {
+        i = eytzinger_fill(index, sorted_keys, stride, i, 2 * k);
+        index->keys[k] = sorted_keys[i * stride];
+        index->rank[k] = i;
+        i = eytzinger_fill(index, sorted_keys, stride, i + 1, 2 * k + 1);
+    }
+    return i;
+}
+
+// Build from n sorted keys, stride items apart (2 for the interleaved (key, pointer) index files)
+static inline void eytzinger_build(struct eytzinger_index *index, const uint64_t *sorted_keys, size_t n, size_t stride)
+{
+    index->n = n;
+    // 64 byte aligned so that keys[16k] .. keys[16k + 15] are whole cache lines
+    size_t size_in_bytes = ((n + 1) * sizeof(uint64_t) + 63) / 64 * 64;
+    index->keys = aligned_alloc(64, size_in_bytes);
+    index->rank = malloc((n + 1) * sizeof(uint64_t));
+    if (index->keys == NULL || index->rank == NULL)
+    {
+        perror("Memory allocation error for the Eytzinger index");
+        exit(EXIT_FAILURE);
+    }
+    index->keys[0] = 0;
+    index->rank[0] = 0;
+    eytzinger_fill(index, sorted_keys, stride, 0, 1);
+}
+
+static inline void eytzinger_free(struct eytzinger_index *index)
+{
+    free(index->keys);
+    free(index->rank);
+}
+
+// Descend comparing with "keys[k] < value" (strict) or "keys[k] <= value", return the node where the
+// search ended after undoing the trailing right turns (0 when every key went left of value)
+static inline size_t eytzinger_descend(const struct eytzinger_index *index, uint64_t value, int inclusive)
+{
+    size_t k = 1;
+    while (k <= index->n)
+    {
+        __builtin_prefetch(index->keys + 16 * k);
+        uint64_t key = index->keys[k];
+        k = 2 * k + (inclusive ? key <= value : key < value);
+    }
+    // the answer is the last node where the search went left: drop the trailing 1 bits and that 0
+    k >>= __builtin_ffsll(~(long long)k);
+    return k;
+}
+
+// Sorted position of the first key >= value, n if every key is smaller
+static inline uint64_t eytzinger_lower_bound(const struct eytzinger_index *index, uint64_t value)
+{
+    size_t k = eytzinger_descend(index, value, 0);
+    return k == 0 ? index->n : index->rank[k];
+}
+
+// Sorted position of the largest key <= value, UINT64_MAX if every key is greater (as binarySearch)
+static inline uint64_t eytzinger_floor(const struct eytzinger_index *index, uint64_t value)
+{
+    size_t k = eytzinger_descend(index, value, 1);      // first key > value
+    uint64_t upper = k == 0 ? index->n : index->rank[k];
+    return upper == 0 ? UINT64_MAX : upper - 1;
+}
+
+#endif
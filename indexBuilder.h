@@ -0,0 +1,958 @@
+#ifndef INDEX_BUILDER_H
+#define INDEX_BUILDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "tableLayout.h"
+#include "btreeIndex.h"
+#include "learnedIndex.h"
+#include "bitmapIndex.h"
+#include "packedBlocks.h"
+#include "aggregateIndex.h"
+#include "keyIndexFile.h"
+#include "tableUtilities.h"
+
+/**
+ * Builder of the index files of a table from a stream of its blocks: the dense and sparse indexes, the
+ * B+-tree, the learned index, the zone map, the bitmap index, the packed data and the aggregates
+ *
+ * createPrimaryKeyIndexFiles runs it over the data file: the blocks are split in contiguous ranges, one per
+ * builder thread, every thread reads its blocks and hands them to index_block. mergeDelta runs one builder
+ * thread over the blocks of the merged data file as it writes them, so a new generation has every file.
+ *
+ * The position of every entry in its file is known up front (entry i of the dense index describes
+ * tuple i, entry i of the sparse index describes tuple i * sparse_index_interval), so each thread writes its part of every
+ * file with pwrite at precomputed offsets, through a fixed-size buffer per output: the memory used
+ * does not depend on the size of the table.
+ *
+ * The dense and sparse indexes (keyIndexFile.h) have a key section and a pointer section, two outputs in
+ * the same file; every thread sums the checksums of the entries it writes, the header is written after the pass.
+ * The B+-tree levels are outputs too: every level is a contiguous run of pages in the .btree_index file.
+ * The zone map has an entry per block: (min, max) of every column, so it is an output filled per block.
+ * A new per-block index file is one more index_output, filled in index_block.
+ *
+ * The learned index is not an output: its size depends on the keys, so every thread keeps the segments
+ * of its blocks in memory (a few per thousand tuples) and they are written after the pass, in thread order.
+ * The bitmap index is stored chunk by chunk (65536 tuples, see bitmapIndex.h): a chunk is built by the thread
+ * whose range holds its first tuple, which records the values of columns 2, 3 and 4 of the chunk's tuples
+ * (the reader hands it the rest of the last one, past the end of its range), counting-sorts them by value and
+ * streams the chunk to a spill file per column. The spill files are copied to the .bitmap_index file after the pass.
+ * The packed copy of the data file has variable-size blocks, so every thread streams its packed blocks to a
+ * spill file of its own (a temporary file next to the index files, through the same fixed-size buffer) and
+ * the spill files are copied to the .packed_data file after the pass, in thread order.
+ * The aggregates file needs prefix sums and trees over all the blocks: every thread streams the (sum, min, max)
+ * of every column of its blocks to a spill file, then the prefix sums and the leaves of every column are written
+ * from the spill files, and the trees level by level from the leaves up, through fixed-size buffers.
+ */
+#define INDEX_BUILDER_WRITE_BUFFER_SIZE (1 << 20)   // every output of a builder thread is written in 1 MiB chunks
+#define AGGREGATE_SECTION_BUFFER_ENTRIES 4096       // entries of every buffer of the aggregates file written after the pass
+
+struct index_output
+{
+    char *filename;
+    int fd;
+    size_t entry_size_in_bytes;
+    off_t first_offset;         // where the first entry of the output is in its file
+};
+
+// The part of an output written by one thread, buffered
+struct output_buffer
+{
+    struct index_output *output;
+    uint64_t *items;
+    size_t used_bytes;
+    off_t file_offset;          // where the buffered entries go in the file
+};
+
+// An output of a thread whose size is only known at the end of the pass, buffered to an unlinked temporary file
+struct spill_file
+{
+    int fd;
+    char *buffer;
+    size_t used_bytes;
+    size_t capacity_in_bytes;
+    uint64_t size_in_bytes;     // everything appended, flushed or still in the buffer
+};
+
+enum index_output_kind
+{
+    DENSE_KEY_OUTPUT = 0,
+    DENSE_POINTER_OUTPUT,
+    SPARSE_KEY_OUTPUT,
+    SPARSE_POINTER_OUTPUT,
+    ZONEMAP_OUTPUT,             // an entry of col_count (min, max) pairs per block
+    BTREE_LEVEL_OUTPUT,         // level k of the B+-tree is output BTREE_LEVEL_OUTPUT + k
+    MAX_INDEX_OUTPUTS = BTREE_LEVEL_OUTPUT + BTREE_MAX_LEVELS
+};
+
+// The table whose index files are built, the files and what the threads share
+struct index_build
+{
+    uint64_t row_count;
+    int col_count;
+    enum table_layout data_layout;
+    struct data_file_geometry data_geometry;    // where the blocks are in the data file (its header)
+    uint64_t sparse_index_interval;             // tuples per sparse index entry
+    uint64_t learned_index_error_bound;
+    int sync_files;                             // fsync every file before closing it (mergeDelta)
+
+    char *dense_index_filename;     // dense file name (ending in .dense_index)
+    char *sparse_index_filename;    // sparse index file name (ending in .sparse_index)
+    char *btree_index_filename;     // B+-tree file name (ending in .btree_index)
+    char *learned_index_filename;   // learned index file name (ending in .learned_index)
+    char *zonemap_filename;         // zone map file name (ending in .zonemap)
+    char *bitmap_index_filename;    // bitmap index file name (ending in .bitmap_index)
+    char *packed_data_filename;     // compressed copy of the data file (ending in .packed_data)
+    char *aggregate_filename;       // per-block aggregates file name (ending in .aggregates)
+
+    struct index_output outputs[MAX_INDEX_OUTPUTS];
+    int number_of_outputs;
+    struct btree_file_header btree_header;      // shape of the B+-tree, known from row_count before the pass
+    uint64_t btree_level_stride[BTREE_MAX_LEVELS];  // level k has an entry for every 255^k-th tuple
+    uint64_t *bitmap_chunk_sizes[BITMAP_INDEX_COLUMNS];    // size in bytes of every chunk of columns 2, 3 and 4 (NULL: not built)
+    struct key_index_header dense_index_header;     // headers of the dense and sparse index files, known from row_count
+    struct key_index_header sparse_index_header;
+};
+
+// The chunk of the bitmap index a thread is filling, and the memory of its counting sort
+struct bitmap_chunk_builder
+{
+    uint32_t *values[BITMAP_INDEX_COLUMNS];     // values of columns 2, 3 and 4 of the tuples of the chunk
+    uint32_t *value_counts;                     // tuples of every value in the chunk (all 0 between chunks)
+    uint32_t *distinct_values;                  // values held by the chunk, increasing
+    uint32_t *first_row;                        // first sorted tuple of every one of them
+    uint16_t *rows;                             // the tuples of the chunk sorted by value
+};
+
+struct builder_thread
+{
+    struct index_build *build;
+    pthread_t thread;
+    size_t first_block;
+    size_t end_block;
+    struct output_buffer buffers[MAX_INDEX_OUTPUTS];
+    struct learned_index_builder learned;       // segments of the learned index over this thread's blocks
+    int column_not_indexed[BITMAP_INDEX_COLUMNS];       // a value >= BITMAP_INDEX_MAX_VALUES was seen
+    uint64_t number_of_values[BITMAP_INDEX_COLUMNS];    // largest value + 1 seen in columns 2, 3 and 4
+    uint64_t first_bitmap_tuple;                // first tuple of the first chunk starting in this thread's range
+    struct bitmap_chunk_builder chunk;
+    struct spill_file bitmaps[BITMAP_INDEX_COLUMNS];    // chunks of columns 2, 3 and 4 built by this thread, in order
+    struct spill_file packed;                   // packed blocks of this thread, one after the other
+    uint64_t *packed_block_sizes;               // size in bytes of every packed block of this thread
+    struct spill_file aggregates;               // (sum, min, max) of every column of every block of this thread
+    uint64_t dense_checksum;                    // checksums of the dense and sparse index entries of this thread
+    uint64_t sparse_checksum;
+    int failed;
+};
+
+// Create an index file of its final size
+static inline int index_file_open(char *filename, off_t size_in_bytes)
+{
+    int fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (fd == -1)
+    {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, size_in_bytes) != 0)
+        perror("Error sizing index file");
+    return fd;
+}
+
+// Close an index file, synced first for a merge; returns 1 if the sync fails
+static inline int index_file_close(const struct index_build *build, int fd)
+{
+    int failed = build->sync_files && fsync(fd) != 0;
+    close(fd);
+    return failed;
+}
+
+static inline void output_add(struct index_build *build, enum index_output_kind kind, char *filename, int fd, size_t entry_size_in_bytes, off_t first_offset)
+{
+    struct index_output *output = &build->outputs[kind];
+    output->filename = filename;
+    output->fd = fd;
+    output->entry_size_in_bytes = entry_size_in_bytes;
+    output->first_offset = first_offset;
+    if (kind + 1 > build->number_of_outputs)
+        build->number_of_outputs = kind + 1;
+}
+
+static inline void output_buffer_flush(struct output_buffer *buffer, int *failed)
+{
+    if (buffer->used_bytes == 0)
+        return;
+    if (pwrite(buffer->output->fd, buffer->items, buffer->used_bytes, buffer->file_offset) != (ssize_t)buffer->used_bytes)
+    {
+        perror(buffer->output->filename);
+        *failed = 1;
+    }
+    buffer->file_offset += buffer->used_bytes;
+    buffer->used_bytes = 0;
+}
+
+// Append one entry (entry_size_in_bytes of the output) to a thread's buffer, flushing it when full
+static inline void output_append(struct output_buffer *buffer, const uint64_t *entry, int *failed)
+{
+    size_t entry_size = buffer->output->entry_size_in_bytes;
+    if (buffer->used_bytes + entry_size > INDEX_BUILDER_WRITE_BUFFER_SIZE)
+        output_buffer_flush(buffer, failed);
+    memcpy((char *)buffer->items + buffer->used_bytes, entry, entry_size);
+    buffer->used_bytes += entry_size;
+}
+
+// Create the spill file of a thread next to "filename" (removed at once, it is gone when closed)
+static inline int spill_open(struct spill_file *spill, const char *filename, size_t capacity_in_bytes)
+{
+    char template[strlen(filename) + 8];
+    sprintf(template, "%s.XXXXXX", filename);
+    spill->fd = mkstemp(template);
+    if (spill->fd != -1)
+        unlink(template);
+    else
+        perror(template);
+    spill->buffer = malloc(capacity_in_bytes);
+    spill->used_bytes = 0;
+    spill->capacity_in_bytes = capacity_in_bytes;
+    spill->size_in_bytes = 0;
+    return spill->fd == -1 || spill->buffer == NULL;
+}
+
+static inline void spill_flush(struct spill_file *spill, int *failed)
+{
+    if (spill->used_bytes == 0)
+        return;
+    if (pwrite(spill->fd, spill->buffer, spill->used_bytes, spill->size_in_bytes - spill->used_bytes) != (ssize_t)spill->used_bytes)
+    {
+        perror("Error writing a spill file");
+        *failed = 1;
+    }
+    spill->used_bytes = 0;
+}
+
+// Room for up to size_in_bytes bytes at the end of the spill file (at most its capacity), spill_commit appends them
+static inline char *spill_reserve(struct spill_file *spill, size_t size_in_bytes, int *failed)
+{
+    if (spill->used_bytes + size_in_bytes > spill->capacity_in_bytes)
+        spill_flush(spill, failed);
+    return spill->buffer + spill->used_bytes;
+}
+
+static inline void spill_commit(struct spill_file *spill, size_t size_in_bytes)
+{
+    spill->used_bytes += size_in_bytes;
+    spill->size_in_bytes += size_in_bytes;
+}
+
+// Copy size_in_bytes bytes of a (flushed) spill file from "offset" to "file_offset" of fd, through its buffer
+static inline int spill_copy(struct spill_file *spill, off_t offset, uint64_t size_in_bytes, int fd, off_t file_offset)
+{
+    while (size_in_bytes > 0)
+    {
+        size_t chunk = size_in_bytes < spill->capacity_in_bytes ? size_in_bytes : spill->capacity_in_bytes;
+        if (pread(spill->fd, spill->buffer, chunk, offset) != (ssize_t)chunk || pwrite(fd, spill->buffer, chunk, file_offset) != (ssize_t)chunk)
+            return 1;
+        offset += chunk;
+        file_offset += chunk;
+        size_in_bytes -= chunk;
+    }
+    return 0;
+}
+
+static inline void spill_close(struct spill_file *spill)
+{
+    if (spill->fd != -1)
+        close(spill->fd);
+    free(spill->buffer);
+    memset(spill, 0, sizeof(*spill));
+    spill->fd = -1;
+}
+
+// Index entries of the tuples before "tuple_index" in the dense, sparse and zone map outputs
+static inline uint64_t entries_before_tuple(const struct index_build *build, enum index_output_kind kind, uint64_t tuple_index)
+{
+    if (kind == SPARSE_KEY_OUTPUT || kind == SPARSE_POINTER_OUTPUT)
+        return (tuple_index + build->sparse_index_interval - 1) / build->sparse_index_interval;
+    if (kind == ZONEMAP_OUTPUT)
+        return (tuple_index + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    return tuple_index;
+}
+
+// Byte offset in its file of the first entry an output has for a tuple >= tuple_index
+// (where the part of the file written by a thread starting at tuple_index begins)
+static inline off_t output_offset_of_tuple(const struct index_build *build, int kind, uint64_t tuple_index)
+{
+    const struct index_output *output = &build->outputs[kind];
+    if (kind < BTREE_LEVEL_OUTPUT)
+        return output->first_offset + entries_before_tuple(build, kind, tuple_index) * output->entry_size_in_bytes;
+
+    // B+-tree level: pages of a header and 255 entries, the header is written with the first entry of the page
+    uint64_t stride = build->btree_level_stride[kind - BTREE_LEVEL_OUTPUT];
+    uint64_t entry = (tuple_index + stride - 1) / stride;
+    uint64_t slot = entry % BTREE_ENTRIES_PER_PAGE;
+    return output->first_offset + (entry / BTREE_ENTRIES_PER_PAGE) * BTREE_PAGE_SIZE + (slot == 0 ? 0 : (slot + 1) * 16);
+}
+
+// B+-tree entry of a tuple at every level that has one (level k has an entry for every 255^k-th tuple)
+static inline void index_btree_tuple(struct builder_thread *thread, uint64_t tuple_index, uint64_t key)
+{
+    const struct index_build *build = thread->build;
+    for (uint64_t level = 0; level < build->btree_header.number_of_levels; level++)
+    {
+        uint64_t stride = build->btree_level_stride[level];
+        if (tuple_index % stride != 0)
+            break;      // then no level above has an entry for it either
+
+        uint64_t entry = tuple_index / stride;
+        struct output_buffer *buffer = &thread->buffers[BTREE_LEVEL_OUTPUT + level];
+        if (entry % BTREE_ENTRIES_PER_PAGE == 0)
+        {
+            // first entry of a page: the page header goes first
+            uint64_t entries_in_level = level == 0 ? build->row_count : build->btree_header.level_number_of_pages[level - 1];
+            uint64_t entries_in_page = entries_in_level - entry < BTREE_ENTRIES_PER_PAGE ? entries_in_level - entry : BTREE_ENTRIES_PER_PAGE;
+            struct btree_page_header page_header = {(uint32_t)level, (uint32_t)entries_in_page, 0};
+            output_append(buffer, (const uint64_t *)&page_header, &thread->failed);
+        }
+
+        // leaves point to the tuple (in items, as the dense index), level k to page "entry" of level k - 1
+        uint64_t pointer = level == 0 ? tuple_index * build->col_count : build->btree_header.level_first_page[level - 1] + entry;
+        uint64_t btree_entry[2] = {key, pointer};
+        output_append(buffer, btree_entry, &thread->failed);
+    }
+}
+
+// Tuples of a block (the last one may be partial)
+static inline size_t index_block_tuples(const struct index_build *build, size_t block_index)
+{
+    uint64_t first_tuple = block_index * TUPLES_PER_BLOCK;
+    return build->row_count - first_tuple < TUPLES_PER_BLOCK ? build->row_count - first_tuple : TUPLES_PER_BLOCK;
+}
+
+// Zone map entry of a block: the smallest and largest value of every column over its tuples
+// (and the sum of every column, appended with them to the thread's aggregates spill file)
+static inline void index_block_zones(struct builder_thread *thread, size_t block_index, const uint64_t *block_data)
+{
+    const struct index_build *build = thread->build;
+    int col_count = build->col_count;
+    size_t tuples_in_block = index_block_tuples(build, block_index);
+    uint64_t zones[2 * col_count];
+    uint64_t *aggregates = (uint64_t *)spill_reserve(&thread->aggregates, 3 * col_count * sizeof(uint64_t), &thread->failed);
+    for (int c = 0; c < col_count; c++)
+    {
+        uint64_t min = UINT64_MAX, max = 0, sum = 0;
+        for (size_t j = 0; j < tuples_in_block; j++)
+        {
+            uint64_t value = block_data[item_in_block(build->data_layout, col_count, j, c)];
+            min = value < min ? value : min;
+            max = value > max ? value : max;
+            sum += value;
+        }
+        zones[2 * c] = min;
+        zones[2 * c + 1] = max;
+        aggregates[3 * c] = sum;
+        aggregates[3 * c + 1] = min;
+        aggregates[3 * c + 2] = max;
+    }
+    spill_commit(&thread->aggregates, 3 * col_count * sizeof(uint64_t));
+    output_append(&thread->buffers[ZONEMAP_OUTPUT], zones, &thread->failed);
+}
+
+// Bitmap index: the chunk just recorded, counting-sorted by value, to the thread's spill file of every column
+static inline void index_chunk_bitmaps(struct builder_thread *thread, uint64_t chunk_index, uint32_t tuples_in_chunk)
+{
+    const struct index_build *build = thread->build;
+    struct bitmap_chunk_builder *chunk = &thread->chunk;
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && build->bitmap_chunk_sizes[c] != NULL; c++)
+    {
+        if (thread->column_not_indexed[c])
+            continue;
+        const uint32_t *values = chunk->values[c];
+        for (uint32_t r = 0; r < tuples_in_chunk; r++)
+            chunk->value_counts[values[r]]++;
+
+        // the values of the chunk in increasing order, the count of every value becomes the next row of its tuples
+        uint32_t number_of_values = 0, rows = 0;
+        for (uint64_t v = 0; v < thread->number_of_values[c]; v++)
+        {
+            if (chunk->value_counts[v] == 0)
+                continue;
+            chunk->distinct_values[number_of_values] = (uint32_t)v;
+            chunk->first_row[number_of_values++] = rows;
+            rows += chunk->value_counts[v];
+            chunk->value_counts[v] = chunk->first_row[number_of_values - 1];
+        }
+        chunk->first_row[number_of_values] = rows;
+        for (uint32_t r = 0; r < tuples_in_chunk; r++)
+            chunk->rows[chunk->value_counts[values[r]]++] = (uint16_t)r;
+        for (uint32_t i = 0; i < number_of_values; i++)
+            chunk->value_counts[chunk->distinct_values[i]] = 0;
+
+        char *buffer = spill_reserve(&thread->bitmaps[c], BITMAP_CHUNK_MAX_SIZE, &thread->failed);
+        size_t size_in_bytes = bitmap_chunk_serialize(chunk->distinct_values, chunk->first_row, number_of_values, chunk->rows, buffer);
+        spill_commit(&thread->bitmaps[c], size_in_bytes);
+        build->bitmap_chunk_sizes[c][chunk_index] = size_in_bytes;
+    }
+}
+
+// Bitmap index: record the values of columns 2, 3 and 4 of the tuple in its chunk, built with its last tuple
+// (the tuples before first_bitmap_tuple are in a chunk of the previous thread)
+static inline void index_tuple_bitmaps(struct builder_thread *thread, uint64_t tuple_index, const uint64_t *block_data, size_t tuple_in_block)
+{
+    const struct index_build *build = thread->build;
+    if (tuple_index < thread->first_bitmap_tuple || build->bitmap_chunk_sizes[0] == NULL)
+        return;
+    size_t row = tuple_index % BITMAP_CHUNK_ROWS;
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && build->bitmap_chunk_sizes[c] != NULL; c++)
+    {
+        uint64_t value = block_data[item_in_block(build->data_layout, build->col_count, tuple_in_block, BITMAP_INDEX_FIRST_COLUMN + c)];
+        if (value >= BITMAP_INDEX_MAX_VALUES)
+            thread->column_not_indexed[c] = 1;
+        else if (value >= thread->number_of_values[c])
+            thread->number_of_values[c] = value + 1;
+        thread->chunk.values[c][row] = (uint32_t)value;
+    }
+    if (row == BITMAP_CHUNK_ROWS - 1 || tuple_index == build->row_count - 1)
+        index_chunk_bitmaps(thread, tuple_index / BITMAP_CHUNK_ROWS, row + 1);
+}
+
+// Packed copy of a block: every column gathered and encoded on its own (see packedBlocks.h), appended to the thread's spill file
+static inline void index_block_packed(struct builder_thread *thread, size_t block_index, const uint64_t *block_data)
+{
+    const struct index_build *build = thread->build;
+    size_t tuples_in_block = index_block_tuples(build, block_index);
+    char *packed = spill_reserve(&thread->packed, build->col_count * packed_column_max_size(TUPLES_PER_BLOCK), &thread->failed);
+
+    uint64_t values[TUPLES_PER_BLOCK];
+    size_t block_size_in_bytes = 0;
+    for (int c = 0; c < build->col_count; c++)
+    {
+        for (size_t j = 0; j < tuples_in_block; j++)
+            values[j] = block_data[item_in_block(build->data_layout, build->col_count, j, c)];
+        block_size_in_bytes += packed_encode_column(values, tuples_in_block, packed + block_size_in_bytes);
+    }
+    thread->packed_block_sizes[block_index - thread->first_block] = block_size_in_bytes;
+    spill_commit(&thread->packed, block_size_in_bytes);
+}
+
+// Emit the index entries of one block to every output
+static inline void index_block(struct builder_thread *thread, size_t block_index, const uint64_t *block_data)
+{
+    const struct index_build *build = thread->build;
+    index_block_zones(thread, block_index, block_data);
+    index_block_packed(thread, block_index, block_data);
+
+    // In row-major order the keys are col_count items apart, in PAX they are the contiguous first minipage
+    size_t stride = key_stride(build->data_layout, build->col_count);
+    size_t row_byte_size = build->col_count * sizeof(uint64_t);
+
+    for (size_t j = 0; j < index_block_tuples(build, block_index); j++)
+    {
+        uint64_t tuple_index = block_index * TUPLES_PER_BLOCK + j;
+        uint64_t key = block_data[j * stride];
+
+        // dense index: the key, and the position of the tuple in number of items
+        // the pointer is the logical position of the tuple, the same in both layouts
+        uint64_t dense_pointer = tuple_index * build->col_count;
+        output_append(&thread->buffers[DENSE_KEY_OUTPUT], &key, &thread->failed);
+        output_append(&thread->buffers[DENSE_POINTER_OUTPUT], &dense_pointer, &thread->failed);
+        thread->dense_checksum += key_index_checksum_entry(tuple_index, key, dense_pointer);
+
+        // sparse index: the key and the byte offset of the tuple, for every sparse_index_interval-th tuple
+        if (tuple_index % build->sparse_index_interval == 0)
+        {
+            uint64_t sparse_pointer = tuple_index * row_byte_size;
+            output_append(&thread->buffers[SPARSE_KEY_OUTPUT], &key, &thread->failed);
+            output_append(&thread->buffers[SPARSE_POINTER_OUTPUT], &sparse_pointer, &thread->failed);
+            thread->sparse_checksum += key_index_checksum_entry(tuple_index / build->sparse_index_interval, key, sparse_pointer);
+        }
+
+        // B+-tree: a leaf entry, plus an entry in every level whose page starts with this tuple
+        index_btree_tuple(thread, tuple_index, key);
+
+        // learned index: a new segment whenever the key is too far from the line of the current one
+        learned_builder_add(&thread->learned, key, tuple_index);
+
+        // bitmap index: the bitmaps of the values of the tuple
+        index_tuple_bitmaps(thread, tuple_index, block_data, j);
+    }
+}
+
+/**
+ * Name the index files "<skeleton>.dense_index" ... of a table of row_count tuples whose data file has
+ * this layout and geometry
+ */
+static inline void index_build_init(struct index_build *build, const char *skeleton, uint64_t row_count, int col_count, enum table_layout data_layout,
+                                    const struct data_file_geometry *data_geometry, uint64_t sparse_index_interval, uint64_t learned_index_error_bound)
+{
+    memset(build, 0, sizeof(*build));
+    build->row_count = row_count;
+    build->col_count = col_count;
+    build->data_layout = data_layout;
+    build->data_geometry = *data_geometry;
+    build->sparse_index_interval = sparse_index_interval;
+    build->learned_index_error_bound = learned_index_error_bound;
+    build->dense_index_filename = filename_with_extension(skeleton, ".dense_index");
+    build->sparse_index_filename = filename_with_extension(skeleton, ".sparse_index");
+    build->btree_index_filename = filename_with_extension(skeleton, ".btree_index");
+    build->learned_index_filename = filename_with_extension(skeleton, ".learned_index");
+    build->zonemap_filename = filename_with_extension(skeleton, ".zonemap");
+    build->bitmap_index_filename = filename_with_extension(skeleton, ".bitmap_index");
+    build->packed_data_filename = filename_with_extension(skeleton, ".packed_data");
+    build->aggregate_filename = filename_with_extension(skeleton, ".aggregates");
+}
+
+static inline void index_build_free(struct index_build *build)
+{
+    free(build->dense_index_filename);
+    free(build->sparse_index_filename);
+    free(build->btree_index_filename);
+    free(build->learned_index_filename);
+    free(build->zonemap_filename);
+    free(build->bitmap_index_filename);
+    free(build->packed_data_filename);
+    free(build->aggregate_filename);
+}
+
+// Create the index files of their final size (those whose size only depends on row_count) and their outputs
+static inline void index_build_open(struct index_build *build)
+{
+    uint64_t row_count = build->row_count;
+    size_t total_number_of_blocks_in_file = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+
+    // The dense and sparse indexes: a header page, then the key section, then the pointer section
+    key_index_header_init(&build->dense_index_header, row_count, 1, TUPLES_PER_BLOCK, KEY_INDEX_POINTER_ITEMS);
+    int dense_fd = index_file_open(build->dense_index_filename, key_index_file_size(&build->dense_index_header));
+    output_add(build, DENSE_KEY_OUTPUT, build->dense_index_filename, dense_fd, sizeof(uint64_t), build->dense_index_header.keys_offset);
+    output_add(build, DENSE_POINTER_OUTPUT, build->dense_index_filename, dense_fd, sizeof(uint64_t), build->dense_index_header.pointers_offset);
+    key_index_header_init(&build->sparse_index_header, row_count, build->sparse_index_interval, TUPLES_PER_BLOCK, KEY_INDEX_POINTER_BYTES);
+    int sparse_fd = index_file_open(build->sparse_index_filename, key_index_file_size(&build->sparse_index_header));
+    output_add(build, SPARSE_KEY_OUTPUT, build->sparse_index_filename, sparse_fd, sizeof(uint64_t), build->sparse_index_header.keys_offset);
+    output_add(build, SPARSE_POINTER_OUTPUT, build->sparse_index_filename, sparse_fd, sizeof(uint64_t), build->sparse_index_header.pointers_offset);
+    size_t zonemap_entry_size_in_bytes = 2 * build->col_count * sizeof(uint64_t);
+    int zonemap_fd = index_file_open(build->zonemap_filename, total_number_of_blocks_in_file * zonemap_entry_size_in_bytes);
+    output_add(build, ZONEMAP_OUTPUT, build->zonemap_filename, zonemap_fd, zonemap_entry_size_in_bytes, 0);
+
+    // The B+-tree is packed, its shape (and the page of every entry) only depends on row_count
+    btree_geometry(row_count, &build->btree_header);
+    int btree_fd = index_file_open(build->btree_index_filename, btree_total_number_of_pages(&build->btree_header) * BTREE_PAGE_SIZE);
+    for (uint64_t level = 0; level < build->btree_header.number_of_levels; level++)
+    {
+        build->btree_level_stride[level] = level == 0 ? 1 : build->btree_level_stride[level - 1] * BTREE_ENTRIES_PER_PAGE;
+        output_add(build, BTREE_LEVEL_OUTPUT + level, build->btree_index_filename, btree_fd, 2 * sizeof(uint64_t), build->btree_header.level_first_page[level] * BTREE_PAGE_SIZE);
+    }
+
+    // (the bitmaps hold 32-bit row ids)
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && BITMAP_INDEX_FIRST_COLUMN + c < build->col_count && row_count <= UINT32_MAX; c++)
+    {
+        build->bitmap_chunk_sizes[c] = calloc(bitmap_index_number_of_chunks(row_count) + 1, sizeof(uint64_t));
+        if (build->bitmap_chunk_sizes[c] == NULL)
+        {
+            perror("Memory allocation error for the bitmap index");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Memory of the thread's chunk and its spill files, for the columns of the bitmap index
+static inline int bitmap_chunk_builder_init(struct builder_thread *thread)
+{
+    const struct index_build *build = thread->build;
+    struct bitmap_chunk_builder *chunk = &thread->chunk;
+    int failed = 0;
+    if (build->bitmap_chunk_sizes[0] == NULL)
+        return 0;
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && build->bitmap_chunk_sizes[c] != NULL; c++)
+    {
+        chunk->values[c] = malloc(BITMAP_CHUNK_ROWS * sizeof(uint32_t));
+        failed |= chunk->values[c] == NULL || spill_open(&thread->bitmaps[c], build->bitmap_index_filename, INDEX_BUILDER_WRITE_BUFFER_SIZE) != 0;
+    }
+    chunk->value_counts = calloc(BITMAP_INDEX_MAX_VALUES, sizeof(uint32_t));
+    chunk->distinct_values = malloc(BITMAP_CHUNK_ROWS * sizeof(uint32_t));
+    chunk->first_row = malloc((BITMAP_CHUNK_ROWS + 1) * sizeof(uint32_t));
+    chunk->rows = malloc(BITMAP_CHUNK_ROWS * sizeof(uint16_t));
+    if (failed || chunk->value_counts == NULL || chunk->distinct_values == NULL || chunk->first_row == NULL || chunk->rows == NULL)
+    {
+        perror("Memory allocation error for the bitmap index");
+        return 1;
+    }
+    return 0;
+}
+
+static inline void bitmap_chunk_builder_free(struct bitmap_chunk_builder *chunk)
+{
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS; c++)
+        free(chunk->values[c]);
+    free(chunk->value_counts);
+    free(chunk->distinct_values);
+    free(chunk->first_row);
+    free(chunk->rows);
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+/**
+ * Get a thread ready for the blocks [first_block, end_block): its output buffers at the offsets of its
+ * part of every file, its learned index segments and its spill files
+ * Returns 0, 1 if it cannot be set up (thread->failed is then set)
+ */
+static inline int builder_thread_start(struct index_build *build, struct builder_thread *thread, size_t first_block, size_t end_block)
+{
+    memset(thread, 0, sizeof(*thread));
+    thread->build = build;
+    thread->first_block = first_block;
+    thread->end_block = end_block;
+    thread->first_bitmap_tuple = (first_block * TUPLES_PER_BLOCK + BITMAP_CHUNK_ROWS - 1) / BITMAP_CHUNK_ROWS * BITMAP_CHUNK_ROWS;
+    thread->packed.fd = -1;
+    thread->aggregates.fd = -1;
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS; c++)
+        thread->bitmaps[c].fd = -1;
+
+    for (int o = 0; o < build->number_of_outputs; o++)
+    {
+        struct output_buffer *buffer = &thread->buffers[o];
+        buffer->output = &build->outputs[o];
+        buffer->items = malloc(INDEX_BUILDER_WRITE_BUFFER_SIZE);
+        buffer->used_bytes = 0;
+        buffer->file_offset = output_offset_of_tuple(build, o, first_block * TUPLES_PER_BLOCK);
+        thread->failed |= buffer->items == NULL;
+    }
+
+    learned_builder_init(&thread->learned, build->learned_index_error_bound);
+    thread->packed_block_sizes = malloc((end_block - first_block + 1) * sizeof(uint64_t));
+    size_t max_packed_block_size = build->col_count * packed_column_max_size(TUPLES_PER_BLOCK);
+    size_t block_aggregates_size = 3 * build->col_count * sizeof(uint64_t);
+    if (thread->failed || thread->packed_block_sizes == NULL ||
+        spill_open(&thread->packed, build->packed_data_filename, max_packed_block_size > INDEX_BUILDER_WRITE_BUFFER_SIZE ? max_packed_block_size : INDEX_BUILDER_WRITE_BUFFER_SIZE) != 0 ||
+        spill_open(&thread->aggregates, build->aggregate_filename, block_aggregates_size > INDEX_BUILDER_WRITE_BUFFER_SIZE ? block_aggregates_size : INDEX_BUILDER_WRITE_BUFFER_SIZE) != 0 ||
+        bitmap_chunk_builder_init(thread) != 0)
+        thread->failed = 1;
+    return thread->failed;
+}
+
+// After the last block of the thread: flush its outputs and spill files
+static inline void builder_thread_finish(struct builder_thread *thread)
+{
+    for (int o = 0; o < thread->build->number_of_outputs; o++)
+    {
+        if (thread->buffers[o].items != NULL)
+            output_buffer_flush(&thread->buffers[o], &thread->failed);
+        free(thread->buffers[o].items);
+        thread->buffers[o].items = NULL;
+    }
+    if (thread->packed.fd != -1)
+        spill_flush(&thread->packed, &thread->failed);
+    if (thread->aggregates.fd != -1)
+        spill_flush(&thread->aggregates, &thread->failed);
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS; c++)
+        if (thread->bitmaps[c].fd != -1)
+            spill_flush(&thread->bitmaps[c], &thread->failed);
+    bitmap_chunk_builder_free(&thread->chunk);
+    learned_builder_finish(&thread->learned);
+}
+
+// Write the header and the segments of every thread (in block order) to the .learned_index file
+static inline int write_learned_index_file(struct index_build *build, struct builder_thread *threads, int number_of_threads)
+{
+    struct learned_index_header header = {LEARNED_INDEX_MAGIC, LEARNED_INDEX_VERSION, build->row_count, build->learned_index_error_bound, 0};
+    for (int t = 0; t < number_of_threads; t++)
+        header.number_of_segments += threads[t].learned.number_of_segments;
+
+    int fd = index_file_open(build->learned_index_filename, sizeof(header) + header.number_of_segments * sizeof(struct learned_segment));
+    int failed = pwrite(fd, &header, sizeof(header), 0) != sizeof(header);
+    off_t offset = sizeof(header);
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        size_t size_in_bytes = threads[t].learned.number_of_segments * sizeof(struct learned_segment);
+        if (size_in_bytes > 0 && pwrite(fd, threads[t].learned.segments, size_in_bytes, offset) != (ssize_t)size_in_bytes)
+            failed = 1;
+        offset += size_in_bytes;
+    }
+    failed |= index_file_close(build, fd);
+    if (failed)
+        perror(build->learned_index_filename);
+    printf("Learned index: %lu segments (error bound %lu tuples)\n", header.number_of_segments, build->learned_index_error_bound);
+    return failed;
+}
+
+/**
+ * Write the .bitmap_index file: the header, then for every indexed column the offsets of its chunks and the chunks,
+ * copied from the spill files of the threads (every thread built a run of consecutive chunks)
+ */
+static inline int write_bitmap_index_file(struct index_build *build, struct builder_thread *threads, int number_of_threads)
+{
+    struct bitmap_index_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BITMAP_INDEX_MAGIC;
+    header.version = BITMAP_INDEX_VERSION;
+    header.row_count = build->row_count;
+    size_t number_of_chunks = bitmap_index_number_of_chunks(build->row_count);
+
+    // Step 1: the domain of every indexed column and where its offsets and chunks go
+    off_t file_size_in_bytes = sizeof(header);
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && build->bitmap_chunk_sizes[c] != NULL; c++)
+    {
+        int column_not_indexed = 0;
+        for (int t = 0; t < number_of_threads; t++)
+        {
+            column_not_indexed |= threads[t].column_not_indexed[c];
+            if (threads[t].number_of_values[c] > header.number_of_values[c])
+                header.number_of_values[c] = threads[t].number_of_values[c];
+        }
+        if (column_not_indexed)
+        {
+            printf("Bitmap index: column %d has values >= %d, it is not indexed\n", BITMAP_INDEX_FIRST_COLUMN + c, BITMAP_INDEX_MAX_VALUES);
+            header.number_of_values[c] = 0;
+            continue;
+        }
+        header.chunks_offset[c] = file_size_in_bytes;
+        file_size_in_bytes += (number_of_chunks + 1) * sizeof(uint64_t);
+        for (size_t k = 0; k < number_of_chunks; k++)
+            file_size_in_bytes += build->bitmap_chunk_sizes[c][k];
+    }
+
+    // Step 2: the offsets of the chunks of every column, then its chunks, thread after thread
+    int fd = index_file_open(build->bitmap_index_filename, file_size_in_bytes);
+    int failed = pwrite(fd, &header, sizeof(header), 0) != sizeof(header);
+    uint64_t *chunk_offsets = malloc((number_of_chunks + 1) * sizeof(uint64_t));
+    if (chunk_offsets == NULL)
+    {
+        perror("Memory allocation error for the bitmap index");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS && !failed; c++)
+    {
+        if (header.number_of_values[c] == 0)
+            continue;
+        chunk_offsets[0] = header.chunks_offset[c] + (number_of_chunks + 1) * sizeof(uint64_t);
+        for (size_t k = 0; k < number_of_chunks; k++)
+            chunk_offsets[k + 1] = chunk_offsets[k] + build->bitmap_chunk_sizes[c][k];
+        if (pwrite(fd, chunk_offsets, (number_of_chunks + 1) * sizeof(uint64_t), header.chunks_offset[c]) != (ssize_t)((number_of_chunks + 1) * sizeof(uint64_t)))
+            failed = 1;
+        for (int t = 0; t < number_of_threads && !failed; t++)
+        {
+            struct spill_file *spill = &threads[t].bitmaps[c];
+            if (spill->size_in_bytes > 0)
+                failed = spill_copy(spill, 0, spill->size_in_bytes, fd, chunk_offsets[threads[t].first_bitmap_tuple / BITMAP_CHUNK_ROWS]);
+        }
+    }
+    failed |= index_file_close(build, fd);
+    if (failed)
+        perror(build->bitmap_index_filename);
+    free(chunk_offsets);
+    printf("Bitmap index: %ld bytes for %lu, %lu and %lu values of columns 2, 3 and 4\n", (long)file_size_in_bytes,
+           header.number_of_values[0], header.number_of_values[1], header.number_of_values[2]);
+    return failed;
+}
+
+// Write the header, the offset of every block and the packed blocks of every thread (copied from its spill file, in block order) to the .packed_data file
+static inline int write_packed_data_file(struct index_build *build, struct builder_thread *threads, int number_of_threads, size_t number_of_blocks)
+{
+    struct packed_file_header header = {PACKED_MAGIC, PACKED_VERSION, build->row_count, build->col_count, number_of_blocks};
+    uint64_t *block_offsets = malloc((number_of_blocks + 1) * sizeof(uint64_t));
+    if (block_offsets == NULL)
+    {
+        perror("Memory allocation error for the packed blocks");
+        exit(EXIT_FAILURE);
+    }
+    block_offsets[0] = sizeof(header) + (number_of_blocks + 1) * sizeof(uint64_t);
+    for (int t = 0; t < number_of_threads; t++)
+        for (size_t b = threads[t].first_block; b < threads[t].end_block; b++)
+            block_offsets[b + 1] = block_offsets[b] + threads[t].packed_block_sizes[b - threads[t].first_block];
+
+    int fd = index_file_open(build->packed_data_filename, block_offsets[number_of_blocks]);
+    int failed = pwrite(fd, &header, sizeof(header), 0) != sizeof(header);
+    failed |= pwrite(fd, block_offsets, (number_of_blocks + 1) * sizeof(uint64_t), sizeof(header)) != (ssize_t)((number_of_blocks + 1) * sizeof(uint64_t));
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        if (spill_copy(&threads[t].packed, 0, threads[t].packed.size_in_bytes, fd, block_offsets[threads[t].first_block]) != 0)
+            failed = 1;
+    }
+    failed |= index_file_close(build, fd);
+    if (failed)
+        perror(build->packed_data_filename);
+    printf("Packed blocks: %lu bytes (data file %lu bytes)\n", block_offsets[number_of_blocks], build->row_count * build->col_count * sizeof(uint64_t));
+    free(block_offsets);
+    return failed;
+}
+
+// A section of the .aggregates file written in order through a fixed-size buffer (the prefix sums or the leaves of a tree of a column)
+struct aggregate_section
+{
+    uint64_t *items;
+    size_t used;
+    off_t file_offset;          // where the buffered entries go in the file
+};
+
+static inline void aggregate_section_flush(struct aggregate_section *section, int fd, int *failed)
+{
+    size_t size_in_bytes = section->used * sizeof(uint64_t);
+    if (size_in_bytes > 0 && pwrite(fd, section->items, size_in_bytes, section->file_offset) != (ssize_t)size_in_bytes)
+        *failed = 1;
+    section->file_offset += size_in_bytes;
+    section->used = 0;
+}
+
+static inline void aggregate_section_append(struct aggregate_section *section, uint64_t value, int fd, int *failed)
+{
+    if (section->used == AGGREGATE_SECTION_BUFFER_ENTRIES)
+        aggregate_section_flush(section, fd, failed);
+    section->items[section->used++] = value;
+}
+
+/**
+ * Write the .aggregates file: for every column the prefix sums and the min and max trees of the blocks,
+ * from the (sum, min, max) the threads spilled for their blocks
+ * Only 3 buffers per column are in memory, whatever the number of blocks
+ */
+static inline int write_aggregate_file(struct index_build *build, struct builder_thread *threads, int number_of_threads, size_t number_of_blocks)
+{
+    struct aggregate_file_header header = {AGGREGATE_MAGIC, AGGREGATE_VERSION, build->row_count, build->col_count, number_of_blocks, aggregate_tree_leaves(number_of_blocks)};
+    int col_count = build->col_count;
+    int fd = index_file_open(build->aggregate_filename, aggregate_file_size_in_bytes(&header));
+    int failed = pwrite(fd, &header, sizeof(header), 0) != sizeof(header);
+    uint64_t *items = malloc(3 * col_count * AGGREGATE_SECTION_BUFFER_ENTRIES * sizeof(uint64_t));
+    struct aggregate_section *sections = malloc(3 * col_count * sizeof(struct aggregate_section));
+    if (items == NULL || sections == NULL)
+    {
+        perror("Memory allocation error for the aggregates");
+        exit(EXIT_FAILURE);
+    }
+
+    // Step 1: the prefix sums and the leaves of both trees of every column, block after block from the spill files of the threads
+    uint64_t sums[col_count];
+    for (int c = 0; c < col_count; c++)
+    {
+        for (int s = 0; s < 3; s++)
+        {
+            sections[3 * c + s].items = items + (3 * c + s) * AGGREGATE_SECTION_BUFFER_ENTRIES;
+            sections[3 * c + s].used = 0;
+        }
+        sections[3 * c].file_offset = aggregate_prefix_sums_offset(&header, c);
+        sections[3 * c + 1].file_offset = aggregate_min_tree_offset(&header, c) + header.tree_leaves * sizeof(uint64_t);
+        sections[3 * c + 2].file_offset = aggregate_max_tree_offset(&header, c) + header.tree_leaves * sizeof(uint64_t);
+        sums[c] = 0;
+        aggregate_section_append(&sections[3 * c], 0, fd, &failed);
+    }
+    size_t block_aggregates_size = 3 * col_count * sizeof(uint64_t);
+    for (int t = 0; t < number_of_threads && !failed; t++)
+    {
+        struct spill_file *spill = &threads[t].aggregates;
+        size_t read_size = spill->capacity_in_bytes / block_aggregates_size * block_aggregates_size;
+        for (uint64_t offset = 0; offset < spill->size_in_bytes && !failed; offset += read_size)
+        {
+            size_t size_in_bytes = spill->size_in_bytes - offset < read_size ? spill->size_in_bytes - offset : read_size;
+            if (pread(spill->fd, spill->buffer, size_in_bytes, offset) != (ssize_t)size_in_bytes)
+                failed = 1;
+            for (size_t b = 0; b < size_in_bytes / block_aggregates_size && !failed; b++)
+            {
+                const uint64_t *aggregates = (const uint64_t *)spill->buffer + b * 3 * col_count;
+                for (int c = 0; c < col_count; c++)
+                {
+                    sums[c] += aggregates[3 * c];
+                    aggregate_section_append(&sections[3 * c], sums[c], fd, &failed);
+                    aggregate_section_append(&sections[3 * c + 1], aggregates[3 * c + 1], fd, &failed);
+                    aggregate_section_append(&sections[3 * c + 2], aggregates[3 * c + 2], fd, &failed);
+                }
+            }
+        }
+    }
+    for (uint64_t leaf = number_of_blocks; leaf < header.tree_leaves; leaf++)
+        for (int c = 0; c < col_count; c++)
+        {
+            aggregate_section_append(&sections[3 * c + 1], UINT64_MAX, fd, &failed);      // the leaves past the last block never win
+            aggregate_section_append(&sections[3 * c + 2], 0, fd, &failed);
+        }
+    for (int s = 0; s < 3 * col_count; s++)
+        aggregate_section_flush(&sections[s], fd, &failed);
+
+    // Step 2: the inner nodes of both trees, a level at a time from the leaves up: nodes [width, 2 width)
+    // from their children [2 width, 4 width), read back from the file (node 0 is unused, left 0)
+    size_t nodes_per_step = AGGREGATE_SECTION_BUFFER_ENTRIES / 2;
+    uint64_t *min_children = items, *max_children = items + AGGREGATE_SECTION_BUFFER_ENTRIES;
+    uint64_t *min_nodes = items + 2 * AGGREGATE_SECTION_BUFFER_ENTRIES, *max_nodes = min_nodes + nodes_per_step;
+    for (int c = 0; c < col_count && !failed; c++)
+    {
+        off_t min_tree_offset = aggregate_min_tree_offset(&header, c), max_tree_offset = aggregate_max_tree_offset(&header, c);
+        for (uint64_t width = header.tree_leaves / 2; width >= 1 && !failed; width /= 2)
+            for (uint64_t node = width; node < 2 * width && !failed; node += nodes_per_step)
+            {
+                size_t number_of_nodes = 2 * width - node < nodes_per_step ? 2 * width - node : nodes_per_step;
+                ssize_t children_size = 2 * number_of_nodes * sizeof(uint64_t), nodes_size = number_of_nodes * sizeof(uint64_t);
+                if (pread(fd, min_children, children_size, min_tree_offset + 2 * node * sizeof(uint64_t)) != children_size ||
+                    pread(fd, max_children, children_size, max_tree_offset + 2 * node * sizeof(uint64_t)) != children_size)
+                {
+                    failed = 1;
+                    break;
+                }
+                aggregate_build_tree_level(min_children, max_children, min_nodes, max_nodes, number_of_nodes);
+                if (pwrite(fd, min_nodes, nodes_size, min_tree_offset + node * sizeof(uint64_t)) != nodes_size ||
+                    pwrite(fd, max_nodes, nodes_size, max_tree_offset + node * sizeof(uint64_t)) != nodes_size)
+                    failed = 1;
+            }
+    }
+
+    failed |= index_file_close(build, fd);
+    if (failed)
+        perror(build->aggregate_filename);
+    free(sections);
+    free(items);
+    return failed;
+}
+
+/**
+ * After every thread is done: write the files built from what the threads kept (learned index, bitmap
+ * index, packed data, aggregates) and the headers, free the threads' memory and close the files
+ * Returns 0, 1 if a thread or a write failed
+ */
+static inline int index_build_finish(struct index_build *build, struct builder_thread *threads, int number_of_threads)
+{
+    size_t total_number_of_blocks_in_file = (build->row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    int failed = 0;
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        failed |= threads[t].failed;
+        build->dense_index_header.checksum += threads[t].dense_checksum;
+        build->sparse_index_header.checksum += threads[t].sparse_checksum;
+    }
+    if (!failed)
+        failed = write_learned_index_file(build, threads, number_of_threads);
+    if (!failed)
+        failed = write_bitmap_index_file(build, threads, number_of_threads);
+    if (!failed)
+        failed = write_packed_data_file(build, threads, number_of_threads, total_number_of_blocks_in_file);
+    if (!failed)
+        failed = write_aggregate_file(build, threads, number_of_threads, total_number_of_blocks_in_file);
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        learned_builder_free(&threads[t].learned);
+        spill_close(&threads[t].packed);
+        spill_close(&threads[t].aggregates);
+        for (int c = 0; c < BITMAP_INDEX_COLUMNS; c++)
+            spill_close(&threads[t].bitmaps[c]);
+        free(threads[t].packed_block_sizes);
+    }
+    for (int c = 0; c < BITMAP_INDEX_COLUMNS; c++)
+        free(build->bitmap_chunk_sizes[c]);
+
+    int btree_fd = build->outputs[BTREE_LEVEL_OUTPUT].fd;
+    int dense_fd = build->outputs[DENSE_KEY_OUTPUT].fd, sparse_fd = build->outputs[SPARSE_KEY_OUTPUT].fd;
+    if (pwrite(btree_fd, &build->btree_header, sizeof(build->btree_header), 0) != sizeof(build->btree_header))
+        failed = 1;
+    if (pwrite(dense_fd, &build->dense_index_header, sizeof(build->dense_index_header), 0) != sizeof(build->dense_index_header))
+        failed = 1;
+    if (pwrite(sparse_fd, &build->sparse_index_header, sizeof(build->sparse_index_header), 0) != sizeof(build->sparse_index_header))
+        failed = 1;
+
+    failed |= index_file_close(build, dense_fd);
+    failed |= index_file_close(build, sparse_fd);
+    failed |= index_file_close(build, build->outputs[ZONEMAP_OUTPUT].fd);
+    failed |= index_file_close(build, btree_fd);
+    return failed;
+}
+
+#endif
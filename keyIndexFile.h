@@ -0,0 +1,172 @@
+#ifndef KEY_INDEX_FILE_H
+#define KEY_INDEX_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * File format of the dense and sparse indexes (the .dense_index and .sparse_index files)
+ *
+ * Version 2: a header page (struct key_index_header, padded to KEY_INDEX_SECTION_ALIGNMENT), then the
+ * keys of all the entries, then their pointers, each section contiguous and page-aligned. A reader maps
+ * the file and searches the key section in place: nothing is copied at load time.
+ *   entry i describes tuple i * entry_stride (1 for the dense index; for the sparse index 10 unless it
+ *   was built with another granularity, createPrimaryKeyIndexFiles -g, so readers take it from the header)
+ *   its pointer is the position of that tuple in the data file, in items or in bytes (pointer_unit)
+ *   checksum covers the keys and the pointers (key_index_checksum_entry, summed over the entries, so
+ *   the builder threads can each checksum the entries they write)
+ *
+ * Version 1 (legacy): (key, pointer) pairs, without a header. It is still read: its keys are copied
+ * into a buffer of their own and its pointers are read in place, one pair apart.
+ */
+#define KEY_INDEX_MAGIC 0x5845444e4959454bULL      // "KEYINDEX"
+#define KEY_INDEX_VERSION 2
+#define KEY_INDEX_LEGACY_VERSION 1
+#define KEY_INDEX_SECTION_ALIGNMENT 4096
+#define KEY_INDEX_SPARSE_DEFAULT_STRIDE 10      // tuples per sparse entry of a legacy file or a default build
+
+enum key_index_pointer_unit
+{
+    KEY_INDEX_POINTER_ITEMS = 0,    // pointer = position of the tuple in items (uint64_t), the dense index
+    KEY_INDEX_POINTER_BYTES = 1     // pointer = byte offset of the tuple, the sparse index
+};
+
+struct key_index_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t number_of_entries;
+    uint64_t entry_stride;          // tuples per entry
+    uint64_t block_size;            // tuples per block of the data file
+    uint64_t pointer_unit;
+    uint64_t keys_offset;           // in bytes from the start of the file
+    uint64_t pointers_offset;
+    uint64_t checksum;
+};
+
+static inline uint64_t key_index_section_size(uint64_t number_of_entries)
+{
+    uint64_t size = number_of_entries * sizeof(uint64_t);
+    return (size + KEY_INDEX_SECTION_ALIGNMENT - 1) / KEY_INDEX_SECTION_ALIGNMENT * KEY_INDEX_SECTION_ALIGNMENT;
+}
+
+static inline void key_index_header_init(struct key_index_header *header, uint64_t row_count, uint64_t entry_stride, uint64_t block_size, uint64_t pointer_unit)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = KEY_INDEX_MAGIC;
+    header->version = KEY_INDEX_VERSION;
+    header->row_count = row_count;
+    header->number_of_entries = (row_count + entry_stride - 1) / entry_stride;
+    header->entry_stride = entry_stride;
+    header->block_size = block_size;
+    header->pointer_unit = pointer_unit;
+    header->keys_offset = KEY_INDEX_SECTION_ALIGNMENT;
+    header->pointers_offset = header->keys_offset + key_index_section_size(header->number_of_entries);
+}
+
+static inline uint64_t key_index_file_size(const struct key_index_header *header)
+{
+    return header->pointers_offset + key_index_section_size(header->number_of_entries);
+}
+
+// Checksum of one entry, the checksum of a file is the sum over its entries (any order, any split)
+static inline uint64_t key_index_checksum_entry(uint64_t entry, uint64_t key, uint64_t pointer)
+{
+    uint64_t x = (key ^ entry * 0x9e3779b97f4a7c15ULL) * 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 31;
+    x = (x + pointer) * 0x94d049bb133111ebULL;
+    return x ^ x >> 29;
+}
+
+// Tuples per entry recorded in the header of a mapped index file, default_stride for a legacy file
+static inline uint64_t key_index_file_stride(const void *mapping, size_t size_in_bytes, uint64_t default_stride)
+{
+    const struct key_index_header *header = mapping;
+    if (mapping != NULL && size_in_bytes >= sizeof(*header) && header->magic == KEY_INDEX_MAGIC && header->entry_stride > 0)
+        return header->entry_stride;
+    return default_stride;
+}
+
+/**
+ * Reader side: an index file mapped in memory
+ * keys points to the key section of the mapping (a version 2 file) or to a copy of the keys (legacy)
+ */
+struct key_index
+{
+    struct key_index_header header;
+    const uint64_t *keys;
+    const uint64_t *pointers;
+    size_t pointer_stride;          // 1, or 2 in a legacy file (a pointer follows its key)
+    uint64_t *legacy_keys;          // the copy of the keys of a legacy file
+};
+
+/**
+ * Open the mapping of an index file that must describe row_count tuples, entry_stride per entry
+ * Returns 0, or -1 if the file is not such an index (wrong header, truncated)
+ */
+static inline int key_index_open(struct key_index *index, const void *mapping, size_t size_in_bytes,
+                                 uint64_t row_count, uint64_t entry_stride, uint64_t block_size, uint64_t pointer_unit)
+{
+    memset(index, 0, sizeof(*index));
+    const struct key_index_header *header = mapping;
+    if (size_in_bytes >= sizeof(*header) && header->magic == KEY_INDEX_MAGIC)
+    {
+        index->header = *header;
+        if (header->version != KEY_INDEX_VERSION || header->row_count != row_count || header->entry_stride != entry_stride ||
+            header->block_size != block_size || header->pointer_unit != pointer_unit ||
+            size_in_bytes < header->pointers_offset + header->number_of_entries * sizeof(uint64_t) ||
+            header->keys_offset + header->number_of_entries * sizeof(uint64_t) > header->pointers_offset)
+            return -1;
+        index->keys = (const uint64_t *)((const char *)mapping + header->keys_offset);
+        index->pointers = (const uint64_t *)((const char *)mapping + header->pointers_offset);
+        index->pointer_stride = 1;
+        return 0;
+    }
+
+    // Legacy file: interleaved (key, pointer) pairs, the header is what the caller expects
+    key_index_header_init(&index->header, row_count, entry_stride, block_size, pointer_unit);
+    index->header.version = KEY_INDEX_LEGACY_VERSION;
+    index->header.keys_offset = 0;
+    index->header.pointers_offset = sizeof(uint64_t);
+    uint64_t number_of_entries = index->header.number_of_entries;
+    if (size_in_bytes < number_of_entries * 2 * sizeof(uint64_t))
+        return -1;
+    index->legacy_keys = malloc(number_of_entries * sizeof(uint64_t) + 1);
+    if (index->legacy_keys == NULL)
+    {
+        perror("Memory allocation error for the index keys");
+        exit(EXIT_FAILURE);
+    }
+    const uint64_t *pairs = mapping;
+    for (uint64_t i = 0; i < number_of_entries; i++)
+        index->legacy_keys[i] = pairs[i * 2];
+    index->keys = index->legacy_keys;
+    index->pointers = pairs + 1;
+    index->pointer_stride = 2;
+    return 0;
+}
+
+static inline uint64_t key_index_pointer(const struct key_index *index, uint64_t entry)
+{
+    return index->pointers[entry * index->pointer_stride];
+}
+
+// Checksum of the keys and pointers as they are now (compare with header.checksum, a legacy file has none)
+static inline uint64_t key_index_checksum(const struct key_index *index)
+{
+    uint64_t checksum = 0;
+    for (uint64_t i = 0; i < index->header.number_of_entries; i++)
+        checksum += key_index_checksum_entry(i, index->keys[i], key_index_pointer(index, i));
+    return checksum;
+}
+
+static inline void key_index_close(struct key_index *index)
+{
+    free(index->legacy_keys);
+    memset(index, 0, sizeof(*index));
+}
+
+#endif
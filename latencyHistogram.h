@@ -0,0 +1,98 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Latency histogram in the style of HdrHistogram: values (nanoseconds) below 2^LATENCY_SUB_BUCKET_BITS
+ * have a bucket each, above that every power of two is split into 2^LATENCY_SUB_BUCKET_BITS linear
+ * buckets, so any value is recorded within 1/128 (0.8%) of itself from nanoseconds to hours, in a fixed
+ * 58 KiB array and with no division or floating point on the record path.
+ *
+ * The percentiles return the largest value of the bucket holding the requested rank, like HdrHistogram's
+ * highest equivalent value: a reported p99 is never below the true one.
+ */
+#define LATENCY_SUB_BUCKET_BITS 7
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+struct latency_histogram
+{
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total_count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+};
+
+static inline void latency_histogram_init(struct latency_histogram *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT64_MAX;
+}
+
+static inline size_t latency_bucket(uint64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS)
+        return value;
+    int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + ((value >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+// Largest value recorded in a bucket
+static inline uint64_t latency_bucket_highest_value(size_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return bucket;
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+static inline void latency_histogram_record(struct latency_histogram *histogram, uint64_t value)
+{
+    histogram->counts[latency_bucket(value)]++;
+    histogram->total_count++;
+    histogram->min = value < histogram->min ? value : histogram->min;
+    histogram->max = value > histogram->max ? value : histogram->max;
+    histogram->sum += value;
+}
+
+// Add the values of another histogram (one histogram per thread, merged at the end)
+static inline void latency_histogram_add(struct latency_histogram *histogram, const struct latency_histogram *other)
+{
+    for (size_t b = 0; b < LATENCY_BUCKETS; b++)
+        histogram->counts[b] += other->counts[b];
+    histogram->total_count += other->total_count;
+    histogram->min = other->min < histogram->min ? other->min : histogram->min;
+    histogram->max = other->max > histogram->max ? other->max : histogram->max;
+    histogram->sum += other->sum;
+}
+
+// Value at a percentile in [0, 100]; 0 for an empty histogram
+static inline uint64_t latency_histogram_percentile(const struct latency_histogram *histogram, double percentile)
+{
+    if (histogram->total_count == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * histogram->total_count + 0.5);
+    rank = rank < 1 ? 1 : rank > histogram->total_count ? histogram->total_count : rank;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += histogram->counts[b];
+        if (seen >= rank)
+        {
+            uint64_t value = latency_bucket_highest_value(b);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static inline double latency_histogram_mean(const struct latency_histogram *histogram)
+{
+    return histogram->total_count > 0 ? histogram->sum / histogram->total_count : 0;
+}
+
+#endif
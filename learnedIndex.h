@@ -0,0 +1,201 @@
+#ifndef LEARNED_INDEX_H
+#define LEARNED_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * Learned index over the clustered primary key (the .learned_index file)
+ *
+ * The keys are sorted, so the position of a tuple is a monotone function of its key. The index is a
+ * piecewise-linear model of that function: segment s covers the keys from first_key up to the next
+ * segment's first key and predicts
+ *     position(key) ~ first_position + slope * (key - first_key)
+ * The builder guarantees |predicted - real position| <= error_bound at the first tuple of every distinct
+ * key, so a lookup is one search over the (few) segments and a search of about 2 * error_bound tuples
+ * around the prediction, in the data file itself.
+ *
+ * The file is struct learned_index_header followed by number_of_segments struct learned_segment.
+ */
+#define LEARNED_INDEX_MAGIC 0x5845444e494e524cULL   // "LRNINDEX"
+#define LEARNED_INDEX_VERSION 1
+#define LEARNED_INDEX_DEFAULT_ERROR_BOUND 32
+
+struct learned_index_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t error_bound;           // in tuples
+    uint64_t number_of_segments;
+};
+
+struct learned_segment
+{
+    uint64_t first_key;
+    uint64_t first_position;        // tuple of first_key
+    double slope;                   // tuples per key
+};
+
+/**
+ * Builder side: the segments are cut greedily ("shrinking cone"). A segment starts at a point
+ * (first_key, first_position); every following point narrows the range of slopes that keep all the
+ * points of the segment within error_bound, and the point that would make the range empty starts
+ * the next segment.
+ */
+struct learned_index_builder
+{
+    uint64_t error_bound;
+    struct learned_segment *segments;
+    size_t number_of_segments;
+    size_t capacity;
+    double slope_low;               // slopes that keep the points of the current segment within bounds
+    double slope_high;
+    uint64_t last_key;
+};
+
+static inline void learned_builder_init(struct learned_index_builder *builder, uint64_t error_bound)
+{
+    memset(builder, 0, sizeof(*builder));
+    builder->error_bound = error_bound;
+}
+
+// Close the current segment with the middle of its slope range
+static inline void learned_builder_close_segment(struct learned_index_builder *builder)
+{
+    if (builder->number_of_segments == 0)
+        return;
+    struct learned_segment *segment = &builder->segments[builder->number_of_segments - 1];
+    if (builder->slope_high == __builtin_inf())
+        segment->slope = builder->slope_low;        // a single point (or a single gap): any slope >= low works
+    else
+        segment->slope = (builder->slope_low + builder->slope_high) / 2;
+}
+
+// Add the tuple "position" with key "key", the keys must be added in order
+static inline void learned_builder_add(struct learned_index_builder *builder, uint64_t key, uint64_t position)
+{
+    if (builder->number_of_segments > 0)
+    {
+        // the model only needs the first tuple of every key
+        if (key == builder->last_key)
+            return;
+
+        struct learned_segment *segment = &builder->segments[builder->number_of_segments - 1];
+        double dx = (double)(key - segment->first_key);
+        double dy = (double)(position - segment->first_position);
+        double low = (dy - builder->error_bound) / dx;
+        double high = (dy + builder->error_bound) / dx;
+        if (low <= builder->slope_high && high >= builder->slope_low)
+        {
+            builder->slope_low = low > builder->slope_low ? low : builder->slope_low;
+            builder->slope_high = high < builder->slope_high ? high : builder->slope_high;
+            builder->last_key = key;
+            return;
+        }
+        learned_builder_close_segment(builder);
+    }
+
+    if (builder->number_of_segments == builder->capacity)
+    {
+        builder->capacity = builder->capacity ? builder->capacity * 2 : 1024;
+        builder->segments = realloc(builder->segments, builder->capacity * sizeof(struct learned_segment));
+        if (builder->segments == NULL)
+        {
+            perror("Memory allocation error for the learned index segments");
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct learned_segment *segment = &builder->segments[builder->number_of_segments++];
+    segment->first_key = key;
+    segment->first_position = position;
+    segment->slope = 0;
+    builder->slope_low = 0;
+    builder->slope_high = __builtin_inf();
+    builder->last_key = key;
+}
+
+static inline void learned_builder_finish(struct learned_index_builder *builder)
+{
+    learned_builder_close_segment(builder);
+}
+
+static inline void learned_builder_free(struct learned_index_builder *builder)
+{
+    free(builder->segments);
+}
+
+/**
+ * Reader side: the whole file is read at open, it is a few KiB for the generated keys
+ */
+struct learned_index
+{
+    struct learned_index_header header;
+    struct learned_segment *segments;
+};
+
+// Read the .learned_index file, returns -1 if it is missing or not a learned index of this version
+static inline int learned_open(struct learned_index *index, const char *filename)
+{
+    memset(index, 0, sizeof(*index));
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    if (pread(fd, &index->header, sizeof(index->header), 0) != sizeof(index->header) ||
+        index->header.magic != LEARNED_INDEX_MAGIC || index->header.version != LEARNED_INDEX_VERSION ||
+        index->header.number_of_segments == 0)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t segments_size_in_bytes = index->header.number_of_segments * sizeof(struct learned_segment);
+    index->segments = malloc(segments_size_in_bytes);
+    if (index->segments == NULL ||
+        pread(fd, index->segments, segments_size_in_bytes, sizeof(index->header)) != (ssize_t)segments_size_in_bytes)
+    {
+        free(index->segments);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+static inline void learned_close(struct learned_index *index)
+{
+    free(index->segments);
+}
+
+static inline size_t learned_index_size_in_bytes(const struct learned_index *index)
+{
+    return sizeof(index->header) + index->header.number_of_segments * sizeof(struct learned_segment);
+}
+
+// Predicted position of the first tuple with a key >= value, in [0, row_count]
+static inline uint64_t learned_predict(const struct learned_index *index, uint64_t value)
+{
+    // Step 1: the last segment starting at or before value (binary search over the segments)
+    size_t low = 0, high = index->header.number_of_segments;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (index->segments[mid].first_key <= value)
+            low = mid;
+        else
+            high = mid;
+    }
+    const struct learned_segment *segment = &index->segments[low];
+    if (value <= segment->first_key)
+        return segment->first_position;
+
+    // Step 2: evaluate its line, never past the first tuple of the next segment
+    double predicted = segment->first_position + segment->slope * (double)(value - segment->first_key);
+    uint64_t end = high < index->header.number_of_segments ? index->segments[high].first_position : index->header.row_count;
+    return predicted >= (double)end ? end : (uint64_t)(predicted + 0.5);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef LEVEL_INDEX_H
+#define LEVEL_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Levels of separator keys over a sorted key array, built when an index is loaded
+ *
+ * Level 0 is the key array itself, searched in place (the key section of the mapped sparse index).
+ * Level l + 1 keeps the first key of every node of LEVEL_INDEX_FANOUT keys of level l, up to a top level
+ * of at most LEVEL_INDEX_FANOUT keys. Key j of level l + 1 leads to the node of level l starting at
+ * j * LEVEL_INDEX_FANOUT, so a search counts the keys below the value in the top level, then in one node
+ * per level: a node is two cache lines, counted without a branch. The levels above the keys hold 1/15 of
+ * them, small enough to stay in the cache, so a lookup misses on one node of the key array.
+ */
+#define LEVEL_INDEX_FANOUT 16
+#define LEVEL_INDEX_MAX_LEVELS 16
+
+struct level_index
+{
+    const uint64_t *levels[LEVEL_INDEX_MAX_LEVELS];    // levels[0] is the key array, levels[number_of_levels - 1] the top
+    size_t sizes[LEVEL_INDEX_MAX_LEVELS];
+    int number_of_levels;
+    size_t size_in_bytes;                               // memory of the levels above the keys
+};
+
+// Build the levels above n sorted keys (keys is not copied and must outlive the index)
+static inline void level_index_build(struct level_index *index, const uint64_t *keys, size_t n)
+{
+    index->levels[0] = keys;
+    index->sizes[0] = n;
+    index->number_of_levels = 1;
+    index->size_in_bytes = 0;
+    while (index->sizes[index->number_of_levels - 1] > LEVEL_INDEX_FANOUT && index->number_of_levels < LEVEL_INDEX_MAX_LEVELS)
+    {
+        int l = index->number_of_levels;
+        const uint64_t *below = index->levels[l - 1];
+        size_t size = (index->sizes[l - 1] + LEVEL_INDEX_FANOUT - 1) / LEVEL_INDEX_FANOUT;
+        // 64 byte aligned so that every node is two whole cache lines
+        size_t size_in_bytes = (size * sizeof(uint64_t) + 63) / 64 * 64;
+        uint64_t *level = aligned_alloc(64, size_in_bytes);
+        if (level == NULL)
+        {
+            perror("Memory allocation error for the index levels");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t j = 0; j < size; j++)
+            level[j] = below[j * LEVEL_INDEX_FANOUT];
+        index->levels[l] = level;
+        index->sizes[l] = size;
+        index->size_in_bytes += size_in_bytes;
+        index->number_of_levels++;
+    }
+}
+
+static inline void level_index_free(struct level_index *index)
+{
+    for (int l = 1; l < index->number_of_levels; l++)
+        free((void *)index->levels[l]);
+    index->number_of_levels = 0;
+}
+
+/**
+ * Position of the last key < value ("keys[i] <= value" if inclusive) in the key array,
+ * UINT64_MAX if there is none; the search reads one node per level
+ */
+static inline uint64_t level_index_last_below(const struct level_index *index, uint64_t value, int inclusive)
+{
+    size_t position = 0;
+    for (int l = index->number_of_levels - 1; l >= 0; l--)
+    {
+        const uint64_t *node = index->levels[l] + position;
+        size_t n = index->sizes[l] - position < LEVEL_INDEX_FANOUT ? index->sizes[l] - position : LEVEL_INDEX_FANOUT;
+        size_t below = 0;
+        for (size_t k = 0; k < n; k++)
+            below += inclusive ? node[k] <= value : node[k] < value;
+        // the key leading to this node is below the value, so only the top level can have none
+        if (below == 0)
+            return UINT64_MAX;
+        position = l > 0 ? (position + below - 1) * LEVEL_INDEX_FANOUT : position + below - 1;
+    }
+    return position;
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tableLayout.h"
+#include "keyIndexFile.h"
+#include "indexBuilder.h"
+#include "deltaSegment.h"
+#include "tableUtilities.h"
+
+uint64_t row_count = 0;
+int col_count = 0;
+char filenameSkeleteon[1024];
+enum table_layout data_layout = LAYOUT_ROW_MAJOR;
+
+#define WRITE_BUFFER_ITEMS (1 << 17)            // every output is written in 1 MiB chunks
+
+/**
+ * Folds the delta segment of a table into its data file, LSM style: the clustered data file and the
+ * sorted delta rows are merged on the key into a new data file, and every index file of the merged
+ * file is written in the same pass: every merged block is handed to a builder thread (indexBuilder.h)
+ * as it is written, so the new generation has the same files createPrimaryKeyIndexFiles would build.
+ *
+ * Readers are never blocked: the merge writes a new generation of the files (<skeleton>.g<N>.data,
+ * the index files, .delta) next to the current one, then switches the metadata file to it
+ * with a rename. A reader that opened the table before keeps the files it mapped, the next one opens
+ * the new generation. Rows appended during the merge are carried over: under the lock of the current
+ * delta segment, the runs committed after the merge started are copied to the new delta segment, and
+ * the metadata is renamed before the lock is released (appendRows checks the metadata under the lock).
+ */
+struct merge_output
+{
+    const char *filename;
+    int fd;
+    off_t offset;
+    uint64_t *items;
+    size_t used;
+    int failed;
+};
+
+void merge_output_open(struct merge_output *output, const char *filename, int fd, off_t offset)
+{
+    output->filename = filename;
+    output->fd = fd;
+    output->offset = offset;
+    output->items = malloc(WRITE_BUFFER_ITEMS * sizeof(uint64_t));
+    output->used = 0;
+    output->failed = output->items == NULL;
+}
+
+void merge_output_flush(struct merge_output *output)
+{
+    size_t bytes = output->used * sizeof(uint64_t);
+    if (bytes > 0 && pwrite(output->fd, output->items, bytes, output->offset) != (ssize_t)bytes)
+    {
+        perror(output->filename);
+        output->failed = 1;
+    }
+    output->offset += bytes;
+    output->used = 0;
+}
+
+static inline void merge_output_append(struct merge_output *output, const uint64_t *items, size_t n)
+{
+    if (output->used + n > WRITE_BUFFER_ITEMS)
+        merge_output_flush(output);
+    memcpy(output->items + output->used, items, n * sizeof(uint64_t));
+    output->used += n;
+}
+
+void merge_output_close(struct merge_output *output)
+{
+    merge_output_flush(output);
+    free(output->items);
+}
+
+int create_file(const char *filename, off_t size_in_bytes)
+{
+    int fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH);
+    if (fd == -1)
+    {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, size_in_bytes) != 0)
+        perror("Error sizing file");
+    return fd;
+}
+
+// The skeleton of the next generation: "t" -> "t.g1", "t.g1" -> "t.g2"
+void next_generation(const char *skeleton, char *next)
+{
+    const char *suffix = strrchr(skeleton, '.');
+    size_t base_length = strlen(skeleton);
+    int generation = 1;
+    if (suffix != NULL && suffix[1] == 'g' && suffix[2] != '\0')
+    {
+        int digits = 1;
+        for (const char *c = suffix + 2; *c != '\0'; c++)
+            digits &= isdigit((unsigned char)*c) != 0;
+        if (digits)
+        {
+            generation = atoi(suffix + 2) + 1;
+            base_length = suffix - skeleton;
+        }
+    }
+    snprintf(next, 1024, "%.*s.g%d", (int)base_length, skeleton, generation);
+}
+
+// Tuples per entry of the current sparse index (createPrimaryKeyIndexFiles -g), the new one keeps it
+uint64_t current_sparse_index_interval()
+{
+    struct key_index_header header;
+    ssize_t bytes_read = 0;
+    char *sparse_index_filename = filename_with_extension(filenameSkeleteon, ".sparse_index");
+    int fd = open(sparse_index_filename, O_RDONLY);
+    if (fd != -1)
+    {
+        bytes_read = pread(fd, &header, sizeof(header), 0);
+        close(fd);
+    }
+    free(sparse_index_filename);
+    return key_index_file_stride(&header, bytes_read > 0 ? bytes_read : 0, KEY_INDEX_SPARSE_DEFAULT_STRIDE);
+}
+
+// Error bound of the current learned index (createPrimaryKeyIndexFiles -e), the new one keeps it
+uint64_t current_learned_index_error_bound()
+{
+    struct learned_index_header header;
+    ssize_t bytes_read = 0;
+    char *learned_index_filename = filename_with_extension(filenameSkeleteon, ".learned_index");
+    int fd = open(learned_index_filename, O_RDONLY);
+    if (fd != -1)
+    {
+        bytes_read = pread(fd, &header, sizeof(header), 0);
+        close(fd);
+    }
+    free(learned_index_filename);
+    if (bytes_read == sizeof(header) && header.magic == LEARNED_INDEX_MAGIC && header.error_bound > 0)
+        return header.error_bound;
+    return LEARNED_INDEX_DEFAULT_ERROR_BOUND;
+}
+
+/**
+ * Merge the data file and the delta rows into the data file of the new generation, with all its index
+ * files; the tuples keep the order of their keys (base tuples first among equal keys)
+ * Returns the number of tuples written, 0 on a failure
+ */
+uint64_t merge_data_file(const struct delta_index *delta, const char *source_data_filename, const char *target_skeleton)
+{
+    uint64_t merged_row_count = row_count + delta->header.number_of_rows;
+    size_t merged_number_of_blocks = (merged_row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+
+    int source_fd = open(source_data_filename, O_RDONLY);
+    if (source_fd == -1)
+    {
+        perror(source_data_filename);
+        return 0;
+    }
+    // the new data file keeps the block size (and the header, if any) of the current one
+    struct data_file_geometry geometry;
+    if (read_data_file_geometry(source_fd, data_layout, col_count, &geometry) != 0)
+    {
+        printf("The header of %s does not match its metadata\n", source_data_filename);
+        close(source_fd);
+        return 0;
+    }
+    size_t block_size_in_number_of_items = geometry.block_stride_in_items;
+    size_t block_size_in_bytes = block_stride_in_bytes(&geometry);
+    char *data_filename = filename_with_extension(target_skeleton, ".data");
+    int data_fd = create_file(data_filename, data_file_size_in_bytes(&geometry, merged_number_of_blocks));
+    struct merge_output data;
+    merge_output_open(&data, data_filename, data_fd, block_offset_in_bytes(&geometry, 0));
+
+    // the index files of the new generation keep the sparse granularity and the error bound of the current ones
+    struct index_build build;
+    struct builder_thread thread;
+    index_build_init(&build, target_skeleton, merged_row_count, col_count, data_layout, &geometry,
+                     current_sparse_index_interval(), current_learned_index_error_bound());
+    build.sync_files = 1;
+    index_build_open(&build);
+    builder_thread_start(&build, &thread, 0, merged_number_of_blocks);
+
+    uint64_t *source_block = malloc(block_size_in_bytes);
+    uint64_t *target_block = calloc(block_size_in_number_of_items, sizeof(uint64_t));
+    int failed = source_block == NULL || target_block == NULL || thread.failed;
+    if (geometry.data_offset_in_items > 0)
+    {
+        struct data_file_header header;
+        data_file_header_init(&header, merged_row_count, &geometry);
+        failed |= pwrite(data_fd, &header, sizeof(header), 0) != sizeof(header);
+    }
+
+    // Step 1: merge the tuples of the data file (block by block) with the delta rows, both in key order
+    uint64_t base_tuple = 0, delta_row = 0, tuple_index = 0;
+    size_t loaded_block = SIZE_MAX;
+    while (tuple_index < merged_row_count && !failed)
+    {
+        size_t block_index = base_tuple / TUPLES_PER_BLOCK;
+        if (base_tuple < row_count && block_index != loaded_block)
+        {
+            if (pread(source_fd, source_block, block_size_in_bytes, block_offset_in_bytes(&geometry, block_index)) != (ssize_t)block_size_in_bytes)
+            {
+                printf("Data file %s is shorter than its metadata (block %zu)\n", source_data_filename, block_index);
+                failed = 1;
+                break;
+            }
+            loaded_block = block_index;
+        }
+
+        // the next tuple: from the data file unless the next delta row has a smaller key
+        size_t tuple_in_target = tuple_index % TUPLES_PER_BLOCK;
+        const uint64_t *delta_values = delta_row < delta->header.number_of_rows ? delta_index_row(delta, delta_row) : NULL;
+        int from_base = base_tuple < row_count &&
+                        (delta_values == NULL || source_block[item_in_block(data_layout, col_count, base_tuple % TUPLES_PER_BLOCK, 0)] <= delta_values[0]);
+        for (int j = 0; j < col_count; j++)
+            target_block[item_in_block(data_layout, col_count, tuple_in_target, j)] =
+                from_base ? source_block[item_in_block(data_layout, col_count, base_tuple % TUPLES_PER_BLOCK, j)] : delta_values[j];
+        base_tuple += from_base;
+        delta_row += !from_base;
+
+        // Step 2: a complete block goes to the data file and to the builder, which writes its entries in every index file
+        tuple_index++;
+        if (tuple_index % TUPLES_PER_BLOCK == 0 || tuple_index == merged_row_count)
+        {
+            merge_output_append(&data, target_block, block_size_in_number_of_items);
+            index_block(&thread, (tuple_index - 1) / TUPLES_PER_BLOCK, target_block);
+            memset(target_block, 0, block_size_in_bytes);
+            failed |= thread.failed;
+        }
+    }
+
+    // Step 3: the files built after the pass (learned index, bitmap index, packed data, aggregates) and the headers
+    builder_thread_finish(&thread);
+    merge_output_close(&data);
+    failed |= data.failed;
+    failed |= index_build_finish(&build, &thread, 1);
+    failed |= fsync(data_fd) != 0;
+
+    free(source_block);
+    free(target_block);
+    close(source_fd);
+    close(data_fd);
+    free(data_filename);
+    index_build_free(&build);
+    return failed ? 0 : merged_row_count;
+}
+
+/**
+ * Switch the table to the new generation: under the lock of the current delta segment, copy the runs
+ * committed since "merged" (the header the merge started from) to the new delta segment, then rename
+ * the new metadata over the metadata file
+ */
+int switch_generation(const char *metadata_filename, const char *delta_filename, const struct delta_file_header *merged,
+                      const char *target_skeleton, uint64_t merged_row_count)
+{
+    struct delta_file_header current;
+    int fd = delta_open_locked(delta_filename, col_count, &current);
+    if (fd == -1)
+    {
+        perror(delta_filename);
+        return 1;
+    }
+
+    char *target_delta_filename = filename_with_extension(target_skeleton, ".delta");
+    struct delta_file_header carried;
+    delta_header_init(&carried, col_count);
+    carried.number_of_runs = current.number_of_runs - merged->number_of_runs;
+    carried.number_of_rows = current.number_of_rows - merged->number_of_rows;
+    carried.size_in_bytes = sizeof(carried) + current.size_in_bytes - merged->size_in_bytes;
+    int target_fd = create_file(target_delta_filename, carried.size_in_bytes);
+    int failed = pwrite(target_fd, &carried, sizeof(carried), 0) != sizeof(carried);
+    char buffer[1 << 16];
+    for (off_t offset = merged->size_in_bytes; offset < (off_t)current.size_in_bytes && !failed;)
+    {
+        size_t bytes = current.size_in_bytes - offset < sizeof(buffer) ? current.size_in_bytes - offset : sizeof(buffer);
+        failed = pread(fd, buffer, bytes, offset) != (ssize_t)bytes ||
+                 pwrite(target_fd, buffer, bytes, sizeof(carried) + offset - merged->size_in_bytes) != (ssize_t)bytes;
+        offset += bytes;
+    }
+    failed |= fsync(target_fd) != 0;
+    close(target_fd);
+
+    char *temporary_metadata_filename = filename_with_extension(metadata_filename, ".tmp");
+    FILE *fptr = fopen(temporary_metadata_filename, "w");
+    if (!failed && fptr != NULL)
+    {
+        fprintf(fptr, "%s\n%lu\n%d\n%s", target_skeleton, merged_row_count, col_count, layout_name(data_layout));
+        failed = fflush(fptr) != 0 || fsync(fileno(fptr)) != 0;
+        fclose(fptr);
+        failed = failed || rename(temporary_metadata_filename, metadata_filename) != 0;
+    }
+    else
+        failed = 1;
+    if (failed)
+        perror("Error switching the table to the merged files");
+    else
+        printf("Carried %lu rows appended during the merge over to %s\n", carried.number_of_rows, target_delta_filename);
+
+    delta_close(fd);
+    free(target_delta_filename);
+    free(temporary_metadata_filename);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <metadata file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *metadata_filename = argv[1];
+
+    FILE *fptr;
+    char layout[16];
+    fptr = fopen(metadata_filename, "r");
+    if (fptr == NULL)
+    {
+        perror("Error opening metadata file");
+        return EXIT_FAILURE;
+    }
+    if (fscanf(fptr, "%1023s\n%lu\n%d\n%15s", filenameSkeleteon, &row_count, &col_count, layout) == 4)
+        data_layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+    fclose(fptr);
+
+    char *data_filename = filename_with_extension(filenameSkeleteon, ".data");
+    char *delta_filename = filename_with_extension(filenameSkeleteon, ".delta");
+    clock_t start_m = clock();
+
+    // Step 1: the delta rows committed so far, in key order (appends go on meanwhile)
+    int delta_fd = open(delta_filename, O_RDONLY);
+    struct stat file_stat;
+    if (delta_fd == -1 || fstat(delta_fd, &file_stat) == -1 || file_stat.st_size == 0)
+    {
+        printf("No delta segment %s, nothing to merge\n", delta_filename);
+        return 0;
+    }
+    void *mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, delta_fd, 0);
+    close(delta_fd);
+    struct delta_index delta;
+    if (mapping == MAP_FAILED || delta_index_build(&delta, mapping, file_stat.st_size, col_count) != 0)
+    {
+        printf("%s is not a delta segment of a %d-column table\n", delta_filename, col_count);
+        return EXIT_FAILURE;
+    }
+    if (delta.header.number_of_rows == 0)
+    {
+        printf("Delta segment %s is empty, nothing to merge\n", delta_filename);
+        return 0;
+    }
+
+    // Step 2: the data file and the index files of the new generation
+    char target_skeleton[1024];
+    next_generation(filenameSkeleteon, target_skeleton);
+    uint64_t merged_row_count = merge_data_file(&delta, data_filename, target_skeleton);
+    int failed = merged_row_count == 0;
+
+    // Step 3: readers and appenders move to the new generation
+    if (!failed)
+        failed = switch_generation(metadata_filename, delta_filename, &delta.header, target_skeleton, merged_row_count);
+    clock_t end_m = clock();
+    float seconds_m = (float)(end_m - start_m) / CLOCKS_PER_SEC;
+
+    if (!failed)
+    {
+        printf("Merged %lu delta rows (%lu runs) into %s.data: %lu rows (was %lu)\n", delta.header.number_of_rows,
+               delta.header.number_of_runs, target_skeleton, merged_row_count, row_count);
+        printf("The files of %s can be removed once no reader uses them\n", filenameSkeleteon);
+    }
+    printf("Time Taken to merge the delta segment: %f \n", seconds_m);
+
+    delta_index_free(&delta);
+    munmap(mapping, file_stat.st_size);
+    free(data_filename);
+    free(delta_filename);
+    return failed ? EXIT_FAILURE : 0;
+}
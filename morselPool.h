@@ -0,0 +1,160 @@
+#ifndef MORSEL_POOL_H
+#define MORSEL_POOL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "threadPool.h"
+
+/**
+ * Work-stealing pool for the scan of ONE query over a range of blocks (morsel-driven parallelism)
+ *
+ * morsel_pool_run splits the blocks [first_block, end_block) in morsels of morsel_size blocks and gives
+ * every thread (the caller is thread 0, the others are the workers of a thread pool, threadPool.h) a
+ * contiguous share of them, so a thread scans neighbouring blocks. A thread takes the morsels of its share
+ * from the front; once it is empty it steals from the back of the shares of the other threads, so a thread
+ * held up by page faults or by a busier core does not hold the query back. A share is one 64-bit word (its
+ * next and end morsel), both ends move by compare-and-swap. Every thread adds up the results of its
+ * morsels, the partial results are added up once every morsel is done.
+ */
+typedef uint64_t (*morsel_function)(void *argument, size_t first_block, size_t end_block);
+
+#define MORSEL_NONE UINT64_MAX
+
+struct morsel_share
+{
+    uint64_t range;                     // next morsel (low 32 bits) and end morsel (high 32 bits)
+    uint64_t partial;                   // sum of the results of the morsels run by this thread
+    uint64_t steals;                    // morsels this thread took from other shares
+} __attribute__((aligned(64)));         // one cache line per thread
+
+struct morsel_pool
+{
+    int number_of_threads;              // including the caller
+    struct thread_pool workers;         // the threads 1 to number_of_threads - 1
+    struct morsel_share *shares;
+
+    // the current scan
+    morsel_function function;
+    void *argument;
+    size_t first_block;
+    size_t end_block;
+    size_t morsel_size;
+};
+
+// Take the morsel at the front (owner) or at the back (thief) of a share, MORSEL_NONE if it is empty
+static inline uint64_t morsel_take(struct morsel_share *share, int from_back)
+{
+    uint64_t range = __atomic_load_n(&share->range, __ATOMIC_RELAXED);
+    while (1)
+    {
+        uint64_t next = range & 0xffffffff, end = range >> 32;
+        if (next >= end)
+            return MORSEL_NONE;
+        uint64_t taken = from_back ? next | (end - 1) << 32 : (next + 1) | end << 32;
+        if (__atomic_compare_exchange_n(&share->range, &range, taken, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return from_back ? end - 1 : next;
+    }
+}
+
+static inline uint64_t morsel_run(struct morsel_pool *pool, uint64_t morsel)
+{
+    size_t first_block = pool->first_block + morsel * pool->morsel_size;
+    size_t end_block = first_block + pool->morsel_size < pool->end_block ? first_block + pool->morsel_size : pool->end_block;
+    return pool->function(pool->argument, first_block, end_block);
+}
+
+// The morsels of thread t: its share, then the ones it steals
+static void morsel_pool_work(struct morsel_pool *pool, int t)
+{
+    struct morsel_share *share = &pool->shares[t];
+    uint64_t partial = 0, steals = 0, morsel;
+    while ((morsel = morsel_take(share, 0)) != MORSEL_NONE)
+        partial += morsel_run(pool, morsel);
+    for (int v = 1; v < pool->number_of_threads; v++)
+    {
+        struct morsel_share *victim = &pool->shares[(t + v) % pool->number_of_threads];
+        while ((morsel = morsel_take(victim, 1)) != MORSEL_NONE)
+        {
+            partial += morsel_run(pool, morsel);
+            steals++;
+        }
+    }
+    share->partial = partial;
+    share->steals = steals;
+}
+
+static void morsel_pool_task(void *argument, int thread)
+{
+    morsel_pool_work(argument, thread);
+}
+
+// Start a pool of number_of_threads threads (the caller and number_of_threads - 1 others); returns 0, -1 on a failure
+static inline int morsel_pool_start(struct morsel_pool *pool, int number_of_threads)
+{
+    memset(pool, 0, sizeof(*pool));
+    number_of_threads = number_of_threads < 1 ? 1 : number_of_threads;
+    pool->shares = aligned_alloc(64, number_of_threads * sizeof(struct morsel_share));
+    if (pool->shares == NULL)
+        return -1;
+    memset(pool->shares, 0, number_of_threads * sizeof(struct morsel_share));
+    if (thread_pool_start(&pool->workers, number_of_threads - 1) != 0)
+    {
+        free(pool->shares);
+        pool->shares = NULL;
+        return -1;
+    }
+    pool->number_of_threads = number_of_threads;
+    return 0;
+}
+
+/**
+ * Run function over the blocks [first_block, end_block) in morsels of morsel_size blocks on every thread
+ * of the pool, returns the sum of the results of the morsels (and the morsels stolen in *steals, if not NULL)
+ */
+static inline uint64_t morsel_pool_run(struct morsel_pool *pool, morsel_function function, void *argument,
+                                       size_t first_block, size_t end_block, size_t morsel_size, uint64_t *steals)
+{
+    if (steals != NULL)
+        *steals = 0;
+    if (end_block <= first_block)
+        return 0;
+    uint64_t number_of_morsels = (end_block - first_block + morsel_size - 1) / morsel_size;
+    int n = pool->number_of_threads;
+
+    pool->function = function;
+    pool->argument = argument;
+    pool->first_block = first_block;
+    pool->end_block = end_block;
+    pool->morsel_size = morsel_size;
+    for (int t = 0; t < n; t++)
+    {
+        uint64_t next = number_of_morsels * t / n, end = number_of_morsels * (t + 1) / n;
+        pool->shares[t].range = next | end << 32;
+    }
+    thread_pool_submit(&pool->workers, morsel_pool_task, pool);
+    morsel_pool_work(pool, 0);
+    thread_pool_wait(&pool->workers);
+
+    uint64_t result = 0, stolen = 0;
+    for (int t = 0; t < n; t++)
+    {
+        result += pool->shares[t].partial;
+        stolen += pool->shares[t].steals;
+    }
+    if (steals != NULL)
+        *steals = stolen;
+    return result;
+}
+
+static inline void morsel_pool_stop(struct morsel_pool *pool)
+{
+    thread_pool_stop(&pool->workers);
+    free(pool->shares);
+    pool->shares = NULL;
+}
+
+#endif
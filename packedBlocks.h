@@ -0,0 +1,278 @@
+#ifndef PACKED_BLOCKS_H
+#define PACKED_BLOCKS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Compressed copy of the data file (the .packed_data file): the same 400-tuple blocks, every column of a
+ * block encoded on its own with the smallest of
+ *   PACKED_FOR:        frame of reference, value - min bit-packed on bit_width bits
+ *   PACKED_DELTA:      for non-decreasing columns (the key, the counters): the first value is min, then the
+ *                      differences between consecutive values, minus the smallest one, bit-packed
+ *   PACKED_DICTIONARY: the sorted distinct values of the block (FOR-packed like a PACKED_FOR column), then the
+ *                      position of every value in them, bit-packed on bit_width bits
+ *
+ * File: struct packed_file_header, number_of_blocks + 1 block offsets (in bytes from the start of the file),
+ * the blocks. A block is col_count times a struct packed_column_header followed by its payload (a multiple
+ * of 8 bytes), so a column is reached by skipping the payloads of the columns before it.
+ *
+ * The range counts run on the packed codes: [from, to] is translated once per block into the codes
+ * it covers (value - min for FOR, dictionary positions for DICTIONARY) and every code is compared to
+ * that range, the values themselves are never rebuilt (DELTA keeps a running sum).
+ */
+#define PACKED_MAGIC 0x4b434f4c42444b50ULL      // "PKDBLOCK"
+#define PACKED_VERSION 1
+#define PACKED_MAX_TUPLES 400           // a column is encoded per block
+#define PACKED_HASH_BITS 10             // hash set of the distinct values of a column: 1024 slots for 400 values
+#define PACKED_HASH_SLOTS (1 << PACKED_HASH_BITS)
+
+enum packed_encoding
+{
+    PACKED_FOR = 0,
+    PACKED_DELTA = 1,
+    PACKED_DICTIONARY = 2
+};
+
+struct packed_file_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t col_count;
+    uint64_t number_of_blocks;
+};
+
+struct packed_column_header
+{
+    uint8_t encoding;
+    uint8_t bit_width;
+    uint16_t reserved;
+    uint32_t payload_size_in_bytes;
+    uint64_t min;
+    uint64_t max;
+    uint64_t base;              // FOR: unused, DELTA: smallest difference, DICTIONARY: number of distinct values
+};
+
+static inline int packed_bits_for(uint64_t value)
+{
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+// Bytes of n codes of bit_width bits, plus one padding word so that a code can always be read from two words
+static inline size_t packed_codes_size(size_t n, int bit_width)
+{
+    return ((n * bit_width + 63) / 64 + 1) * sizeof(uint64_t);
+}
+
+static inline void packed_put_code(uint64_t *words, size_t i, int bit_width, uint64_t code)
+{
+    if (bit_width == 0)
+        return;
+    size_t bit = i * bit_width;
+    words[bit >> 6] |= code << (bit & 63);
+    if ((bit & 63) + bit_width > 64)
+        words[(bit >> 6) + 1] |= code >> (64 - (bit & 63));
+}
+
+// Code i, without a branch on whether it straddles two words
+static inline uint64_t packed_get_code(const uint64_t *words, size_t i, int bit_width, uint64_t mask)
+{
+    size_t bit = i * bit_width;
+    size_t w = bit >> 6, s = bit & 63;
+    return ((words[w] >> s) | ((words[w + 1] << 1) << (63 - s))) & mask;
+}
+
+static inline uint64_t packed_mask(int bit_width)
+{
+    return bit_width >= 64 ? UINT64_MAX : (1ULL << bit_width) - 1;
+}
+
+static int packed_compare_values(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Upper bound of the encoded size of a column of n values
+static inline size_t packed_column_max_size(size_t n)
+{
+    return sizeof(struct packed_column_header) + n * sizeof(uint64_t) + packed_codes_size(n, 64);
+}
+
+/**
+ * Encode n values (n <= PACKED_MAX_TUPLES) of a column into out (at most packed_column_max_size bytes)
+ * Returns the number of bytes written (header and payload)
+ */
+static inline size_t packed_encode_column(const uint64_t *values, size_t n, char *out)
+{
+    struct packed_column_header header;
+    memset(&header, 0, sizeof(header));
+    uint64_t min = UINT64_MAX, max = 0, min_delta = UINT64_MAX, max_delta = 0;
+    int monotonic = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+        if (i > 0)
+        {
+            monotonic &= values[i] >= values[i - 1];
+            uint64_t delta = values[i] - values[i - 1];
+            min_delta = delta < min_delta ? delta : min_delta;
+            max_delta = delta > max_delta ? delta : max_delta;
+        }
+    }
+    header.min = min;
+    header.max = max;
+
+    // Candidate sizes: FOR always works, DELTA for non-decreasing columns, DICTIONARY when the block has few distinct values
+    int for_width = packed_bits_for(max - min);
+    size_t for_size = packed_codes_size(n, for_width);
+    int delta_width = n > 1 ? packed_bits_for(max_delta - min_delta) : 0;
+    size_t delta_size = monotonic && n > 1 ? packed_codes_size(n - 1, delta_width) : SIZE_MAX;
+
+    // The distinct values, through a small hash set, given up as soon as a dictionary cannot be smaller than FOR
+    uint64_t dictionary[n];
+    size_t distinct = 0;
+    int dictionary_too_large = 0;
+    uint16_t slots[PACKED_HASH_SLOTS];          // 1 + position in dictionary, 0 for an empty slot
+    memset(slots, 0, sizeof(slots));
+    for (size_t i = 0; i < n && !dictionary_too_large; i++)
+    {
+        size_t slot = (values[i] * 0x9e3779b97f4a7c15ULL) >> (64 - PACKED_HASH_BITS);
+        while (slots[slot] != 0 && dictionary[slots[slot] - 1] != values[i])
+            slot = (slot + 1) & (PACKED_HASH_SLOTS - 1);
+        if (slots[slot] == 0)
+        {
+            dictionary[distinct++] = values[i];
+            slots[slot] = distinct;
+            dictionary_too_large = distinct * for_width + n * packed_bits_for(distinct - 1) >= n * for_width;
+        }
+    }
+    size_t dictionary_size = SIZE_MAX;
+    int dictionary_width = 0;
+    if (!dictionary_too_large)
+    {
+        qsort(dictionary, distinct, sizeof(uint64_t), packed_compare_values);
+        dictionary_width = packed_bits_for(distinct - 1);
+        dictionary_size = packed_codes_size(distinct, for_width) + packed_codes_size(n, dictionary_width);
+    }
+
+    uint64_t *payload = (uint64_t *)(out + sizeof(header));
+    if (delta_size <= for_size && delta_size <= dictionary_size)
+    {
+        header.encoding = PACKED_DELTA;
+        header.bit_width = delta_width;
+        header.base = min_delta;
+        header.payload_size_in_bytes = delta_size;
+        memset(payload, 0, delta_size);
+        for (size_t i = 1; i < n; i++)
+            packed_put_code(payload, i - 1, delta_width, values[i] - values[i - 1] - min_delta);
+    }
+    else if (dictionary_size < for_size)
+    {
+        header.encoding = PACKED_DICTIONARY;
+        header.bit_width = dictionary_width;
+        header.base = distinct;
+        header.payload_size_in_bytes = dictionary_size;
+        memset(payload, 0, dictionary_size);
+        for (size_t d = 0; d < distinct; d++)
+            packed_put_code(payload, d, for_width, dictionary[d] - min);
+        uint64_t *codes = payload + packed_codes_size(distinct, for_width) / sizeof(uint64_t);
+        for (size_t i = 0; i < n; i++)
+        {
+            // position of the value in the dictionary
+            size_t low = 0, high = distinct - 1;
+            while (low < high)
+            {
+                size_t mid = (low + high) / 2;
+                if (dictionary[mid] < values[i])
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            packed_put_code(codes, i, dictionary_width, low);
+        }
+    }
+    else
+    {
+        header.encoding = PACKED_FOR;
+        header.bit_width = for_width;
+        header.payload_size_in_bytes = for_size;
+        memset(payload, 0, for_size);
+        for (size_t i = 0; i < n; i++)
+            packed_put_code(payload, i, for_width, values[i] - min);
+    }
+
+    memcpy(out, &header, sizeof(header));
+    return sizeof(header) + header.payload_size_in_bytes;
+}
+
+// Header of "column" in a packed block
+static inline const struct packed_column_header *packed_column(const char *block, int column)
+{
+    const char *position = block;
+    for (int c = 0; c < column; c++)
+        position += sizeof(struct packed_column_header) + ((const struct packed_column_header *)position)->payload_size_in_bytes;
+    return (const struct packed_column_header *)position;
+}
+
+// Count of the n codes in [low_code, high_code] (branch-free)
+static inline size_t packed_count_codes(const uint64_t *codes, size_t n, int bit_width, uint64_t low_code, uint64_t high_code)
+{
+    uint64_t mask = packed_mask(bit_width), span = high_code - low_code;
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += packed_get_code(codes, i, bit_width, mask) - low_code <= span;
+    return count;
+}
+
+/**
+ * Count of the n values of a packed column in [from, to], computed on the codes
+ * A column whose [min, max] does not meet [from, to] is rejected, one inside [from, to] counts whole,
+ * before any code is read
+ */
+static inline size_t packed_count_in_range(const struct packed_column_header *header, size_t n, uint64_t from, uint64_t to)
+{
+    if (header->max < from || header->min > to || to < from)
+        return 0;
+    if (from <= header->min && header->max <= to)
+        return n;
+
+    const uint64_t *payload = (const uint64_t *)(header + 1);
+    uint64_t low = from > header->min ? from : header->min;
+    uint64_t high = to < header->max ? to : header->max;
+    if (header->encoding == PACKED_FOR)
+        return packed_count_codes(payload, n, header->bit_width, low - header->min, high - header->min);
+
+    if (header->encoding == PACKED_DICTIONARY)
+    {
+        // [from, to] covers the dictionary positions [first >= low, last <= high], found on the packed dictionary
+        int value_width = packed_bits_for(header->max - header->min);
+        uint64_t value_mask = packed_mask(value_width);
+        size_t distinct = header->base, low_code = 0, high_code = distinct;
+        while (low_code < distinct && packed_get_code(payload, low_code, value_width, value_mask) < low - header->min)
+            low_code++;
+        while (high_code > low_code && packed_get_code(payload, high_code - 1, value_width, value_mask) > high - header->min)
+            high_code--;
+        if (high_code <= low_code)
+            return 0;
+        const uint64_t *codes = payload + packed_codes_size(distinct, value_width) / sizeof(uint64_t);
+        return packed_count_codes(codes, n, header->bit_width, low_code, high_code - 1);
+    }
+
+    // PACKED_DELTA: the running sum of the differences gives the values in order
+    uint64_t mask = packed_mask(header->bit_width), span = high - low;
+    uint64_t value = header->min;
+    size_t count = value - low <= span;
+    for (size_t i = 1; i < n; i++)
+    {
+        value += header->base + packed_get_code(payload, i - 1, header->bit_width, mask);
+        count += value - low <= span;
+    }
+    return count;
+}
+
+#endif
@@ -1,555 +1,3196 @@
-#include <stdio.h>
-#include <stdint.h>
-#include <assert.h>
-#include <unistd.h>
-#include <time.h>
-#include <fcntl.h>
-#include <stdlib.h>
-#include <time.h>
-#include <string.h>
-
-
-// Global variables
-uint64_t row_count = 0;  // Total number of rows in the database
-int col_count = 0;  // Total number of columns in the database
-char filenameSkeleteon[1024];   // the filename skeleton (everything before .)
-
-char *data_filename;            // Data file name (ending in .data)
-char *sparse_index_filename;    // sparse index file name (ending in .sparse_index)
-char *dense_index_filename;     // dense file name (ending in .dense_index)
-
-uint64_t *sparse_index_only_buffer;      // this only stores the key value (used in linear/binary search)
-uint64_t *sparse_index_and_ptr_buffer;   // this stores both the key values and the file offset pointer (used to compute the offset in data file)
-
-uint64_t *dense_index_only_buffer;       // this only stores the key value (used in linear/binary search)
-uint64_t *dense_index_and_ptr_buffer;    // this stores both the key values and the file offset pointer (used to compute the offset in data file)
-
-/**
- * This function returns the total count of keys in the range [from, to]
- * This function READS ONE TUPLE AT A TIME from the file and then checks for the condition (between from and to).
- *
- * The SQL equivalent is:
- *
- * SELECT COUNT(*)
- * FROM table
- * where primary_key_column_value >= from AND primary_key_column_value <= to
- *
- * This function is to query on the primary key column.
- *
- */
-int primary_key_read_by_tuple(uint64_t from, uint64_t to)
-{
-    int match_count = 0;                                          // counter to store the number of matching tuples (in range [from,to])
-
-    size_t tuple_size_in_bytes = sizeof(uint64_t) * col_count;       // size of a tuple in bytes
-    uint64_t *tuple_data = malloc(tuple_size_in_bytes);           // allocating buffer for one tuple
-
-    int fd = open(data_filename, O_RDONLY);                       // opening the data file
-    off_t file_offset = 0;                                          // offset in file (where to read)
-    for (int i = 0; i < row_count; i++)
-    {
-        pread(fd, tuple_data, tuple_size_in_bytes, file_offset);
-        file_offset = file_offset + tuple_size_in_bytes;
-
-        // This can be done only for primary key
-        if (tuple_data[0] > to)
-            break;
-        
-        // increase the counter if key is in the range
-        if (tuple_data[0] >= from && tuple_data[0] <= to)
-            match_count++;
-    }
-    close(fd);
-    free(tuple_data);
-
-    return match_count;
-}
-
-/**
- * TODO - Task 2 - implement this function
- * This function returns the total count of keys in the range [from, to]
- * This function READS ONE BLOCK AT A TIME from the file and then SCANS through the TUPLES in the block to check if a tuple satisfies the condition (between from and to).
- *
- * The SQL equivalent is:
- *
- * SELECT COUNT(*)
- * FROM table
- * where primary_key_column_value >= from AND primary_key_column_value <= to
- *
- * This function is to query on the primary key column.
- *
- */
-int primary_key_read_by_block(uint64_t from, uint64_t to, int number_of_tuples_per_block)
-{
-    int match_count = 0;  // counter to store the number of matching tuples (in range [from, to])
-
-    // Step 1: Allocate block buffer to read data from file
-    size_t block_size_in_number_of_items = col_count * number_of_tuples_per_block;
-    size_t block_size_in_bytes = block_size_in_number_of_items * sizeof(uint64_t);
-    size_t total_number_of_blocks_in_file = (row_count * col_count) / block_size_in_number_of_items;
-    uint64_t *block_data = malloc(block_size_in_bytes);
-
-    // Step 2: read data from file, one block at a time
-    int fd = open(data_filename, O_RDONLY);
-    if (fd == -1)
-    {
-        perror("Error opening data file");
-        free(block_data);
-        exit(EXIT_FAILURE);
-    }
-
-    off_t file_offset = 0;
-    for (int block_index = 0; block_index < total_number_of_blocks_in_file; block_index++)
-    {
-        pread(fd, block_data, block_size_in_bytes, file_offset);
-        file_offset = file_offset + block_size_in_bytes;
-
-        // Step 3: Iterate through all the tuples in the block
-        //        Check if a tuple is in the range [from, to]
-        //        You can skip scanning the block if the first element of the block is greater than "to" of the range
-        for (int i = 0; i < number_of_tuples_per_block; i++)
-        {
-            if (block_data[i * col_count] > to)
-                break;  // exit the inner loop if the first element of the tuple is greater than "to"
-
-            // Check if the tuple is in the range [from, to]
-            if (block_data[i * col_count] >= from && block_data[i * col_count] <= to)
-                match_count++;
-        }
-    }
-
-    // Step 4: close the file and free the block buffer
-    close(fd);
-    free(block_data);
-
-    return match_count;
-}
-
-/**
- * This function is used to load the DENSE INDEX from disk to memory
- * Once the index file is loaded it can be used to make fast queries
- *
- */
-void load_dense_index_file()
-{
-    // Create dense index buffer (the size of this buffer is total number of rows x 2)
-    dense_index_and_ptr_buffer = malloc(row_count * 2 * sizeof(uint64_t));
-
-    // Open the dense index file
-    int indf = open(dense_index_filename, O_RDONLY);
-    
-    // Read data from index file
-    read(indf, dense_index_and_ptr_buffer, row_count * 2 * sizeof(uint64_t));
-    
-    // close index file
-    close(indf);
-
-    // This is to make our life easier,
-    // dense_index_and_ptr_buffer has both keys and the file pointers
-    // However, we need to perform search on only the keys
-    // therefore, we are making a buffer with just the keys
-    // and so, its size is row_count
-    // We will perform search (linear or binary) directly in this array
-    // and cross reference in the dense_index_and_ptr_buffer to find the location (pointer) of a key
-    dense_index_only_buffer = malloc(row_count * sizeof(uint64_t));
-    for (int i=0; i < row_count; i++)
-        dense_index_only_buffer[i] = dense_index_and_ptr_buffer[i * 2];
-}
-
-// Free both dense index buffers
-void unload_dense_index_file()
-{
-    free(dense_index_and_ptr_buffer);
-    free(dense_index_only_buffer);
-}
-
-// Linear search to find the the key in the index file
-// Note, the key might not exist in the index file, in that case
-// you need to find the key closest (from left size) to the search key
-int linearSearch(int arr[], int value)
-{
-    for (int i=0; i < row_count; i++)
-    {
-        if (arr[i] >= value)
-            return i;
-    }
-
-    // key-value is greater than all keys in the table in that case return the last key of the index file
-    return row_count-1;
-}
-
-/**
- * TODO - Task 4 - Binary search to accomplish the same task as linear search
- */
-uint64_t binarySearch(uint64_t arr[], uint64_t value, uint64_t low, uint64_t high) {
-    if (value < arr[0]) {
-        return UINT64_MAX; // No keys less than 'value'
-    }
-
-    uint64_t result = 0; // Default to the first element if not found
-
-    while (low <= high) {
-        uint64_t mid = low + (high - low) / 2;
-
-        if (arr[mid] == value) 
-            return mid;
-
-        if (arr[mid] < value) {
-            result = mid; // Store the closest smaller value
-            low = mid + 1;
-        } else {
-            high = mid - 1;
-        }
-    }
-
-    return result; // Return the index of closest smaller value
-}
-
-
-
-/**
- * TODO - Task 3 - implement this file
- * This function returns the total count of keys in the range [from, to]
- * This function uses the DENSE INDEX FILE (which has been loaded in the memory)
- * The DENSE INDEX FILE is used to find the file pointer for from and to
- * Since the index file is built on the clustering index, we compute the from and to block id
- * and then we directly read the right data block from the disk and scan
- * one tuple at a time from the block and then checks for the condition (between from and to).
- *
- * The SQL equivalent is:
- *
- * SELECT COUNT(*)
- * FROM table
- * where primary_key_column_value >= from AND primary_key_column_value <= to
- *
- * This function is to query on the primary key column.
- *
- */
-int primary_key_read_by_dense_index_file(uint64_t from, uint64_t to, int number_of_tuples_per_block)
-{
-    // Step 1: Look the dense buffer is loaded in memory; find the index corresponding to "from" (using linear/binary search, as the index is already sorted)
-    uint64_t from_key = binarySearch(dense_index_only_buffer, from, 0, row_count - 1);
-
-    // Step 2: Look the dense buffer is loaded in memory; find the index corresponding to "to" (using linear/binary search, as the index is already sorted)
-    uint64_t to_key = binarySearch(dense_index_only_buffer, to, 0, row_count - 1);
-
-    // Step 3: Since data is sorted based on the primary key, we can make reads in block (instead of tuples)
-    // Assuming that each block is composed of "number_of_tuples_per_block" rows
-    // Compute the index of the starting block and ending block in the data file
-    size_t block_size_in_number_of_items = col_count * number_of_tuples_per_block; // Every block is composed of number_of_tuples_per_block rows
-    size_t block_size_in_bytes = block_size_in_number_of_items * sizeof(uint64_t);
-    int from_block_index = (dense_index_and_ptr_buffer[from_key * 2 + 1]) / block_size_in_number_of_items;
-    int to_block_index = (dense_index_and_ptr_buffer[to_key * 2 + 1]) / block_size_in_number_of_items;
-
-
-    // Step 4: Allocate buffer for a block
-    uint64_t *block_data = malloc(block_size_in_bytes);
-
-    // Step 5: open datafile
-    int fd = open(data_filename, O_RDONLY);
-    off_t block_offset = from_block_index * block_size_in_bytes;
-    int match_count = 0;
-
-    // Step 6: Iterate through only those blocks that might contain data in the queried range (starting from from_block_index)
-    for (int block_index = from_block_index; block_index <= to_block_index; block_index++)
-    {
-        pread(fd, block_data, block_size_in_bytes, block_offset);
-        block_offset += block_size_in_bytes;
-
-        // Iterate through the tuples in the block to check which ones match the SQL WHERE criterion
-        for (int i = 0; i < number_of_tuples_per_block; i++)
-        {
-            if (block_data[i * col_count] > to)
-                break; // exit the inner loop if the first element of the tuple is greater than "to"
-
-            // Check if the tuple is in the range [from, to]
-            if (block_data[i * col_count] >= from && block_data[i * col_count] <= to)
-                match_count++;
-        }
-    }
-
-    // Step 7: free block buffer
-    free(block_data);
-
-    return match_count;
-}
-
-
-/**
- * TODO - Task 5 - Implement this function
- * This function is used to load the SPARSE INDEX from disk
- * Once the index file is loaded it can be used to make fast queries
- */
-void load_sparse_index_file()
-{
-    // Step 1: Open the sparse index file
-    int indf = open(sparse_index_filename, O_RDONLY);
-    if (indf == -1) {
-        perror("Error opening sparse index file");
-        exit(EXIT_FAILURE);
-    }
-
-    // Calculate actual sparse index size
-    size_t sparse_index_entries = (row_count / 10) + (row_count % 10 != 0);
-    size_t sparse_index_size = sparse_index_entries * 2 * sizeof(uint64_t);
-
-    // Step 2: Allocate sparse_index_and_ptr_buffer with correct size
-    sparse_index_and_ptr_buffer = malloc(sparse_index_size);
-    if (sparse_index_and_ptr_buffer == NULL) {
-        perror("Memory allocation error for sparse_index_and_ptr_buffer");
-        close(indf);
-        exit(EXIT_FAILURE);
-    }
-
-    // Step 3: Read data from sparse_index_filename into sparse_index_and_ptr_buffer
-    ssize_t bytes_read = read(indf, sparse_index_and_ptr_buffer, sparse_index_size);
-    if (bytes_read == -1) {
-        perror("Error reading from sparse index file");
-        free(sparse_index_and_ptr_buffer);
-        close(indf);
-        exit(EXIT_FAILURE);
-    }
-
-    // Step 4: Close the file
-    close(indf);
-
-    // Step 5: Allocate sparse_index_only_buffer buffer
-    sparse_index_only_buffer = malloc(sparse_index_entries * sizeof(uint64_t));
-    if (sparse_index_only_buffer == NULL) {
-        perror("Memory allocation error for sparse_index_only_buffer");
-        free(sparse_index_and_ptr_buffer);
-        exit(EXIT_FAILURE);
-    }
-
-    // Step 6: Copy just the attribute (column) value from sparse_index_and_ptr_buffer to sparse_index_only_buffer
-    for (size_t i = 0; i < sparse_index_entries; i++) {
-        sparse_index_only_buffer[i] = sparse_index_and_ptr_buffer[i * 2];
-    }
-}
-
-// Uncomment the following function in Task 7
-void unload_sparse_index_file()
-{
-    free(sparse_index_and_ptr_buffer);
-    free(sparse_index_only_buffer);
-}
-
-
-/**
- * TODO - Task 6 - Implement this function
- * This function returns the total count of keys in the range [from, to]
- * This function uses the SPARSE INDEX FILE (which has been loaded in the memory)
- * The SPARSE INDEX FILE is used to find the file pointer for from and to
- * Since the index file is built on the clustering index, we compute the from and to block id
- * and then we directly read the right data block from the disk and scan
- * one tuple at a time from the block and then checks for the condition (between from and to).
- *
- * The SQL equivalent is:
- *
- * SELECT COUNT(*)
- * FROM table
- * where primary_key_column_value >= from AND primary_key_column_value <= to
- *
- * This function is to query on the primary key column.
- *
- */
-int primary_key_read_by_sparse_index_file(uint64_t from, uint64_t to) {
-    size_t sparse_index_entries = (row_count / 10) + (row_count % 10 != 0);
-    size_t block_size_in_number_of_items = col_count * 400; 
-    size_t block_size_in_bytes = block_size_in_number_of_items * sizeof(uint64_t);
-
-    uint64_t *block_data = malloc(block_size_in_bytes);
-    if (block_data == NULL) {
-        perror("Memory allocation error for block_data");
-        exit(EXIT_FAILURE);
-    }
-
-    int fd = open(data_filename, O_RDONLY);
-    if (fd == -1) {
-        perror("Error opening data file");
-        free(block_data);
-        exit(EXIT_FAILURE);
-    }
-
-    int match_count = 0;
-
-    // Search for start and end blocks in the sparse index
-    uint64_t start_block = 0, end_block = sparse_index_entries - 1;
-
-    for (size_t i = 0; i < sparse_index_entries; i++) {
-        if (sparse_index_only_buffer[i] < from && (i == sparse_index_entries - 1 || sparse_index_only_buffer[i + 1] >= from)) {
-            start_block = i;
-        }
-        if (sparse_index_only_buffer[i] <= to && (i == sparse_index_entries - 1 || sparse_index_only_buffer[i + 1] > to)) {
-            end_block = i;
-            break;
-        }
-    }
-
-    // Read blocks from start_block to end_block
-    for (size_t i = start_block; i <= end_block; i++) {
-        off_t block_offset = sparse_index_and_ptr_buffer[i * 2 + 1];
-
-        ssize_t bytes_read = pread(fd, block_data, block_size_in_bytes, block_offset);
-        if (bytes_read == -1) {
-            perror("Error reading from data file");
-            break;
-        }
-
-        for (size_t j = 0; j < block_size_in_number_of_items; j += col_count) {
-            uint64_t key_value = block_data[j];
-            if (key_value >= from && key_value <= to) {
-                match_count++;
-            }
-        }
-    }
-
-    close(fd);
-    free(block_data);
-
-    return match_count;
-}
-
-
-
-// Function to verify the correctness of all four implementation
-void verify_correctness(int number_of_queries, int method1[], int method2[], int method3[], int method4[])
-{
-    for(int q=0; q< number_of_queries; q++)
-         if ( !( (method1[q] == method2[q]) && (method2[q] == method3[q]) && (method3[q] == method4[q]) ) )
-            printf("Error or incomplete implementation\n");
-}
-
-
-void queries_on_primary_key(int number_of_queries, int query_from_range[], int query_to_range[])
-{
-    // Buffer to store the results of all queries for the four different schemes
-    int* tuple_method_result_count = malloc(sizeof(int) * number_of_queries);
-    int* block_method_result_count = malloc(sizeof(int) * number_of_queries);
-    int* dense_index_method_result_count = malloc(sizeof(int) * number_of_queries);
-    int* sparse_index_method_result_count = malloc(sizeof(int) * number_of_queries);
-
-
-    // Queries using one tuple I/O at a time
-    clock_t start_b1 = clock();
-    for (int q = 0; q < number_of_queries; q++)
-    {
-        tuple_method_result_count[q] = primary_key_read_by_tuple(query_from_range[q], query_to_range[q]);
-        printf("[Tuple I/O method] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], tuple_method_result_count[q]);
-    }
-    clock_t end_b1 = clock();
-    float seconds_b1 = (float)(end_b1 - start_b1) / CLOCKS_PER_SEC;
-    printf("\n");
-
-    // Queries using one block I/O at a time
-    clock_t start_b2 = clock();
-    int number_of_tuples_per_block = 400;
-    for (int q = 0; q < number_of_queries; q++)
-    {
-        block_method_result_count[q] = primary_key_read_by_block(query_from_range[q], query_to_range[q], number_of_tuples_per_block);
-        printf("[Block I/O method] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], block_method_result_count[q]);
-    }
-    clock_t end_b2 = clock();
-    float seconds_b2 = (float)(end_b2 - start_b2) / CLOCKS_PER_SEC;
-    printf("\n");
-
-    // load dense index file
-    load_dense_index_file();
-
-    // Queries using dense index file
-    clock_t start_b3 = clock();
-    for (int q = 0; q < number_of_queries; q++)
-    {
-        dense_index_method_result_count[q] = primary_key_read_by_dense_index_file(query_from_range[q], query_to_range[q], number_of_tuples_per_block);
-        printf("[Using Dense Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], dense_index_method_result_count[q]);
-    }
-    clock_t end_b3 = clock();
-    float seconds_b3 = (float)(end_b3 - start_b3) / CLOCKS_PER_SEC;
-    printf("\n");
-
-    // unload dense index file
-    unload_dense_index_file();
-
-    // load sparse index file
-    load_sparse_index_file();
-
-    // Queries using sparse index file
-    clock_t start_b4 = clock();
-    for (int q = 0; q < number_of_queries; q++)
-    {
-        sparse_index_method_result_count[q] = primary_key_read_by_sparse_index_file(query_from_range[q], query_to_range[q]);
-        printf("[Using Sparse Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], sparse_index_method_result_count[q]);
-    }
-    clock_t end_b4 = clock();
-    float seconds_b4 = (float)(end_b4 - start_b4) / CLOCKS_PER_SEC;
-    printf("\n");
-
-    // unload sparse index file
-    unload_sparse_index_file();
-
-    verify_correctness(number_of_queries, tuple_method_result_count, block_method_result_count, dense_index_method_result_count, sparse_index_method_result_count);
-
-    free(tuple_method_result_count);
-    free(block_method_result_count);
-    free(dense_index_method_result_count);
-    free(sparse_index_method_result_count);
-    printf("Time Tuple method %f | Block method (1024) %f | Dense Index method %f | Sparse Index method %f \n", seconds_b1, seconds_b2, seconds_b3, seconds_b4);
-}
-
-
-
-int main(int argc, char *argv[])
-{
-    char *filename = argv[1];
-
-    FILE *fptr;
-    fptr = fopen(filename, "r");
-    fscanf(fptr, "%s\n%ld\n%d", filenameSkeleteon, &row_count, &col_count);
-    fclose(fptr);
-
-    data_filename = malloc(strlen(filenameSkeleteon) + 6);
-    strcpy(data_filename, filenameSkeleteon);
-    strcat(data_filename, ".data");
-
-    sparse_index_filename = malloc(strlen(filenameSkeleteon) + 14);
-    strcpy(sparse_index_filename, filenameSkeleteon);
-    strcat(sparse_index_filename, ".sparse_index");
-
-    dense_index_filename = malloc(strlen(filenameSkeleteon) + 13);
-    strcpy(dense_index_filename, filenameSkeleteon);
-    strcat(dense_index_filename, ".dense_index");
-
-    // ALl queries on the primary key
-    int number_of_queries = 8;
-    int *query_from_range = malloc(sizeof(int) * number_of_queries);
-    int *query_to_range = malloc(sizeof(int) * number_of_queries);
-    
-    query_from_range[0] = 159999000;
-    query_from_range[1] = 19990000;
-    query_from_range[2] = 1599000;
-    query_from_range[3] = 15999990;
-    query_from_range[4] = 129999000;
-    query_from_range[5] = 1999000;
-    query_from_range[6] = 10;
-    query_from_range[7] = 179999000;
-    
-    query_to_range[0] = 160000000;
-    query_to_range[1] = 20000000;
-    query_to_range[2] = 16000000;
-    query_to_range[3] = 16000000;
-    query_to_range[4] = 139000000;
-    query_to_range[5] = 1700000;
-    query_to_range[6] = 50;
-    query_to_range[7] = 180000000;
-
-    // ALl queries on the non-primary key
-    queries_on_primary_key(number_of_queries, query_from_range, query_to_range);
-    
-    free(query_from_range);
-    free(query_to_range);
-    free(data_filename);
-    free(sparse_index_filename);
-    free(dense_index_filename);
-
-    return 0;
+#define _GNU_SOURCE     // O_DIRECT (asyncBlockReader.h)
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <getopt.h>
+
+#include "tableLayout.h"
+#include "rangeCountKernels.h"
+#include "asyncBlockReader.h"
+#include "btreeIndex.h"
+#include "eytzingerIndex.h"
+#include "learnedIndex.h"
+#include "bufferPool.h"
+#include "bitmapIndex.h"
+#include "packedBlocks.h"
+#include "aggregateIndex.h"
+#include "vectorEngine.h"
+#include "keyIndexFile.h"
+#include "deltaSegment.h"
+#include "queryProfile.h"
+#include "levelIndex.h"
+#include "morselPool.h"
+
+
+// Global variables
+uint64_t row_count = 0;  // Total number of rows in the database
+int col_count = 0;  // Total number of columns in the database
+char filenameSkeleteon[1024];   // the filename skeleton (everything before .)
+enum table_layout data_layout = LAYOUT_ROW_MAJOR;   // block layout of the data file (row-major or PAX)
+
+char *data_filename;            // Data file name (ending in .data)
+char *sparse_index_filename;    // sparse index file name (ending in .sparse_index)
+char *dense_index_filename;     // dense file name (ending in .dense_index)
+char *btree_index_filename;     // B+-tree file name (ending in .btree_index)
+char *learned_index_filename;   // learned index file name (ending in .learned_index)
+char *zonemap_filename;         // zone map file name (ending in .zonemap)
+char *bitmap_index_filename;    // bitmap index file name (ending in .bitmap_index)
+char *packed_data_filename;     // compressed copy of the data file (ending in .packed_data)
+char *aggregate_filename;       // per-block aggregates file name (ending in .aggregates)
+char *delta_filename;           // rows appended since the last merge (ending in .delta)
+
+uint64_t *sparse_index_only_buffer;      // the keys of the sparse index (used in linear/binary search)
+struct key_index sparse_key_index;       // the sparse index file: its keys and the file offset pointers (used to compute the offset in data file)
+
+uint64_t *dense_index_only_buffer;       // the keys of the dense index (used in linear/binary search)
+struct key_index dense_key_index;        // the dense index file: its keys and the file offset pointers (used to compute the offset in data file)
+
+/**
+ * Mapping hints of the dense and sparse index files: MAP_POPULATE reads the whole file in when it is
+ * mapped (no page faults during the searches), MADV_HUGEPAGE asks for transparent huge pages (fewer TLB
+ * misses on the binary search; only honoured where the kernel supports them for file mappings)
+ * verify_index_checksums recomputes the checksum of a version 2 file when it is loaded
+ */
+int index_map_populate = 0;
+int index_map_hugepages = 0;
+int verify_index_checksums = 0;
+
+struct btree_index btree_index;         // the B+-tree index: its header and a small cache of its pages
+struct learned_index learned_index;     // the learned index: the segments of its piecewise-linear model
+uint64_t learned_index_probes;          // keys read from the data file by the learned index searches
+struct bitmap_index bitmap_index;       // the bitmap index on columns 2, 3 and 4 (mapped)
+struct delta_index delta_index;         // the delta rows in key order (empty without a delta segment)
+uint64_t packed_bytes_read;             // bytes of packed blocks (column headers and codes) read by the packed methods
+uint64_t aggregate_tuples_read;         // tuples read from the data file by the aggregate methods
+
+/**
+ * EXPLAIN ANALYZE (-e): the access paths add what they do to query_profile (queryProfile.h), and with -e
+ * every primary key query prints its record; -e perf also reads the CPU's hardware counters around it
+ */
+int explain_analyze = 0;
+int explain_hardware_counters = 0;
+struct query_profile query_profile;
+struct hardware_counters hardware_counters;
+
+/**
+ * How the dense and sparse index methods search their keys: binary search over the sorted keys
+ * (through the levels above the sparse keys for the sparse index, levelIndex.h), or the Eytzinger layout
+ * of the same keys built at load time
+ */
+enum key_search
+{
+    KEY_SEARCH_BINARY = 0,
+    KEY_SEARCH_EYTZINGER = 1
+};
+
+enum key_search key_search = KEY_SEARCH_BINARY;
+struct eytzinger_index dense_eytzinger_index;
+struct eytzinger_index sparse_eytzinger_index;
+struct level_index sparse_level_index;
+
+/**
+ * The data file and both index files are mapped into memory once per process (see open_table)
+ * Every query method below runs directly over the mapped pages: there is no per-query
+ * open/close, no block buffer to malloc and no copy out of the page cache
+ */
+struct table_handle
+{
+    uint64_t *data;                     // mapping of the data file (row-major tuples)
+    size_t data_size_in_bytes;
+    uint64_t *dense_index;              // mapping of the dense index file (keyIndexFile.h)
+    size_t dense_index_size_in_bytes;
+    uint64_t *sparse_index;             // mapping of the sparse index file (keyIndexFile.h)
+    size_t sparse_index_size_in_bytes;
+    uint64_t *zonemap;                  // mapping of the zone map file ((min, max) of every column of every block), if any
+    size_t zonemap_size_in_bytes;
+    uint64_t *packed_data;              // mapping of the packed copy of the data file, if any
+    size_t packed_data_size_in_bytes;
+    uint64_t *aggregates;               // mapping of the aggregates file (prefix sums and min/max trees of the blocks), if any
+    size_t aggregates_size_in_bytes;
+    uint64_t *delta;                    // mapping of the delta segment (the rows appended since the last merge), if any
+    size_t delta_size_in_bytes;
+};
+
+struct table_handle table;
+
+/**
+ * How the block, dense index and sparse index methods get their blocks:
+ * BLOCK_IO_MMAP reads the mapped pages directly, BLOCK_IO_ASYNC goes through the asynchronous
+ * block reader, which keeps block_reader_queue_depth reads in flight ahead of the scan,
+ * BLOCK_IO_BUFFER_POOL pins every block in the buffer pool, which keeps blocks across queries
+ * within buffer_pool_budget_in_bytes
+ */
+enum block_io_mode
+{
+    BLOCK_IO_MMAP = 0,
+    BLOCK_IO_ASYNC = 1,
+    BLOCK_IO_BUFFER_POOL = 2
+};
+
+enum block_io_mode block_io_mode = BLOCK_IO_MMAP;
+enum block_reader_backend block_reader_backend = BLOCK_READER_IO_URING;
+int block_reader_queue_depth = 8;
+int block_reader_direct = 0;    // the asynchronous reader opens the data file with O_DIRECT (-r direct)
+struct block_reader block_reader;
+size_t buffer_pool_budget_in_bytes = 64 << 20;
+struct buffer_pool buffer_pool;
+int data_fd = -1;               // the data file, read by the buffer pool
+size_t data_block_read_size;    // bytes of a block the asynchronous reader and the buffer pool read
+struct data_file_geometry data_geometry;    // where the blocks are in the data file (its header)
+uint64_t reported_hits, reported_misses;    // buffer pool counters at the last report
+
+/**
+ * Intra-query parallelism (-p): with the mapped data file, the blocks of a wide scan (the block method,
+ * the blocks picked by the dense index and B+-tree methods, the full scan of a column) are split in
+ * morsels of MORSEL_BLOCKS blocks and counted by the threads of the morsel pool (morselPool.h), every
+ * thread adding up its own count. The asynchronous reader and the buffer pool serve one scan at a time,
+ * so with -r io_uring, threads, direct or pool the scans stay on one thread.
+ */
+#define MORSEL_BLOCKS 16        // 6400 tuples per morsel
+int scan_threads = 1;
+struct morsel_pool morsel_pool;
+uint64_t parallel_scans, morsels_stolen;    // scans run on the morsel pool, morsels stolen by their threads
+
+// Map a whole file read-only with extra mmap flags, the mapping stays valid after the descriptor is closed
+uint64_t *map_file_with_flags(const char *filename, size_t *size_in_bytes, int flags)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        perror(filename);
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1)
+    {
+        perror("Error reading file size");
+        close(fd);
+        exit(EXIT_FAILURE);
+    }
+
+    *size_in_bytes = file_stat.st_size;
+    if (*size_in_bytes == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, *size_in_bytes, PROT_READ, MAP_SHARED | flags, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Error mapping file");
+        exit(EXIT_FAILURE);
+    }
+    return mapping;
+}
+
+uint64_t *map_file(const char *filename, size_t *size_in_bytes)
+{
+    return map_file_with_flags(filename, size_in_bytes, 0);
+}
+
+// Map the dense or sparse index file with the mapping hints
+uint64_t *map_index_file(const char *filename, size_t *size_in_bytes)
+{
+    uint64_t *mapping = map_file_with_flags(filename, size_in_bytes, index_map_populate ? MAP_POPULATE : 0);
+#ifdef MADV_HUGEPAGE
+    if (mapping != NULL && index_map_hugepages)
+        madvise(mapping, *size_in_bytes, MADV_HUGEPAGE);
+#endif
+    return mapping;
+}
+
+void unmap_file(uint64_t *mapping, size_t size_in_bytes)
+{
+    if (mapping != NULL)
+        munmap(mapping, size_in_bytes);
+}
+
+// Map the data file and both index files, this is done once before running any query
+void open_table()
+{
+    table.data = map_file(data_filename, &table.data_size_in_bytes);
+    int fd = open(data_filename, O_RDONLY);
+    if (fd == -1 || read_data_file_geometry(fd, data_layout, col_count, &data_geometry) != 0)
+    {
+        fprintf(stderr, "The header of %s does not match its metadata\n", data_filename);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    table.dense_index = map_index_file(dense_index_filename, &table.dense_index_size_in_bytes);
+    table.sparse_index = map_index_file(sparse_index_filename, &table.sparse_index_size_in_bytes);
+
+    // In PAX the keys are the first minipage of every block, the reader and the pool only fetch those
+    data_block_read_size = data_layout == LAYOUT_PAX ? TUPLES_PER_BLOCK * sizeof(uint64_t) : block_payload_in_bytes(col_count);
+    if (block_io_mode == BLOCK_IO_ASYNC)
+        block_reader_open(&block_reader, data_filename, block_offset_in_bytes(&data_geometry, 0), block_stride_in_bytes(&data_geometry),
+                          data_block_read_size, block_reader_queue_depth, block_reader_backend, block_reader_direct);
+    if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+    {
+        data_fd = open(data_filename, O_RDONLY);
+        if (data_fd == -1)
+        {
+            perror(data_filename);
+            exit(EXIT_FAILURE);
+        }
+        buffer_pool_init(&buffer_pool, data_block_read_size, buffer_pool_budget_in_bytes);
+    }
+}
+
+void close_table()
+{
+    if (block_io_mode == BLOCK_IO_ASYNC)
+        block_reader_close(&block_reader);
+    if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+    {
+        buffer_pool_free(&buffer_pool);
+        close(data_fd);
+    }
+
+    unmap_file(table.data, table.data_size_in_bytes);
+    unmap_file(table.dense_index, table.dense_index_size_in_bytes);
+    unmap_file(table.sparse_index, table.sparse_index_size_in_bytes);
+    unmap_file(table.zonemap, table.zonemap_size_in_bytes);
+    unmap_file(table.packed_data, table.packed_data_size_in_bytes);
+    unmap_file(table.aggregates, table.aggregates_size_in_bytes);
+    unmap_file(table.delta, table.delta_size_in_bytes);
+    delta_index_free(&delta_index);
+}
+
+// Access hints for the full scans (tuple and block methods): the whole data file is read front to back,
+// so ask the kernel for aggressive readahead and to drop pages behind the scan.
+// In PAX only the key minipage of every block is touched, and readahead would page in all the other columns
+void advise_full_scan()
+{
+    madvise(table.data, table.data_size_in_bytes, data_layout == LAYOUT_PAX ? MADV_RANDOM : MADV_SEQUENTIAL);
+}
+
+// Access hints for the index methods: the data file is hit at the blocks picked by the index,
+// so plain readahead around every fault only pollutes the page cache
+void advise_index_lookups()
+{
+    madvise(table.data, table.data_size_in_bytes, MADV_RANDOM);
+}
+
+// Prefetch the part of the data file an index lookup has picked (madvise needs a page aligned start)
+void advise_will_need(size_t offset_in_bytes, size_t length_in_bytes)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset_in_bytes & ~(page_size - 1);
+    if (aligned_offset >= table.data_size_in_bytes)
+        return;
+    if (offset_in_bytes + length_in_bytes > table.data_size_in_bytes)
+        length_in_bytes = table.data_size_in_bytes - offset_in_bytes;
+    madvise((char *)table.data + aligned_offset, length_in_bytes + (offset_in_bytes - aligned_offset), MADV_WILLNEED);
+    query_profile.syscalls++;
+}
+
+// Prefetch the keys of the blocks [from_block_index, to_block_index] an index lookup has picked:
+// the whole range in row-major order, only the key minipage of every block in PAX
+void advise_will_need_keys(size_t from_block_index, size_t to_block_index)
+{
+    if (data_layout == LAYOUT_PAX)
+    {
+        for (size_t block_index = from_block_index; block_index <= to_block_index; block_index++)
+            advise_will_need(block_offset_in_bytes(&data_geometry, block_index), TUPLES_PER_BLOCK * sizeof(uint64_t));
+    }
+    else
+        advise_will_need(block_offset_in_bytes(&data_geometry, from_block_index),
+                         block_offset_in_bytes(&data_geometry, to_block_index + 1) - block_offset_in_bytes(&data_geometry, from_block_index));
+}
+
+// Count the keys in [from, to] of "n" consecutive tuples of a block, block_keys is the key of the first one
+// (row-major keys go to the strided kernel, a PAX key minipage to the contiguous one)
+size_t count_block_keys_in_range(const uint64_t *block_keys, size_t n, uint64_t from, uint64_t to)
+{
+    size_t stride = key_stride(data_layout, col_count);
+    uint64_t started = profile_clock();
+    size_t match_count = stride == 1 ? range_count->count_contiguous(block_keys, n, from, to) : range_count->count_strided(block_keys, n, stride, from, to);
+    query_profile.compute_ns += profile_clock() - started;
+    query_profile.tuples_examined += n;
+    return match_count;
+}
+
+// A scan of a column over blocks of the mapped data file, shared by the threads of the morsel pool
+struct parallel_scan
+{
+    int column;                 // 0 for the keys
+    uint64_t from;
+    uint64_t to;
+    uint64_t end_tuple;         // the tuples from end_tuple on are not counted
+    int stop_above_to;          // the keys are sorted: no block from the first one starting above "to" on matches
+    uint64_t blocks_visited;    // added up by the threads (atomic), for the EXPLAIN ANALYZE records
+    uint64_t tuples_examined;
+};
+
+// Count the values in [from, to] of a morsel, blocks [first_block, end_block) (runs on any thread of the pool)
+uint64_t count_morsel(void *argument, size_t first_block, size_t end_block)
+{
+    struct parallel_scan *scan = argument;
+    size_t stride = key_stride(data_layout, col_count);
+    uint64_t match_count = 0, tuples_examined = 0;
+    size_t b;
+    for (b = first_block; b < end_block; b++)
+    {
+        const uint64_t *values = table.data + item_in_file(&data_geometry, b * TUPLES_PER_BLOCK, scan->column);
+        if (scan->stop_above_to && values[0] > scan->to)
+            break;
+        size_t n = scan->end_tuple - b * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? scan->end_tuple - b * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+        match_count += stride == 1 ? range_count->count_contiguous(values, n, scan->from, scan->to)
+                                   : range_count->count_strided(values, n, stride, scan->from, scan->to);
+        tuples_examined += n;
+    }
+    __atomic_fetch_add(&scan->blocks_visited, b - first_block, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&scan->tuples_examined, tuples_examined, __ATOMIC_RELAXED);
+    return match_count;
+}
+
+// Whether the blocks of a scan are split in morsels on the pool: mapped data file, at least two morsels
+int parallel_scan_possible(size_t number_of_blocks)
+{
+    return scan_threads > 1 && block_io_mode == BLOCK_IO_MMAP && number_of_blocks >= 2 * MORSEL_BLOCKS;
+}
+
+// Count the values in [from, to] of "column" in the blocks [first_block, end_block) on the morsel pool
+uint64_t parallel_count(int column, size_t first_block, size_t end_block, uint64_t from, uint64_t to, uint64_t end_tuple, int stop_above_to)
+{
+    struct parallel_scan scan = {column, from, to, end_tuple, stop_above_to, 0, 0};
+    uint64_t started = profile_clock(), steals;
+    uint64_t match_count = morsel_pool_run(&morsel_pool, count_morsel, &scan, first_block, end_block, MORSEL_BLOCKS, &steals);
+    query_profile.compute_ns += profile_clock() - started;
+    query_profile.blocks_touched += scan.blocks_visited;
+    query_profile.tuples_examined += scan.tuples_examined;
+    query_profile.bytes_read += scan.blocks_visited * data_block_read_size;
+    parallel_scans++;
+    morsels_stolen += steals;
+    return match_count;
+}
+
+/**
+ * Scan over the blocks [first_block, last_block] of the data file, in order:
+ *
+ *     block_scan_begin(&scan, first_block, last_block);
+ *     while ((block_data = block_scan_next(&scan)) != NULL) ...
+ *     block_scan_end(&scan);
+ *
+ * With the mapping, a block is a pointer into the mapped pages; with the asynchronous reader it is
+ * the reader's buffer (valid until the next call) and the following reads are already in flight;
+ * with the buffer pool it is a frame, pinned until the next call.
+ * A scan may stop early, block_scan_end waits for the reads still in flight.
+ */
+struct block_scan
+{
+    size_t next_block;
+    size_t last_block;
+    uint32_t pinned_frame;      // buffer pool frame of the current block
+};
+
+void block_scan_begin(struct block_scan *scan, size_t first_block, size_t last_block)
+{
+    scan->next_block = first_block;
+    scan->last_block = last_block;
+    scan->pinned_frame = BUFFER_POOL_NO_FRAME;
+    if (block_io_mode == BLOCK_IO_ASYNC && first_block <= last_block)
+        block_reader_start(&block_reader, first_block, last_block);
+}
+
+const uint64_t *block_scan_next(struct block_scan *scan)
+{
+    if (scan->next_block > scan->last_block)
+        return NULL;
+    size_t block_index = scan->next_block++;
+    uint64_t started = profile_clock();
+    const uint64_t *block_data;
+    query_profile.blocks_touched++;
+    if (block_io_mode == BLOCK_IO_ASYNC)
+    {
+        block_data = block_reader_next(&block_reader);
+        query_profile.syscalls++;                       // one read per block (a pread, or its share of io_uring_enter)
+        query_profile.bytes_read += data_block_read_size;
+    }
+    else if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+    {
+        uint64_t misses = buffer_pool.misses;
+        buffer_pool_unpin(&buffer_pool, scan->pinned_frame);
+        scan->pinned_frame = buffer_pool_pin(&buffer_pool, data_fd, block_index, block_offset_in_bytes(&data_geometry, block_index), data_block_read_size);
+        block_data = buffer_pool_frame_data(&buffer_pool, scan->pinned_frame);
+        query_profile.syscalls += buffer_pool.misses - misses;      // a miss is one pread
+        query_profile.bytes_read += (buffer_pool.misses - misses) * data_block_read_size;
+    }
+    else
+    {
+        block_data = table.data + block_in_file(&data_geometry, block_index);
+        query_profile.bytes_read += data_block_read_size;
+    }
+    query_profile.io_ns += profile_clock() - started;
+    return block_data;
+}
+
+void block_scan_end(struct block_scan *scan)
+{
+    if (block_io_mode == BLOCK_IO_ASYNC)
+        block_reader_stop(&block_reader);
+    if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+        buffer_pool_unpin(&buffer_pool, scan->pinned_frame);
+    scan->pinned_frame = BUFFER_POOL_NO_FRAME;
+    scan->next_block = scan->last_block + 1;
+}
+
+/**
+ * Count the keys in [from, to] of every block in [from_block_index, to_block_index]:
+ * the scan shared by the index methods once the index has picked the blocks
+ * (the tuples of the last block of the table past row_count are padding and are not counted)
+ */
+int count_keys_in_blocks(size_t from_block_index, size_t to_block_index, uint64_t from, uint64_t to)
+{
+    int match_count = 0;
+    uint64_t end_tuple = (to_block_index + 1) * TUPLES_PER_BLOCK < row_count ? (to_block_index + 1) * TUPLES_PER_BLOCK : row_count;
+
+    // Ask the kernel to start paging in the keys of the blocks we are about to visit
+    // (the asynchronous reader issues its own reads ahead of the scan)
+    if (block_io_mode == BLOCK_IO_MMAP)
+        advise_will_need_keys(from_block_index, to_block_index);
+
+    // A wide range is counted in morsels by the threads of the pool (up to end_tuple, as below)
+    if (parallel_scan_possible(to_block_index - from_block_index + 1))
+        return parallel_count(0, from_block_index, to_block_index + 1, from, to, end_tuple, 0);
+
+    struct block_scan scan;
+    const uint64_t *block_data;
+    size_t block_index = from_block_index;
+    block_scan_begin(&scan, from_block_index, to_block_index);
+    while ((block_data = block_scan_next(&scan)) != NULL)
+    {
+        // Count the tuples in the block that match the SQL WHERE criterion (branch-free kernel)
+        size_t n = end_tuple - block_index * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? end_tuple - block_index * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+        match_count += count_block_keys_in_range(block_data, n, from, to);
+        block_index++;
+    }
+    block_scan_end(&scan);
+
+    return match_count;
+}
+
+/**
+ * This function returns the total count of keys in the range [from, to]
+ * This function VISITS ONE TUPLE AT A TIME in the mapped data file and then checks for the condition (between from and to).
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_tuple(uint64_t from, uint64_t to)
+{
+    int match_count = 0;                                          // counter to store the number of matching tuples (in range [from,to])
+
+    uint64_t started = profile_clock();
+    uint64_t i;
+    for (i = 0; i < row_count; i++)
+    {
+        uint64_t key = table.data[item_in_file(&data_geometry, i, 0)];     // key of the i-th tuple
+
+        // This can be done only for primary key
+        if (key > to)
+            break;
+        
+        // increase the counter if key is in the range
+        if (key >= from && key <= to)
+            match_count++;
+    }
+    uint64_t tuples_examined = i < row_count ? i + 1 : row_count;
+    query_profile.compute_ns += profile_clock() - started;
+    query_profile.tuples_examined += tuples_examined;
+    query_profile.blocks_touched += (tuples_examined + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    query_profile.bytes_read += tuples_examined * key_stride(data_layout, col_count) * sizeof(uint64_t);
+
+    return match_count;
+}
+
+/**
+ * TODO - Task 2 - implement this function
+ * This function returns the total count of keys in the range [from, to]
+ * This function READS ONE BLOCK AT A TIME from the file and then SCANS through the TUPLES in the block to check if a tuple satisfies the condition (between from and to).
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_block(uint64_t from, uint64_t to, int number_of_tuples_per_block)
+{
+    int match_count = 0;  // counter to store the number of matching tuples (in range [from, to])
+
+    // Step 1: Compute the block geometry, blocks are addressed directly in the mapped data file
+    // Only the keys are looked at: col_count items apart in row-major order, the first minipage in PAX
+    // The last block may be partial, only its first row_count - block_index * number_of_tuples_per_block tuples are rows
+    size_t total_number_of_blocks_in_file = (row_count + number_of_tuples_per_block - 1) / number_of_tuples_per_block;
+
+    if (total_number_of_blocks_in_file == 0)
+        return 0;
+
+    // With -p the blocks are split in morsels over the threads, each morsel stops at the first block above "to"
+    if (number_of_tuples_per_block == TUPLES_PER_BLOCK && parallel_scan_possible(total_number_of_blocks_in_file))
+        return parallel_count(0, 0, total_number_of_blocks_in_file, from, to, row_count, 1);
+
+    // Step 2: visit the data file, one block at a time
+    struct block_scan scan;
+    const uint64_t *block_data;
+    size_t block_index = 0;
+    block_scan_begin(&scan, 0, total_number_of_blocks_in_file - 1);
+    while ((block_data = block_scan_next(&scan)) != NULL)
+    {
+        // Step 3: The data is sorted on the key, so once the first element of a block is greater than "to"
+        //        of the range no later block can match either
+        if (block_data[0] > to)
+            break;
+
+        // Step 4: Count the tuples of the block in the range [from, to] with the branch-free kernel
+        size_t n = row_count - block_index * number_of_tuples_per_block;
+        n = n < (size_t)number_of_tuples_per_block ? n : number_of_tuples_per_block;
+        match_count += count_block_keys_in_range(block_data, n, from, to);
+        block_index++;
+    }
+    block_scan_end(&scan);
+
+    return match_count;
+}
+
+// Open the mapping of the dense or sparse index file, exit if it is not an index of the table
+void open_key_index(struct key_index *index, const char *filename, uint64_t *mapping, size_t size_in_bytes, uint64_t entry_stride, uint64_t pointer_unit)
+{
+    // A legacy file is read front to back once (its keys are copied), a version 2 file is only probed
+    madvise(mapping, size_in_bytes, MADV_SEQUENTIAL);
+    if (key_index_open(index, mapping, size_in_bytes, row_count, entry_stride, TUPLES_PER_BLOCK, pointer_unit) != 0)
+    {
+        fprintf(stderr, "Index file %s does not match the table (version, row count or size), run createPrimaryKeyIndexFiles\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    if (verify_index_checksums && index->header.version == KEY_INDEX_VERSION && key_index_checksum(index) != index->header.checksum)
+    {
+        fprintf(stderr, "Index file %s is corrupted (checksum), run createPrimaryKeyIndexFiles\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    madvise(mapping, size_in_bytes, MADV_RANDOM);
+}
+
+void print_key_index(const char *name, const struct key_index *index, float load_seconds)
+{
+    printf("%s index: format version %lu%s, %lu entries, %zu bytes of keys copied, loaded in %f s\n", name, index->header.version,
+           index->header.version == KEY_INDEX_LEGACY_VERSION ? " (legacy)" : "", index->header.number_of_entries,
+           index->legacy_keys == NULL ? 0 : index->header.number_of_entries * sizeof(uint64_t), load_seconds);
+}
+
+/**
+ * This function is used to load the DENSE INDEX from disk to memory
+ * Once the index file is loaded it can be used to make fast queries
+ *
+ * The keys are searched in place in the key section of the mapped file, the pointers are read at the
+ * positions the searches return (a legacy file has its keys copied into a buffer first)
+ */
+void load_dense_index_file()
+{
+    open_key_index(&dense_key_index, dense_index_filename, table.dense_index, table.dense_index_size_in_bytes, 1, KEY_INDEX_POINTER_ITEMS);
+    dense_index_only_buffer = (uint64_t *)dense_key_index.keys;
+    if (key_search == KEY_SEARCH_EYTZINGER)
+        eytzinger_build(&dense_eytzinger_index, dense_index_only_buffer, row_count, 1);
+}
+
+void unload_dense_index_file()
+{
+    dense_index_only_buffer = NULL;
+    key_index_close(&dense_key_index);
+    if (key_search == KEY_SEARCH_EYTZINGER)
+        eytzinger_free(&dense_eytzinger_index);
+}
+
+// Linear search to find the the key in the index file
+// Note, the key might not exist in the index file, in that case
+// you need to find the key closest (from left size) to the search key
+int linearSearch(int arr[], int value)
+{
+    for (int i=0; i < row_count; i++)
+    {
+        if (arr[i] >= value)
+            return i;
+    }
+
+    // key-value is greater than all keys in the table in that case return the last key of the index file
+    return row_count-1;
+}
+
+/**
+ * TODO - Task 4 - Binary search to accomplish the same task as linear search
+ */
+uint64_t binarySearch(uint64_t arr[], uint64_t value, uint64_t low, uint64_t high) {
+    if (value < arr[0]) {
+        profile_search(&query_profile, 1);
+        return UINT64_MAX; // No keys less than 'value'
+    }
+
+    uint64_t result = 0; // Default to the first element if not found
+    uint64_t steps = 1;
+
+    while (low <= high) {
+        uint64_t mid = low + (high - low) / 2;
+        steps++;
+
+        if (arr[mid] == value) {
+            profile_search(&query_profile, steps);
+            return mid;
+        }
+
+        if (arr[mid] < value) {
+            result = mid; // Store the closest smaller value
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    profile_search(&query_profile, steps);
+    return result; // Return the index of closest smaller value
+}
+
+// Keys an Eytzinger search compares: one per level of the tree
+uint64_t eytzinger_search_steps(const struct eytzinger_index *index)
+{
+    return index->n > 0 ? 64 - __builtin_clzll(index->n) : 0;
+}
+
+// Position in the dense index where the scan for keys >= from starts, row_count if every key is smaller
+// (the Eytzinger search finds the first key >= from, so it also lands on the first of duplicate keys)
+uint64_t dense_index_search_from(uint64_t from)
+{
+    if (key_search == KEY_SEARCH_EYTZINGER)
+    {
+        profile_search(&query_profile, eytzinger_search_steps(&dense_eytzinger_index));
+        return eytzinger_lower_bound(&dense_eytzinger_index, from);
+    }
+    uint64_t from_key = binarySearch(dense_index_only_buffer, from, 0, row_count - 1);
+    return from_key == UINT64_MAX ? 0 : from_key;   // "from" is smaller than every key, start at the first tuple
+}
+
+// Position in the dense index of the largest key <= to, UINT64_MAX if "to" is smaller than every key
+uint64_t dense_index_search_to(uint64_t to)
+{
+    if (key_search == KEY_SEARCH_EYTZINGER)
+    {
+        profile_search(&query_profile, eytzinger_search_steps(&dense_eytzinger_index));
+        return eytzinger_floor(&dense_eytzinger_index, to);
+    }
+    return binarySearch(dense_index_only_buffer, to, 0, row_count - 1);
+}
+
+// Position in the dense index of the first key >= value, row_count if every key is smaller
+uint64_t dense_index_lower_bound(uint64_t value)
+{
+    if (key_search == KEY_SEARCH_EYTZINGER)
+    {
+        profile_search(&query_profile, eytzinger_search_steps(&dense_eytzinger_index));
+        return eytzinger_lower_bound(&dense_eytzinger_index, value);
+    }
+    uint64_t low = 0, high = row_count, steps = 0;
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        steps++;
+        if (dense_index_only_buffer[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    profile_search(&query_profile, steps);
+    return low;
+}
+
+
+
+/**
+ * TODO - Task 3 - implement this file
+ * This function returns the total count of keys in the range [from, to]
+ * This function uses the DENSE INDEX FILE (which has been loaded in the memory)
+ * The DENSE INDEX FILE is used to find the file pointer for from and to
+ * Since the index file is built on the clustering index, we compute the from and to block id
+ * and then we directly read the right data block from the disk and scan
+ * one tuple at a time from the block and then checks for the condition (between from and to).
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_dense_index_file(uint64_t from, uint64_t to, int number_of_tuples_per_block)
+{
+    // Step 1: Look the dense buffer is loaded in memory; find the index corresponding to "from" (using linear/binary search, as the index is already sorted)
+    uint64_t started = profile_clock();
+    uint64_t from_key = dense_index_search_from(from);
+    if (from_key == row_count)
+    {
+        query_profile.index_ns += profile_clock() - started;
+        return 0;       // "from" is greater than every key, nothing can match
+    }
+
+    // Step 2: Look the dense buffer is loaded in memory; find the index corresponding to "to" (using linear/binary search, as the index is already sorted)
+    uint64_t to_key = dense_index_search_to(to);
+    query_profile.index_ns += profile_clock() - started;
+    if (to_key == UINT64_MAX)
+        return 0;       // "to" is smaller than every key, nothing can match
+
+    // Step 3: Since data is sorted based on the primary key, we can make reads in block (instead of tuples)
+    // Assuming that each block is composed of "number_of_tuples_per_block" rows
+    // Compute the index of the starting block and ending block in the data file
+    size_t block_size_in_number_of_items = col_count * number_of_tuples_per_block; // Every block is composed of number_of_tuples_per_block rows
+    size_t from_block_index = key_index_pointer(&dense_key_index, from_key) / block_size_in_number_of_items;
+    size_t to_block_index = key_index_pointer(&dense_key_index, to_key) / block_size_in_number_of_items;
+
+    // Step 4: Iterate through only those blocks that might contain data in the queried range (starting from from_block_index)
+    return count_keys_in_blocks(from_block_index, to_block_index, from, to);
+}
+
+/**
+ * This function returns the total count of keys in the range [from, to]
+ * This function ONLY uses the DENSE INDEX FILE: the index has an entry per tuple in key order, so the
+ * count is the position of the first key > to minus the position of the first key >= from,
+ * and no data block is read
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ */
+int primary_key_count_by_dense_index_only(uint64_t from, uint64_t to)
+{
+    if (to < from)
+        return 0;
+    uint64_t started = profile_clock();
+    uint64_t first_tuple = dense_index_lower_bound(from);
+    uint64_t end_tuple = to == UINT64_MAX ? row_count : dense_index_lower_bound(to + 1);
+    query_profile.index_ns += profile_clock() - started;
+    return (int)(end_tuple - first_tuple);
+}
+
+
+/**
+ * Batch execution: all the range counts share one scan (the dense index picks the blocks of every query)
+ *
+ * Every query needs the blocks [first_block, last_block]. The queries are sorted on first_block and the
+ * overlapping (or adjacent) block intervals are merged, so every block any query needs is read once.
+ * A block is then counted for every query whose interval covers it; when the keys of the whole block
+ * are inside a query's range the block adds its number of tuples without running the kernel.
+ */
+struct batch_query
+{
+    uint64_t from;
+    uint64_t to;
+    size_t first_block;
+    size_t last_block;
+    int query;                  // position in the batch, where its count goes
+};
+
+uint64_t batch_blocks_read;      // blocks read by the last batch
+uint64_t batch_block_intervals;  // merged block intervals of the last batch
+uint64_t batch_blocks_requested; // blocks the queries of the last batch would have read one by one
+
+int compare_batch_queries(const void *a, const void *b)
+{
+    const struct batch_query *qa = a, *qb = b;
+    if (qa->first_block != qb->first_block)
+        return qa->first_block < qb->first_block ? -1 : 1;
+    return qa->last_block < qb->last_block ? -1 : qa->last_block > qb->last_block;
+}
+
+// Count the keys of one block for every query of active[0 .. number_of_active)
+void batch_count_block(const uint64_t *block_data, size_t block_index, struct batch_query *active, int number_of_active, int results[])
+{
+    size_t stride = key_stride(data_layout, col_count);
+    size_t n = row_count - block_index * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - block_index * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+    uint64_t first_key = block_data[0];
+    uint64_t last_key = block_data[(n - 1) * stride];
+
+    for (int a = 0; a < number_of_active; a++)
+    {
+        if (active[a].from <= first_key && last_key <= active[a].to)
+            results[active[a].query] += n;      // the keys are sorted: the whole block matches
+        else
+            results[active[a].query] += count_block_keys_in_range(block_data, n, active[a].from, active[a].to);
+    }
+}
+
+/**
+ * This function returns the count of keys in every range [from[q], to[q]] of a batch of queries
+ * Needs the DENSE INDEX FILE loaded in memory
+ *
+ * The SQL equivalent is, for every q:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from[q] AND primary_key_column_value <= to[q]
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+void primary_key_read_batch_by_dense_index_file(int number_of_queries, const int query_from_range[], const int query_to_range[], int results[])
+{
+    size_t block_size_in_number_of_items = col_count * TUPLES_PER_BLOCK;       // the dense index pointers are logical
+    struct batch_query *queries = malloc(number_of_queries * sizeof(struct batch_query));
+    struct batch_query *active = malloc(number_of_queries * sizeof(struct batch_query));
+    if (queries == NULL || active == NULL)
+    {
+        perror("Memory allocation error for the batch queries");
+        exit(EXIT_FAILURE);
+    }
+    batch_blocks_read = batch_block_intervals = batch_blocks_requested = 0;
+
+    // Step 1: the block interval of every query (as in the dense index method), empty queries are dropped
+    int number_of_batch_queries = 0;
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        results[q] = 0;
+        uint64_t from_key = dense_index_search_from(query_from_range[q]);
+        uint64_t to_key = dense_index_search_to(query_to_range[q]);
+        if (from_key == row_count || to_key == UINT64_MAX || query_to_range[q] < query_from_range[q])
+            continue;
+        struct batch_query *query = &queries[number_of_batch_queries++];
+        query->from = query_from_range[q];
+        query->to = query_to_range[q];
+        query->first_block = key_index_pointer(&dense_key_index, from_key) / block_size_in_number_of_items;
+        query->last_block = key_index_pointer(&dense_key_index, to_key) / block_size_in_number_of_items;
+        query->query = q;
+        if (query->last_block < query->first_block)
+            number_of_batch_queries--;
+        else
+            batch_blocks_requested += query->last_block - query->first_block + 1;
+    }
+
+    // Step 2: sort on the first block, so the intervals can be merged in one sweep
+    qsort(queries, number_of_batch_queries, sizeof(struct batch_query), compare_batch_queries);
+
+    // Step 3: scan every merged interval once, the active queries are the ones covering the current block
+    int next_query = 0;
+    while (next_query < number_of_batch_queries)
+    {
+        size_t interval_first_block = queries[next_query].first_block;
+        size_t interval_last_block = queries[next_query].last_block;
+        for (int q = next_query + 1; q < number_of_batch_queries && queries[q].first_block <= interval_last_block + 1; q++)
+            if (queries[q].last_block > interval_last_block)
+                interval_last_block = queries[q].last_block;
+        batch_block_intervals++;
+
+        if (block_io_mode == BLOCK_IO_MMAP)
+            advise_will_need_keys(interval_first_block, interval_last_block);
+
+        int number_of_active = 0;
+        struct block_scan scan;
+        const uint64_t *block_data;
+        size_t block_index = interval_first_block;
+        block_scan_begin(&scan, interval_first_block, interval_last_block);
+        while ((block_data = block_scan_next(&scan)) != NULL)
+        {
+            // queries starting at this block join, queries that ended before it leave
+            while (next_query < number_of_batch_queries && queries[next_query].first_block == block_index)
+                active[number_of_active++] = queries[next_query++];
+            for (int a = 0; a < number_of_active; )
+            {
+                if (active[a].last_block < block_index)
+                    active[a] = active[--number_of_active];
+                else
+                    a++;
+            }
+
+            batch_count_block(block_data, block_index, active, number_of_active, results);
+            batch_blocks_read++;
+            block_index++;
+        }
+        block_scan_end(&scan);
+    }
+
+    free(queries);
+    free(active);
+}
+
+
+/**
+ * TODO - Task 5 - Implement this function
+ * This function is used to load the SPARSE INDEX from disk
+ * Once the index file is loaded it can be used to make fast queries
+ */
+void load_sparse_index_file()
+{
+    // The keys are searched in place in the mapped file (or in a copy for a legacy file)
+    // one entry per 10 tuples unless the index was built with another granularity (createPrimaryKeyIndexFiles -g)
+    uint64_t entry_stride = key_index_file_stride(table.sparse_index, table.sparse_index_size_in_bytes, KEY_INDEX_SPARSE_DEFAULT_STRIDE);
+    open_key_index(&sparse_key_index, sparse_index_filename, table.sparse_index, table.sparse_index_size_in_bytes, entry_stride, KEY_INDEX_POINTER_BYTES);
+    sparse_index_only_buffer = (uint64_t *)sparse_key_index.keys;
+    if (key_search == KEY_SEARCH_EYTZINGER)
+        eytzinger_build(&sparse_eytzinger_index, sparse_index_only_buffer, sparse_key_index.header.number_of_entries, 1);
+    else
+        level_index_build(&sparse_level_index, sparse_index_only_buffer, sparse_key_index.header.number_of_entries);
+}
+
+// Uncomment the following function in Task 7
+void unload_sparse_index_file()
+{
+    sparse_index_only_buffer = NULL;
+    key_index_close(&sparse_key_index);
+    if (key_search == KEY_SEARCH_EYTZINGER)
+        eytzinger_free(&sparse_eytzinger_index);
+    else
+        level_index_free(&sparse_level_index);
+}
+
+
+/**
+ * TODO - Task 6 - Implement this function
+ * This function returns the total count of keys in the range [from, to]
+ * This function uses the SPARSE INDEX FILE (which has been loaded in the memory)
+ * The SPARSE INDEX FILE is used to find the file pointer for from and to
+ * Since the index file is built on the clustering index, the entries bracketing from and to
+ * give the first and last tuple that can match, and only the tuples in between are visited
+ * in the mapped data file and checked for the condition (between from and to).
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_sparse_index_file(uint64_t from, uint64_t to) {
+    size_t sparse_index_entries = sparse_key_index.header.number_of_entries;
+    size_t tuple_size_in_bytes = col_count * sizeof(uint64_t);
+
+    int match_count = 0;
+
+    // Search for the entries bracketing the range in the sparse index:
+    // the last entry with a key below "from" and the first entry with a key above "to"
+    size_t start_entry = 0, end_entry = sparse_index_entries;
+    uint64_t started = profile_clock();
+
+    if (key_search == KEY_SEARCH_EYTZINGER) {
+        profile_search(&query_profile, 2 * eytzinger_search_steps(&sparse_eytzinger_index));
+        uint64_t first_not_below = eytzinger_lower_bound(&sparse_eytzinger_index, from);
+        if (first_not_below > 0)
+            start_entry = first_not_below - 1;
+        uint64_t last_not_above = eytzinger_floor(&sparse_eytzinger_index, to);
+        end_entry = last_not_above == UINT64_MAX ? 0 : last_not_above + 1;
+    }
+    else {
+        // one node of 16 keys per level, from the top level down to the sparse keys
+        profile_search(&query_profile, 2 * sparse_level_index.number_of_levels);
+        uint64_t last_below = level_index_last_below(&sparse_level_index, from, 0);
+        if (last_below != UINT64_MAX)
+            start_entry = last_below;
+        uint64_t last_not_above = level_index_last_below(&sparse_level_index, to, 1);
+        end_entry = last_not_above == UINT64_MAX ? 0 : last_not_above + 1;
+    }
+    query_profile.index_ns += profile_clock() - started;
+
+    // The entries store byte offsets of tuples in the data file
+    size_t start_tuple = key_index_pointer(&sparse_key_index, start_entry) / tuple_size_in_bytes;
+    size_t end_tuple = row_count;
+    if (end_entry < sparse_index_entries)
+        end_tuple = key_index_pointer(&sparse_key_index, end_entry) / tuple_size_in_bytes;
+    if (end_tuple <= start_tuple)
+        return 0;
+
+    size_t from_block_index = start_tuple / TUPLES_PER_BLOCK;
+    size_t to_block_index = (end_tuple - 1) / TUPLES_PER_BLOCK;
+    if (block_io_mode == BLOCK_IO_MMAP)
+        advise_will_need_keys(from_block_index, to_block_index);
+
+    // Count the keys of the tuples from start_tuple up to (not including) end_tuple,
+    // one block (or the part of a block inside the range) per kernel call
+    struct block_scan scan;
+    const uint64_t *block_data;
+    size_t stride = key_stride(data_layout, col_count);
+    size_t i = start_tuple;
+    block_scan_begin(&scan, from_block_index, to_block_index);
+    while ((block_data = block_scan_next(&scan)) != NULL) {
+        size_t tuples_left_in_block = TUPLES_PER_BLOCK - i % TUPLES_PER_BLOCK;
+        size_t n = end_tuple - i < tuples_left_in_block ? end_tuple - i : tuples_left_in_block;
+        match_count += count_block_keys_in_range(block_data + (i % TUPLES_PER_BLOCK) * stride, n, from, to);
+        i += n;
+    }
+    block_scan_end(&scan);
+
+    return match_count;
+}
+
+
+
+/**
+ * This function is used to open the B+-TREE INDEX file
+ * Only the header page is read, the other pages are read on demand by the lookups (through a small page cache)
+ * Returns 0 if the table has no B+-tree index (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_btree_index_file()
+{
+    if (btree_open(&btree_index, btree_index_filename) != 0)
+    {
+        printf("No B+-tree index %s, run createPrimaryKeyIndexFiles to build it\n", btree_index_filename);
+        return 0;
+    }
+    return 1;
+}
+
+void unload_btree_index_file()
+{
+    btree_close(&btree_index);
+}
+
+/**
+ * This function returns the total count of keys in the range [from, to]
+ * This function uses the B+-TREE INDEX FILE: the pointers of from and to are found by descending the tree,
+ * reading one page per level, then the blocks in between are scanned as in the dense index method
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_btree_index_file(uint64_t from, uint64_t to)
+{
+    // Step 1: pointers (in items) of the largest keys <= from and <= to
+    uint64_t started = profile_clock(), page_reads = btree_index.page_reads;
+    uint64_t from_pointer = btree_lookup(&btree_index, from);
+    if (from_pointer == UINT64_MAX)
+        from_pointer = 0;   // "from" is smaller than every key, start at the first tuple
+    uint64_t to_pointer = btree_lookup(&btree_index, to);
+    profile_search(&query_profile, btree_index.header.number_of_levels);       // a page per level and lookup
+    profile_search(&query_profile, btree_index.header.number_of_levels);
+    query_profile.syscalls += btree_index.page_reads - page_reads;              // a page missing from the page cache is one pread
+    query_profile.index_ns += profile_clock() - started;
+    if (to_pointer == UINT64_MAX)
+        return 0;           // "to" is smaller than every key, nothing can match
+
+    // Step 2: scan the blocks holding them and every block in between
+    size_t block_size_in_number_of_items = col_count * TUPLES_PER_BLOCK;
+    return count_keys_in_blocks(from_pointer / block_size_in_number_of_items, to_pointer / block_size_in_number_of_items, from, to);
+}
+
+
+
+/**
+ * This function is used to load the LEARNED INDEX file (a few segments, read whole)
+ * Returns 0 if the table has no learned index (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_learned_index_file()
+{
+    if (learned_open(&learned_index, learned_index_filename) != 0)
+    {
+        printf("No learned index %s, run createPrimaryKeyIndexFiles to build it\n", learned_index_filename);
+        return 0;
+    }
+    learned_index_probes = 0;
+    return 1;
+}
+
+void unload_learned_index_file()
+{
+    learned_close(&learned_index);
+}
+
+static inline uint64_t key_of_tuple(uint64_t tuple_index)
+{
+    learned_index_probes++;
+    if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+    {
+        // the key is in the key minipage (PAX) or the first item of the tuple (row-major) of a pooled block
+        size_t block_index = tuple_index / TUPLES_PER_BLOCK;
+        uint32_t frame = buffer_pool_pin(&buffer_pool, data_fd, block_index, block_offset_in_bytes(&data_geometry, block_index), data_block_read_size);
+        uint64_t key = buffer_pool_frame_data(&buffer_pool, frame)[(tuple_index % TUPLES_PER_BLOCK) * key_stride(data_layout, col_count)];
+        buffer_pool_unpin(&buffer_pool, frame);
+        return key;
+    }
+    return table.data[item_in_file(&data_geometry, tuple_index, 0)];
+}
+
+/**
+ * Position of the first tuple with a key >= value (row_count if there is none)
+ * The model predicts it within error_bound tuples, so the binary search only covers the keys around
+ * the prediction; the window grows exponentially when the key is outside it (e.g. before the first
+ * of many duplicate keys), so the answer is exact whatever the model
+ */
+uint64_t learned_index_search(uint64_t value)
+{
+    uint64_t predicted = learned_predict(&learned_index, value);
+    uint64_t bound = learned_index.header.error_bound + 1;
+
+    // Step 1: the window [low, high] around the prediction
+    uint64_t low = predicted > bound ? predicted - bound : 0;
+    uint64_t high = predicted + bound < row_count ? predicted + bound : row_count;
+
+    // Step 2: grow it until key(low - 1) < value <= key(high)
+    uint64_t step = 2 * bound;
+    while (low > 0 && key_of_tuple(low - 1) >= value)
+    {
+        high = low - 1;
+        low = low > step ? low - step : 0;
+        step *= 2;
+    }
+    while (high < row_count && key_of_tuple(high) < value)
+    {
+        low = high + 1;
+        high = row_count - high > step ? high + step : row_count;
+        step *= 2;
+    }
+
+    // Step 3: binary search inside it
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        if (key_of_tuple(mid) < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/**
+ * This function returns the total count of keys in the range [from, to]
+ * This function uses the LEARNED INDEX FILE: the model predicts the position of the first tuple >= from
+ * and of the first tuple > to, each is fixed by a bounded search of the keys around the prediction,
+ * and since the table is sorted on the key every tuple in between matches
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ * This function is to query on the primary key column.
+ *
+ */
+int primary_key_read_by_learned_index_file(uint64_t from, uint64_t to)
+{
+    if (to < from)
+        return 0;
+    uint64_t started = profile_clock(), probes = learned_index_probes;
+    uint64_t first_tuple = learned_index_search(from);
+    profile_search(&query_profile, learned_index_probes - probes);
+    probes = learned_index_probes;
+    uint64_t end_tuple = to == UINT64_MAX ? row_count : learned_index_search(to + 1);
+    profile_search(&query_profile, learned_index_probes - probes);
+    query_profile.index_ns += profile_clock() - started;
+    return (int)(end_tuple - first_tuple);
+}
+
+
+
+/**
+ * This function is used to map the PACKED DATA file: the blocks of the data file, every column compressed
+ * Returns 0 if the table has no packed copy (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_packed_data_file()
+{
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    if (access(packed_data_filename, R_OK) != 0)
+    {
+        printf("No packed data %s, run createPrimaryKeyIndexFiles to build it\n", packed_data_filename);
+        return 0;
+    }
+    if (table.packed_data == NULL)
+        table.packed_data = map_file(packed_data_filename, &table.packed_data_size_in_bytes);
+    const struct packed_file_header *header = (const struct packed_file_header *)table.packed_data;
+    const uint64_t *block_offsets = table.packed_data + sizeof(*header) / sizeof(uint64_t);
+    if (table.packed_data_size_in_bytes < sizeof(*header) + (number_of_blocks + 1) * sizeof(uint64_t) ||
+        header->magic != PACKED_MAGIC || header->version != PACKED_VERSION || header->row_count != row_count ||
+        header->col_count != (uint64_t)col_count || header->number_of_blocks != number_of_blocks ||
+        block_offsets[number_of_blocks] > table.packed_data_size_in_bytes)
+    {
+        fprintf(stderr, "%s is not a packed copy of this table\n", packed_data_filename);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+static inline const char *packed_block(size_t block_index)
+{
+    const uint64_t *block_offsets = table.packed_data + sizeof(struct packed_file_header) / sizeof(uint64_t);
+    return (const char *)table.packed_data + block_offsets[block_index];
+}
+
+// Count the values of "column" in [from, to] in a packed block, on its codes
+size_t count_packed_column_in_range(size_t block_index, int column, uint64_t from, uint64_t to)
+{
+    size_t n = row_count - block_index * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - block_index * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+    const struct packed_column_header *header = packed_column(packed_block(block_index), column);
+
+    // the headers up to the column's are read, its codes only if [min, max] neither misses nor is inside [from, to]
+    packed_bytes_read += (column + 1) * sizeof(*header);
+    if (header->max >= from && header->min <= to && (from > header->min || header->max > to))
+        packed_bytes_read += header->payload_size_in_bytes;
+    return packed_count_in_range(header, n, from, to);
+}
+
+/**
+ * This function returns the total count of tuples in the range [from, to]
+ * This function uses the PACKED DATA file: the first block that can hold "from" is found by a binary search
+ * on the (min, max) of the packed key columns, then the keys of every block up to "to" are counted on
+ * their codes (packed_count_in_range), without decompressing them
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_value >= from AND primary_key_value <= to
+ *
+ */
+int primary_key_read_by_packed_blocks(uint64_t from, uint64_t to)
+{
+    if (to < from)
+        return 0;
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+
+    // Step 1: the first block whose largest key is >= from (the key is column 0, the first of every block)
+    uint64_t started = profile_clock(), steps = 0;
+    size_t low = 0, high = number_of_blocks;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        steps++;
+        if (packed_column(packed_block(mid), 0)->max < from)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    profile_search(&query_profile, steps);
+    query_profile.index_ns += profile_clock() - started;
+
+    // Step 2: count on the packed keys of every block until a block starts after "to"
+    int match_count = 0;
+    uint64_t bytes_read = packed_bytes_read;
+    started = profile_clock();
+    for (size_t b = low; b < number_of_blocks && packed_column(packed_block(b), 0)->min <= to; b++)
+    {
+        match_count += count_packed_column_in_range(b, 0, from, to);
+        query_profile.blocks_touched++;
+        query_profile.tuples_examined += row_count - b * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - b * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    query_profile.bytes_read += packed_bytes_read - bytes_read;
+    return match_count;
+}
+
+
+
+/**
+ * The rows appended since the last merge (the delta segment, see appendRows and mergeDelta)
+ * Every query answers over the data file AND the delta: the methods on the primary key add the delta
+ * rows in the range, counted through the delta index (two binary searches), or one by one for the
+ * tuple method; the aggregates over a key range fold in the delta rows of the range the same way; the
+ * queries on the other columns read every delta row (the delta is small, mergeDelta folds it in).
+ * The delta index is built when the table is opened, from the runs committed by then.
+ */
+int load_delta_file()
+{
+    if (access(delta_filename, R_OK) != 0)
+        return 0;
+    table.delta = map_file(delta_filename, &table.delta_size_in_bytes);
+    if (table.delta == NULL)
+        return 0;
+    if (delta_index_build(&delta_index, table.delta, table.delta_size_in_bytes, col_count) != 0)
+    {
+        fprintf(stderr, "%s is not a delta segment of this table\n", delta_filename);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+// Delta rows with a key in [from, to], through the delta index
+int delta_count(uint64_t from, uint64_t to)
+{
+    return delta_index_count(&delta_index, from, to);
+}
+
+// Delta rows with a key in [from, to], every delta row is read
+int delta_count_by_scan(uint64_t from, uint64_t to)
+{
+    int match_count = 0;
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        uint64_t key = table.delta[delta_index.rows[i]];
+        match_count += key >= from && key <= to;
+    }
+    return match_count;
+}
+
+// Delta rows whose "column" is in [from, to], every delta row is read
+int delta_count_column(int column, uint64_t from, uint64_t to)
+{
+    int match_count = 0;
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        uint64_t value = delta_index_row(&delta_index, i)[column];
+        match_count += value >= from && value <= to;
+    }
+    return match_count;
+}
+
+
+
+// Buffer pool hits and misses since the last report (only with -r pool)
+void report_buffer_pool(const char *method)
+{
+    if (block_io_mode != BLOCK_IO_BUFFER_POOL)
+        return;
+    uint64_t hits = buffer_pool.hits - reported_hits, misses = buffer_pool.misses - reported_misses;
+    printf("Buffer pool (%s): %lu hits, %lu misses, hit ratio %.3f\n", method, hits, misses, hits + misses ? (double)hits / (hits + misses) : 0.0);
+    reported_hits = buffer_pool.hits;
+    reported_misses = buffer_pool.misses;
+}
+
+// Function to verify the correctness of all the implementations (every method must return the same counts)
+void verify_correctness(int number_of_queries, int number_of_methods, int *method_results[])
+{
+    for(int q=0; q< number_of_queries; q++)
+        for (int m = 1; m < number_of_methods; m++)
+            if (method_results[m][q] != method_results[0][q])
+            {
+                printf("Error or incomplete implementation\n");
+                break;
+            }
+}
+
+/**
+ * With -e, every query runs between explain_begin and explain_end (explain_end_predicate for a query
+ * that is not a key range), which prints its EXPLAIN ANALYZE record (the counters and times gathered in
+ * query_profile by the access path)
+ */
+void explain_begin()
+{
+    if (!explain_analyze)
+        return;
+    memset(&query_profile, 0, sizeof(query_profile));
+    hardware_counters_start(&hardware_counters);
+    query_profile.started_ns = profile_clock();
+}
+
+void explain_record(const char *method, const char *predicate, uint64_t from, uint64_t to, uint64_t count)
+{
+    if (!explain_analyze)
+        return;
+    uint64_t total_ns = profile_clock() - query_profile.started_ns;
+    hardware_counters_stop(&hardware_counters);
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    print_query_profile(method, predicate, from, to, count, number_of_blocks, &query_profile, total_ns, &hardware_counters);
+}
+
+void explain_end(const char *method, uint64_t from, uint64_t to, uint64_t count)
+{
+    explain_record(method, NULL, from, to, count);
+}
+
+void explain_end_predicate(const char *method, const char *predicate, uint64_t count)
+{
+    explain_record(method, predicate, 0, 0, count);
+}
+
+// The tuples [first_tuple, end_tuple) visited by a scan reading values_read values of the data file
+void profile_tuple_scan(uint64_t first_tuple, uint64_t end_tuple, uint64_t values_read)
+{
+    if (end_tuple <= first_tuple)
+        return;
+    query_profile.tuples_examined += end_tuple - first_tuple;
+    query_profile.blocks_touched += (end_tuple - 1) / TUPLES_PER_BLOCK - first_tuple / TUPLES_PER_BLOCK + 1;
+    query_profile.bytes_read += values_read * sizeof(uint64_t);
+}
+
+void queries_on_primary_key(int number_of_queries, int query_from_range[], int query_to_range[])
+{
+    // Buffer to store the results of all queries for the four different schemes
+    int* tuple_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* block_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* dense_index_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* sparse_index_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* btree_index_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* learned_index_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* batch_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* packed_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* dense_index_only_method_result_count = malloc(sizeof(int) * number_of_queries);
+    int* method_results[9] = {tuple_method_result_count, block_method_result_count, dense_index_method_result_count, sparse_index_method_result_count, batch_method_result_count, dense_index_only_method_result_count};
+    int number_of_methods = 6;
+
+
+    // Queries using one tuple I/O at a time
+    advise_full_scan();
+    clock_t start_b1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        tuple_method_result_count[q] = primary_key_read_by_tuple(query_from_range[q], query_to_range[q]) + delta_count_by_scan(query_from_range[q], query_to_range[q]);
+        explain_end("tuple", query_from_range[q], query_to_range[q], tuple_method_result_count[q]);
+        printf("[Tuple I/O method] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], tuple_method_result_count[q]);
+    }
+    clock_t end_b1 = clock();
+    float seconds_b1 = (float)(end_b1 - start_b1) / CLOCKS_PER_SEC;
+    printf("\n");
+
+    // Queries using one block I/O at a time
+    clock_t start_b2 = clock();
+    int number_of_tuples_per_block = TUPLES_PER_BLOCK;
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        block_method_result_count[q] = primary_key_read_by_block(query_from_range[q], query_to_range[q], number_of_tuples_per_block) + delta_count(query_from_range[q], query_to_range[q]);
+        explain_end("block", query_from_range[q], query_to_range[q], block_method_result_count[q]);
+        printf("[Block I/O method] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], block_method_result_count[q]);
+    }
+    clock_t end_b2 = clock();
+    float seconds_b2 = (float)(end_b2 - start_b2) / CLOCKS_PER_SEC;
+    report_buffer_pool("block");
+    printf("\n");
+
+    // load dense index file
+    advise_index_lookups();
+    clock_t start_load = clock();
+    load_dense_index_file();
+    print_key_index("Dense", &dense_key_index, (float)(clock() - start_load) / CLOCKS_PER_SEC);
+
+    // Queries using dense index file
+    clock_t start_b3 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        dense_index_method_result_count[q] = primary_key_read_by_dense_index_file(query_from_range[q], query_to_range[q], number_of_tuples_per_block) + delta_count(query_from_range[q], query_to_range[q]);
+        explain_end("dense_index", query_from_range[q], query_to_range[q], dense_index_method_result_count[q]);
+        printf("[Using Dense Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], dense_index_method_result_count[q]);
+    }
+    clock_t end_b3 = clock();
+    float seconds_b3 = (float)(end_b3 - start_b3) / CLOCKS_PER_SEC;
+    report_buffer_pool("dense index");
+    printf("\n");
+
+    // The same counts from the dense index alone (COUNT(*) on the clustered key reads no data block)
+    clock_t start_b9 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        dense_index_only_method_result_count[q] = primary_key_count_by_dense_index_only(query_from_range[q], query_to_range[q]) + delta_count(query_from_range[q], query_to_range[q]);
+        explain_end("dense_index_only", query_from_range[q], query_to_range[q], dense_index_only_method_result_count[q]);
+        printf("[Using Dense Index only] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], dense_index_only_method_result_count[q]);
+    }
+    clock_t end_b9 = clock();
+    float seconds_b9 = (float)(end_b9 - start_b9) / CLOCKS_PER_SEC;
+    printf("\n");
+
+    // The same queries as one batch sharing a single scan of their blocks
+    // One record for the whole batch (its queries share the scan): the ranges of its queries and their total count
+    clock_t start_b7 = clock();
+    explain_begin();
+    primary_key_read_batch_by_dense_index_file(number_of_queries, query_from_range, query_to_range, batch_method_result_count);
+    uint64_t batch_count = 0;
+    char batch_ranges[1024];
+    int used = snprintf(batch_ranges, sizeof(batch_ranges), "%d key ranges:", number_of_queries);
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        batch_method_result_count[q] += delta_count(query_from_range[q], query_to_range[q]);
+        batch_count += batch_method_result_count[q];
+        if (used < (int)sizeof(batch_ranges))
+            used += snprintf(batch_ranges + used, sizeof(batch_ranges) - used, "%s [%d, %d]", q == 0 ? "" : ",", query_from_range[q], query_to_range[q]);
+    }
+    explain_end_predicate("batch", batch_ranges, batch_count);
+    clock_t end_b7 = clock();
+    float seconds_b7 = (float)(end_b7 - start_b7) / CLOCKS_PER_SEC;
+    for (int q = 0; q < number_of_queries; q++)
+        printf("[Batch shared scan] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], batch_method_result_count[q]);
+    printf("Batch: %lu block intervals, %lu blocks read (%lu for the queries one by one)\n", batch_block_intervals, batch_blocks_read, batch_blocks_requested);
+    report_buffer_pool("batch");
+    printf("\n");
+
+    // unload dense index file
+    unload_dense_index_file();
+
+    // load sparse index file
+    start_load = clock();
+    load_sparse_index_file();
+    print_key_index("Sparse", &sparse_key_index, (float)(clock() - start_load) / CLOCKS_PER_SEC);
+    printf("Sparse index: one entry per %lu tuples (%lu bytes of keys)", sparse_key_index.header.entry_stride,
+           sparse_key_index.header.number_of_entries * sizeof(uint64_t));
+    if (key_search == KEY_SEARCH_BINARY)
+        printf(", %d levels above them (%zu bytes)", sparse_level_index.number_of_levels - 1, sparse_level_index.size_in_bytes);
+    printf("\n");
+
+    // Queries using sparse index file
+    clock_t start_b4 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        sparse_index_method_result_count[q] = primary_key_read_by_sparse_index_file(query_from_range[q], query_to_range[q]) + delta_count(query_from_range[q], query_to_range[q]);
+        explain_end("sparse_index", query_from_range[q], query_to_range[q], sparse_index_method_result_count[q]);
+        printf("[Using Sparse Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], sparse_index_method_result_count[q]);
+    }
+    clock_t end_b4 = clock();
+    float seconds_b4 = (float)(end_b4 - start_b4) / CLOCKS_PER_SEC;
+    report_buffer_pool("sparse index");
+    printf("\n");
+
+    // unload sparse index file
+    unload_sparse_index_file();
+
+    // Queries using the B+-tree index file (if the table has one)
+    float seconds_b5 = 0;
+    if (load_btree_index_file())
+    {
+        clock_t start_b5 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            explain_begin();
+            btree_index_method_result_count[q] = primary_key_read_by_btree_index_file(query_from_range[q], query_to_range[q]) + delta_count(query_from_range[q], query_to_range[q]);
+            explain_end("btree_index", query_from_range[q], query_to_range[q], btree_index_method_result_count[q]);
+            printf("[Using B+-tree Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], btree_index_method_result_count[q]);
+        }
+        clock_t end_b5 = clock();
+        seconds_b5 = (float)(end_b5 - start_b5) / CLOCKS_PER_SEC;
+        printf("B+-tree: %lu levels, %lu pages read for %d queries\n", btree_index.header.number_of_levels, btree_index.page_reads, number_of_queries);
+        report_buffer_pool("B+-tree");
+        printf("\n");
+        method_results[number_of_methods++] = btree_index_method_result_count;
+        unload_btree_index_file();
+    }
+
+    // Queries using the learned index file (if the table has one)
+    float seconds_b6 = 0;
+    if (load_learned_index_file())
+    {
+        clock_t start_b6 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            explain_begin();
+            learned_index_method_result_count[q] = primary_key_read_by_learned_index_file(query_from_range[q], query_to_range[q]) + delta_count(query_from_range[q], query_to_range[q]);
+            explain_end("learned_index", query_from_range[q], query_to_range[q], learned_index_method_result_count[q]);
+            printf("[Using Learned Index file] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], learned_index_method_result_count[q]);
+        }
+        clock_t end_b6 = clock();
+        seconds_b6 = (float)(end_b6 - start_b6) / CLOCKS_PER_SEC;
+        printf("Learned index: %lu segments (%zu bytes, dense index %zu bytes), %lu keys read for %d queries\n",
+               learned_index.header.number_of_segments, learned_index_size_in_bytes(&learned_index),
+               table.dense_index_size_in_bytes, learned_index_probes, number_of_queries);
+        report_buffer_pool("learned index");
+        printf("\n");
+        method_results[number_of_methods++] = learned_index_method_result_count;
+        unload_learned_index_file();
+    }
+
+    // Queries on the packed copy of the data file (if the table has one)
+    float seconds_b8 = 0;
+    if (load_packed_data_file())
+    {
+        packed_bytes_read = 0;
+        clock_t start_b8 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            explain_begin();
+            packed_method_result_count[q] = primary_key_read_by_packed_blocks(query_from_range[q], query_to_range[q]) + delta_count(query_from_range[q], query_to_range[q]);
+            explain_end("packed_blocks", query_from_range[q], query_to_range[q], packed_method_result_count[q]);
+            printf("[Using Packed blocks] Count of tuples in the range [%d, %d] = %d\n", query_from_range[q], query_to_range[q], packed_method_result_count[q]);
+        }
+        clock_t end_b8 = clock();
+        seconds_b8 = (float)(end_b8 - start_b8) / CLOCKS_PER_SEC;
+        printf("Packed blocks: %zu bytes (data file %zu bytes), %lu bytes of headers and codes read for %d queries\n",
+               table.packed_data_size_in_bytes, table.data_size_in_bytes, packed_bytes_read, number_of_queries);
+        printf("\n");
+        method_results[number_of_methods++] = packed_method_result_count;
+    }
+
+    verify_correctness(number_of_queries, number_of_methods, method_results);
+
+    free(tuple_method_result_count);
+    free(block_method_result_count);
+    free(dense_index_method_result_count);
+    free(sparse_index_method_result_count);
+    free(btree_index_method_result_count);
+    free(learned_index_method_result_count);
+    free(batch_method_result_count);
+    free(packed_method_result_count);
+    free(dense_index_only_method_result_count);
+    printf("Time Tuple method %f | Block method (1024) %f | Dense Index method %f | Dense Index only method %f | Sparse Index method %f | B+-tree Index method %f | Learned Index method %f | Batch method %f | Packed block method %f \n", seconds_b1, seconds_b2, seconds_b3, seconds_b9, seconds_b4, seconds_b5, seconds_b6, seconds_b7, seconds_b8);
+}
+
+
+
+/**
+ * This function is used to map the ZONE MAP file: for every block, the (min, max) of every column
+ * Returns 0 if the table has no zone map (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_zonemap_file()
+{
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    if (access(zonemap_filename, R_OK) != 0)
+    {
+        printf("No zone map %s, run createPrimaryKeyIndexFiles to build it\n", zonemap_filename);
+        return 0;
+    }
+    if (table.zonemap == NULL)
+        table.zonemap = map_file(zonemap_filename, &table.zonemap_size_in_bytes);
+    if (table.zonemap_size_in_bytes < number_of_blocks * 2 * col_count * sizeof(uint64_t))
+    {
+        fprintf(stderr, "Zone map %s is truncated\n", zonemap_filename);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+// Count the values of "column" in [from, to] among the first n tuples of a block
+size_t count_block_column_in_range(const uint64_t *block_data, int column, size_t n, uint64_t from, uint64_t to)
+{
+    // a column is laid out like the keys: its own minipage in PAX, every col_count items in row-major
+    return count_block_keys_in_range(block_data + item_in_block(data_layout, col_count, 0, column), n, from, to);
+}
+
+/**
+ * This function returns the total count of tuples whose "column" is in the range [from, to]
+ * This function SCANS EVERY BLOCK of the mapped data file (the baseline for non-key columns)
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where column_value >= from AND column_value <= to
+ *
+ */
+int column_read_by_full_scan(int column, uint64_t from, uint64_t to)
+{
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    if (parallel_scan_possible(number_of_blocks))
+        return parallel_count(column, 0, number_of_blocks, from, to, row_count, 0);
+    int match_count = 0;
+    for (size_t b = 0; b < number_of_blocks; b++)
+    {
+        size_t n = row_count - b * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - b * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+        match_count += count_block_column_in_range(table.data + block_in_file(&data_geometry, b), column, n, from, to);
+    }
+    query_profile.blocks_touched += number_of_blocks;
+    query_profile.bytes_read += number_of_blocks * data_block_read_size;
+    return match_count;
+}
+
+struct zone_scan_stats
+{
+    size_t blocks_scanned;
+    size_t blocks_skipped;          // [min, max] of the block does not meet [from, to]
+    size_t blocks_fully_matched;    // [min, max] is inside [from, to], every tuple counts without a scan
+};
+
+/**
+ * This function returns the total count of tuples whose "column" is in the range [from, to]
+ * This function uses the ZONE MAP: a block whose [min, max] for the column does not meet [from, to]
+ * is skipped, a block whose [min, max] is inside [from, to] adds all its tuples, only the others are scanned
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where column_value >= from AND column_value <= to
+ *
+ */
+int column_read_by_zonemap(int column, uint64_t from, uint64_t to, struct zone_scan_stats *stats)
+{
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    memset(stats, 0, sizeof(*stats));
+    int match_count = 0;
+    for (size_t b = 0; b < number_of_blocks; b++)
+    {
+        size_t n = row_count - b * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - b * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+        const uint64_t *zone = table.zonemap + (b * col_count + column) * 2;
+        if (zone[1] < from || zone[0] > to)
+        {
+            stats->blocks_skipped++;
+            continue;
+        }
+        if (from <= zone[0] && zone[1] <= to)
+        {
+            stats->blocks_fully_matched++;
+            match_count += n;
+            continue;
+        }
+        stats->blocks_scanned++;
+        match_count += count_block_column_in_range(table.data + block_in_file(&data_geometry, b), column, n, from, to);
+    }
+    query_profile.index_probes += number_of_blocks;         // the (min, max) of every block
+    query_profile.blocks_touched += stats->blocks_scanned;
+    query_profile.bytes_read += stats->blocks_scanned * data_block_read_size;
+    return match_count;
+}
+
+/**
+ * This function returns the total count of tuples whose "column" is in the range [from, to]
+ * This function uses the PACKED DATA file: the column header of every packed block has the (min, max) of
+ * the column, so blocks are skipped or fully matched as with the zone map, and the others are counted
+ * on the packed codes of the column alone
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where column_value >= from AND column_value <= to
+ *
+ */
+int column_read_by_packed_blocks(int column, uint64_t from, uint64_t to, struct zone_scan_stats *stats)
+{
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    memset(stats, 0, sizeof(*stats));
+    int match_count = 0;
+    uint64_t started = profile_clock(), bytes_read = packed_bytes_read;
+    for (size_t b = 0; b < number_of_blocks; b++)
+    {
+        const struct packed_column_header *header = packed_column(packed_block(b), column);
+        if (header->max < from || header->min > to)
+            stats->blocks_skipped++;
+        else if (from <= header->min && header->max <= to)
+            stats->blocks_fully_matched++;
+        else
+        {
+            stats->blocks_scanned++;
+            query_profile.tuples_examined += row_count - b * TUPLES_PER_BLOCK < TUPLES_PER_BLOCK ? row_count - b * TUPLES_PER_BLOCK : TUPLES_PER_BLOCK;
+        }
+        match_count += count_packed_column_in_range(b, column, from, to);
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    query_profile.index_probes += number_of_blocks;         // the column header of every packed block
+    query_profile.blocks_touched += stats->blocks_scanned;
+    query_profile.bytes_read += packed_bytes_read - bytes_read;
+    return match_count;
+}
+
+// The EXPLAIN ANALYZE record of a count over one column, its predicate being "column c in [from, to]"
+void explain_column_query(const char *method, int column, uint64_t from, uint64_t to, uint64_t count)
+{
+    char predicate[128];
+    snprintf(predicate, sizeof(predicate), "column %d in [%lu, %lu]", column, from, to);
+    explain_end_predicate(method, predicate, count);
+}
+
+void queries_on_columns(int number_of_queries, const int query_column[], const uint64_t query_from_range[], const uint64_t query_to_range[])
+{
+    int* full_scan_result_count = malloc(sizeof(int) * number_of_queries);
+    int* zonemap_result_count = malloc(sizeof(int) * number_of_queries);
+    int* packed_result_count = malloc(sizeof(int) * number_of_queries);
+
+    // Queries scanning the whole column
+    advise_full_scan();
+    clock_t start_c1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        full_scan_result_count[q] = column_read_by_full_scan(query_column[q], query_from_range[q], query_to_range[q]) + delta_count_column(query_column[q], query_from_range[q], query_to_range[q]);
+        explain_column_query("column_full_scan", query_column[q], query_from_range[q], query_to_range[q], full_scan_result_count[q]);
+        printf("[Column full scan] Count of tuples with column %d in the range [%lu, %lu] = %d\n", query_column[q], query_from_range[q], query_to_range[q], full_scan_result_count[q]);
+    }
+    clock_t end_c1 = clock();
+    float seconds_c1 = (float)(end_c1 - start_c1) / CLOCKS_PER_SEC;
+    printf("\n");
+
+    // Queries using the zone map
+    float seconds_c2 = 0;
+    if (load_zonemap_file())
+    {
+        int* method_results[2] = {full_scan_result_count, zonemap_result_count};
+        clock_t start_c2 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            struct zone_scan_stats stats;
+            explain_begin();
+            zonemap_result_count[q] = column_read_by_zonemap(query_column[q], query_from_range[q], query_to_range[q], &stats) + delta_count_column(query_column[q], query_from_range[q], query_to_range[q]);
+            explain_column_query("zonemap", query_column[q], query_from_range[q], query_to_range[q], zonemap_result_count[q]);
+            printf("[Using Zone map] Count of tuples with column %d in the range [%lu, %lu] = %d (blocks scanned %zu, skipped %zu, fully matched %zu)\n",
+                   query_column[q], query_from_range[q], query_to_range[q], zonemap_result_count[q], stats.blocks_scanned, stats.blocks_skipped, stats.blocks_fully_matched);
+        }
+        clock_t end_c2 = clock();
+        seconds_c2 = (float)(end_c2 - start_c2) / CLOCKS_PER_SEC;
+        printf("\n");
+        verify_correctness(number_of_queries, 2, method_results);
+    }
+
+    // Queries on the packed copy of the data file
+    float seconds_c3 = 0;
+    if (load_packed_data_file())
+    {
+        int* method_results[2] = {full_scan_result_count, packed_result_count};
+        packed_bytes_read = 0;
+        clock_t start_c3 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            struct zone_scan_stats stats;
+            explain_begin();
+            packed_result_count[q] = column_read_by_packed_blocks(query_column[q], query_from_range[q], query_to_range[q], &stats) + delta_count_column(query_column[q], query_from_range[q], query_to_range[q]);
+            explain_column_query("packed_column", query_column[q], query_from_range[q], query_to_range[q], packed_result_count[q]);
+            printf("[Using Packed blocks] Count of tuples with column %d in the range [%lu, %lu] = %d (blocks counted on codes %zu, skipped %zu, fully matched %zu)\n",
+                   query_column[q], query_from_range[q], query_to_range[q], packed_result_count[q], stats.blocks_scanned, stats.blocks_skipped, stats.blocks_fully_matched);
+        }
+        clock_t end_c3 = clock();
+        seconds_c3 = (float)(end_c3 - start_c3) / CLOCKS_PER_SEC;
+        printf("Packed blocks: %lu bytes of headers and codes read for %d queries (a full scan of a column reads %lu bytes)\n",
+               packed_bytes_read, number_of_queries, row_count * sizeof(uint64_t));
+        printf("\n");
+        verify_correctness(number_of_queries, 2, method_results);
+    }
+
+    free(full_scan_result_count);
+    free(zonemap_result_count);
+    free(packed_result_count);
+    printf("Time Column full scan method %f | Zone map method %f | Packed block method %f \n", seconds_c1, seconds_c2, seconds_c3);
+}
+
+
+
+/**
+ * This function is used to map the AGGREGATES file: the prefix sums and min/max trees of every column over the blocks
+ * Returns 0 if the table has no aggregates file (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_aggregate_file()
+{
+    if (access(aggregate_filename, R_OK) != 0)
+    {
+        printf("No aggregates %s, run createPrimaryKeyIndexFiles to build it\n", aggregate_filename);
+        return 0;
+    }
+    if (table.aggregates == NULL)
+        table.aggregates = map_file(aggregate_filename, &table.aggregates_size_in_bytes);
+    const struct aggregate_file_header *header = (const struct aggregate_file_header *)table.aggregates;
+    if (table.aggregates_size_in_bytes < sizeof(*header) || header->magic != AGGREGATE_MAGIC || header->version != AGGREGATE_VERSION ||
+        header->row_count != row_count || header->col_count != (uint64_t)col_count ||
+        table.aggregates_size_in_bytes < aggregate_file_size_in_bytes(header))
+    {
+        fprintf(stderr, "%s is not an aggregates file of this table\n", aggregate_filename);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+// Aggregates of "column" over the tuples [first_tuple, end_tuple) of the data file
+void aggregate_tuples(int column, uint64_t first_tuple, uint64_t end_tuple, struct column_aggregates *aggregates)
+{
+    uint64_t started = profile_clock();
+    for (uint64_t i = first_tuple; i < end_tuple; i++)
+    {
+        uint64_t value = table.data[item_in_file(&data_geometry, i, column)];
+        aggregates->count++;
+        aggregates->sum += value;
+        aggregates->min = value < aggregates->min ? value : aggregates->min;
+        aggregates->max = value > aggregates->max ? value : aggregates->max;
+    }
+    aggregate_tuples_read += end_tuple > first_tuple ? end_tuple - first_tuple : 0;
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(first_tuple, end_tuple, end_tuple > first_tuple ? end_tuple - first_tuple : 0);
+}
+
+// Aggregates of "column" over the delta rows whose key is in [from, to], through the delta index
+void aggregate_delta_rows(int column, uint64_t from, uint64_t to, struct column_aggregates *aggregates)
+{
+    if (to < from)
+        return;
+    uint64_t end = to == UINT64_MAX ? delta_index.header.number_of_rows : delta_index_lower_bound(&delta_index, to + 1);
+    for (uint64_t i = delta_index_lower_bound(&delta_index, from); i < end; i++)
+    {
+        uint64_t value = delta_index_row(&delta_index, i)[column];
+        aggregates->count++;
+        aggregates->sum += value;
+        aggregates->min = value < aggregates->min ? value : aggregates->min;
+        aggregates->max = value > aggregates->max ? value : aggregates->max;
+    }
+}
+
+/**
+ * This function returns the COUNT, SUM, MIN and MAX of "column" over the tuples whose key is in [from, to]
+ * This function uses the DENSE INDEX FILE to find the tuples and SCANS all of them in the data file
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*), SUM(column_value), MIN(column_value), MAX(column_value), AVG(column_value)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ */
+void column_aggregate_by_scan(int column, uint64_t from, uint64_t to, struct column_aggregates *aggregates)
+{
+    column_aggregates_init(aggregates);
+    aggregate_delta_rows(column, from, to, aggregates);
+    if (to < from)
+        return;
+    uint64_t first_tuple = dense_index_lower_bound(from);
+    uint64_t end_tuple = to == UINT64_MAX ? row_count : dense_index_lower_bound(to + 1);
+    aggregate_tuples(column, first_tuple, end_tuple, aggregates);
+}
+
+/**
+ * This function returns the COUNT, SUM, MIN and MAX of "column" over the tuples whose key is in [from, to]
+ * This function uses the DENSE INDEX FILE to find the tuples and the AGGREGATES FILE for every block that
+ * lies entirely inside them: only the partial blocks at both ends of the range are read
+ *
+ * The SQL equivalent is:
+ *
+ * SELECT COUNT(*), SUM(column_value), MIN(column_value), MAX(column_value), AVG(column_value)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ *
+ */
+void column_aggregate_by_aggregate_index(int column, uint64_t from, uint64_t to, struct column_aggregates *aggregates)
+{
+    column_aggregates_init(aggregates);
+    aggregate_delta_rows(column, from, to, aggregates);
+    if (to < from)
+        return;
+
+    // Step 1: the tuples of the range, from the dense index
+    uint64_t first_tuple = dense_index_lower_bound(from);
+    uint64_t end_tuple = to == UINT64_MAX ? row_count : dense_index_lower_bound(to + 1);
+    if (end_tuple <= first_tuple)
+        return;
+
+    // Step 2: the blocks [first_full_block, end_full_block) are entirely inside the range
+    uint64_t first_full_block = (first_tuple + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    uint64_t end_full_block = end_tuple == row_count ? (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK : end_tuple / TUPLES_PER_BLOCK;
+    if (end_full_block <= first_full_block)
+    {
+        aggregate_tuples(column, first_tuple, end_tuple, aggregates);
+        return;
+    }
+    struct column_aggregates full_blocks;
+    uint64_t started = profile_clock();
+    aggregate_blocks((const struct aggregate_file_header *)table.aggregates, column, first_full_block, end_full_block - 1, &full_blocks);
+    query_profile.index_ns += profile_clock() - started;
+    column_aggregates_merge(aggregates, &full_blocks);
+
+    // Step 3: the partial blocks before and after them
+    aggregate_tuples(column, first_tuple, first_full_block * TUPLES_PER_BLOCK, aggregates);
+    if (end_full_block * TUPLES_PER_BLOCK < end_tuple)
+        aggregate_tuples(column, end_full_block * TUPLES_PER_BLOCK, end_tuple, aggregates);
+}
+
+void print_column_aggregates(const char *method, int column, uint64_t from, uint64_t to, const struct column_aggregates *aggregates)
+{
+    printf("[%s] Column %d for keys in [%lu, %lu]: COUNT %lu SUM %lu MIN %lu MAX %lu AVG %f\n", method, column, from, to,
+           aggregates->count, aggregates->sum, aggregates->count ? aggregates->min : 0, aggregates->max,
+           aggregates->count ? (double)aggregates->sum / aggregates->count : 0.0);
+}
+
+void queries_with_aggregates(int number_of_queries, const int query_column[], const uint64_t query_from_range[], const uint64_t query_to_range[])
+{
+    struct column_aggregates *scan_results = malloc(sizeof(struct column_aggregates) * number_of_queries);
+    struct column_aggregates *aggregate_index_results = malloc(sizeof(struct column_aggregates) * number_of_queries);
+    load_dense_index_file();
+
+    // Queries scanning every tuple of the key range
+    aggregate_tuples_read = 0;
+    clock_t start_e1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        column_aggregate_by_scan(query_column[q], query_from_range[q], query_to_range[q], &scan_results[q]);
+        explain_end("aggregate_scan", query_from_range[q], query_to_range[q], scan_results[q].count);
+        print_column_aggregates("Aggregate scan", query_column[q], query_from_range[q], query_to_range[q], &scan_results[q]);
+    }
+    clock_t end_e1 = clock();
+    float seconds_e1 = (float)(end_e1 - start_e1) / CLOCKS_PER_SEC;
+    printf("Aggregate scan: %lu tuples read for %d queries\n", aggregate_tuples_read, number_of_queries);
+    printf("\n");
+
+    // Queries using the aggregates file for the whole blocks
+    float seconds_e2 = 0;
+    if (load_aggregate_file())
+    {
+        aggregate_tuples_read = 0;
+        clock_t start_e2 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            explain_begin();
+            column_aggregate_by_aggregate_index(query_column[q], query_from_range[q], query_to_range[q], &aggregate_index_results[q]);
+            explain_end("aggregates_file", query_from_range[q], query_to_range[q], aggregate_index_results[q].count);
+            print_column_aggregates("Using Aggregates file", query_column[q], query_from_range[q], query_to_range[q], &aggregate_index_results[q]);
+        }
+        clock_t end_e2 = clock();
+        seconds_e2 = (float)(end_e2 - start_e2) / CLOCKS_PER_SEC;
+        printf("Aggregates file: %lu tuples read for %d queries (%zu bytes)\n", aggregate_tuples_read, number_of_queries, table.aggregates_size_in_bytes);
+        printf("\n");
+        for (int q = 0; q < number_of_queries; q++)
+            if (memcmp(&scan_results[q], &aggregate_index_results[q], sizeof(struct column_aggregates)) != 0)
+            {
+                printf("Error or incomplete implementation\n");
+                break;
+            }
+    }
+
+    unload_dense_index_file();
+    free(scan_results);
+    free(aggregate_index_results);
+    printf("Time Aggregate scan method %f | Aggregates file method %f \n", seconds_e1, seconds_e2);
+}
+
+
+
+/**
+ * This function is used to map the BITMAP INDEX file (columns 2, 3 and 4)
+ * Returns 0 if the table has no bitmap index (built by an older createPrimaryKeyIndexFiles)
+ */
+int load_bitmap_index_file()
+{
+    if (access(bitmap_index_filename, R_OK) != 0)
+    {
+        printf("No bitmap index %s, run createPrimaryKeyIndexFiles to build it\n", bitmap_index_filename);
+        return 0;
+    }
+    bitmap_index.file = (const char *)map_file(bitmap_index_filename, &bitmap_index.file_size_in_bytes);
+    bitmap_index.header = (const struct bitmap_index_header *)bitmap_index.file;
+    if (bitmap_index.file_size_in_bytes < sizeof(struct bitmap_index_header) || bitmap_index.header->magic != BITMAP_INDEX_MAGIC ||
+        bitmap_index.header->version != BITMAP_INDEX_VERSION || bitmap_index.header->row_count != row_count)
+    {
+        fprintf(stderr, "%s is not a bitmap index of this table\n", bitmap_index_filename);
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+void unload_bitmap_index_file()
+{
+    unmap_file((uint64_t *)bitmap_index.file, bitmap_index.file_size_in_bytes);
+}
+
+/**
+ * Queries on columns 2, 3 and 4: one predicate "column BETWEEN from AND to" (from == to for an equality,
+ * a small IN list of consecutive values otherwise), or two predicates combined with AND or OR
+ */
+struct column_predicate
+{
+    int column;
+    uint64_t from;
+    uint64_t to;
+};
+
+enum predicate_combination
+{
+    PREDICATE_ONLY = 0,
+    PREDICATE_AND,
+    PREDICATE_OR
+};
+
+struct bitmap_query
+{
+    struct column_predicate left;
+    enum predicate_combination combination;
+    struct column_predicate right;
+};
+
+void print_column_predicate(const struct column_predicate *predicate)
+{
+    if (predicate->from == predicate->to)
+        printf("column %d = %lu", predicate->column, predicate->from);
+    else
+        printf("column %d in [%lu, %lu]", predicate->column, predicate->from, predicate->to);
+}
+
+void print_bitmap_query(const struct bitmap_query *query)
+{
+    print_column_predicate(&query->left);
+    if (query->combination != PREDICATE_ONLY)
+    {
+        printf(query->combination == PREDICATE_AND ? " AND " : " OR ");
+        print_column_predicate(&query->right);
+    }
+}
+
+// Append a predicate to the text of a query (for the EXPLAIN ANALYZE records), after separator
+void append_column_predicate(char *text, size_t size, const char *separator, const struct column_predicate *predicate)
+{
+    size_t used = strlen(text);
+    if (predicate->from == predicate->to)
+        snprintf(text + used, size - used, "%scolumn %d = %lu", separator, predicate->column, predicate->from);
+    else
+        snprintf(text + used, size - used, "%scolumn %d in [%lu, %lu]", separator, predicate->column, predicate->from, predicate->to);
+}
+
+void explain_bitmap_query(const char *method, const struct bitmap_query *query, uint64_t count)
+{
+    char predicate[256] = "";
+    append_column_predicate(predicate, sizeof(predicate), "", &query->left);
+    if (query->combination != PREDICATE_ONLY)
+        append_column_predicate(predicate, sizeof(predicate), query->combination == PREDICATE_AND ? " AND " : " OR ", &query->right);
+    explain_end_predicate(method, predicate, count);
+}
+
+// The predicates of a conjunction, ANDed (every tuple when there is none)
+void explain_conjunction(const char *method, const struct column_predicate predicates[], int number_of_predicates, uint64_t count)
+{
+    char predicate[512] = "";
+    for (int p = 0; p < number_of_predicates; p++)
+        append_column_predicate(predicate, sizeof(predicate), p == 0 ? "" : " AND ", &predicates[p]);
+    explain_end_predicate(method, predicate, count);
+}
+
+// Whether the values of a tuple (a delta row) match a predicate
+int predicate_matches(const struct column_predicate *predicate, const uint64_t *values)
+{
+    return values[predicate->column] >= predicate->from && values[predicate->column] <= predicate->to;
+}
+
+// Delta rows matching a bitmap query (the bitmap index only covers the data file), every delta row is read
+int delta_count_bitmap_query(const struct bitmap_query *query)
+{
+    int match_count = 0;
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        const uint64_t *values = delta_index_row(&delta_index, i);
+        int match = predicate_matches(&query->left, values);
+        if (query->combination == PREDICATE_AND)
+            match &= predicate_matches(&query->right, values);
+        else if (query->combination == PREDICATE_OR)
+            match |= predicate_matches(&query->right, values);
+        match_count += match;
+    }
+    return match_count;
+}
+
+/**
+ * This function returns the count of tuples matching the query, it VISITS EVERY TUPLE of the mapped data file
+ *
+ * The SQL equivalent is (for an AND):
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where column_a BETWEEN from_a AND to_a AND column_b BETWEEN from_b AND to_b
+ *
+ */
+int bitmap_query_count_by_scan(const struct bitmap_query *query)
+{
+    int match_count = 0;
+    uint64_t started = profile_clock();
+    for (uint64_t i = 0; i < row_count; i++)
+    {
+        uint64_t left_value = table.data[item_in_file(&data_geometry, i, query->left.column)];
+        int match = left_value >= query->left.from && left_value <= query->left.to;
+        if (query->combination != PREDICATE_ONLY)
+        {
+            uint64_t right_value = table.data[item_in_file(&data_geometry, i, query->right.column)];
+            int right_match = right_value >= query->right.from && right_value <= query->right.to;
+            match = query->combination == PREDICATE_AND ? match & right_match : match | right_match;
+        }
+        match_count += match;
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(0, row_count, query->combination == PREDICATE_ONLY ? row_count : 2 * row_count);
+    return match_count;
+}
+
+/**
+ * This function returns the count of tuples matching the query from the BITMAP INDEX only (the data file is not read):
+ * every predicate is the OR of the bitmaps of its values, the predicates are combined with a bitmap AND or OR
+ * and the count is the cardinality of the result
+ */
+int bitmap_query_count_by_bitmap_index(const struct bitmap_query *query)
+{
+    // every value of a predicate is one bitmap of the index
+    struct roaring_bitmap left, right, result;
+    uint64_t started = profile_clock();
+    bitmap_index_range(&bitmap_index, query->left.column, query->left.from, query->left.to, &left);
+    query_profile.index_probes += query->left.to - query->left.from + 1;
+    if (query->combination == PREDICATE_ONLY)
+    {
+        int count = (int)roaring_cardinality(&left);
+        roaring_free(&left);
+        query_profile.index_ns += profile_clock() - started;
+        return count;
+    }
+
+    bitmap_index_range(&bitmap_index, query->right.column, query->right.from, query->right.to, &right);
+    query_profile.index_probes += query->right.to - query->right.from + 1;
+    if (query->combination == PREDICATE_AND)
+        roaring_and(&result, &left, &right);
+    else
+        roaring_or(&result, &left, &right);
+    int count = (int)roaring_cardinality(&result);
+    roaring_free(&left);
+    roaring_free(&right);
+    roaring_free(&result);
+    query_profile.index_ns += profile_clock() - started;
+    return count;
+}
+
+void queries_with_bitmap_index(int number_of_queries, const struct bitmap_query queries[])
+{
+    int* scan_result_count = malloc(sizeof(int) * number_of_queries);
+    int* bitmap_result_count = malloc(sizeof(int) * number_of_queries);
+
+    // Queries scanning every tuple
+    clock_t start_d1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        scan_result_count[q] = bitmap_query_count_by_scan(&queries[q]) + delta_count_bitmap_query(&queries[q]);
+        explain_bitmap_query("bitmap_tuple_scan", &queries[q], scan_result_count[q]);
+        printf("[Tuple scan] Count of tuples where ");
+        print_bitmap_query(&queries[q]);
+        printf(" = %d\n", scan_result_count[q]);
+    }
+    clock_t end_d1 = clock();
+    float seconds_d1 = (float)(end_d1 - start_d1) / CLOCKS_PER_SEC;
+    printf("\n");
+
+    // Queries using the bitmap index
+    float seconds_d2 = 0;
+    if (load_bitmap_index_file())
+    {
+        int* method_results[2] = {scan_result_count, bitmap_result_count};
+        clock_t start_d2 = clock();
+        for (int q = 0; q < number_of_queries; q++)
+        {
+            explain_begin();
+            bitmap_result_count[q] = bitmap_query_count_by_bitmap_index(&queries[q]) + delta_count_bitmap_query(&queries[q]);
+            explain_bitmap_query("bitmap_index", &queries[q], bitmap_result_count[q]);
+            printf("[Using Bitmap index] Count of tuples where ");
+            print_bitmap_query(&queries[q]);
+            printf(" = %d\n", bitmap_result_count[q]);
+        }
+        clock_t end_d2 = clock();
+        seconds_d2 = (float)(end_d2 - start_d2) / CLOCKS_PER_SEC;
+        printf("Bitmap index: %zu bytes\n", bitmap_index.file_size_in_bytes);
+        printf("\n");
+        verify_correctness(number_of_queries, 2, method_results);
+        unload_bitmap_index_file();
+    }
+
+    free(scan_result_count);
+    free(bitmap_result_count);
+    printf("Time Tuple scan method %f | Bitmap index method %f \n", seconds_d1, seconds_d2);
+}
+
+
+
+/**
+ * Conjunctions of per-column range predicates (column_predicate, AND-ed):
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value BETWEEN a AND b AND column_2 < x AND column_3 = y ...
+ *
+ * conjunction_plan turns the predicates on the clustered key into a tuple range (dense index) and orders
+ * the others by their estimated selectivity, from the zone map of the blocks in that range: a predicate
+ * selects about |[from, to] ^ [min, max]| / |[min, max]| of a block. The most selective predicate is
+ * evaluated first, over every tuple of the block; each following one only over the tuples still selected.
+ * The zone map also works per block: a block where a predicate cannot match is skipped, and a predicate
+ * that holds for the whole block is not evaluated.
+ */
+#define CONJUNCTION_MAX_PREDICATES 4
+
+// Scan operator: the values of "column" for the tuples [first_tuple, first_tuple + n), block by block
+void vector_scan_column(int column, uint64_t first_tuple, size_t n, uint64_t *vector)
+{
+    size_t stride = key_stride(data_layout, col_count);     // a column is laid out like the keys
+    for (size_t i = 0; i < n;)
+    {
+        uint64_t tuple = first_tuple + i;
+        size_t tuple_in_block = tuple % TUPLES_PER_BLOCK;
+        size_t run = TUPLES_PER_BLOCK - tuple_in_block < n - i ? TUPLES_PER_BLOCK - tuple_in_block : n - i;
+        const uint64_t *values = table.data + item_in_file(&data_geometry, tuple, column);
+        for (size_t k = 0; k < run; k++)
+            vector[i + k] = values[k * stride];
+        i += run;
+    }
+}
+
+// Projection: the values of "column" for the n selected tuples of the batch starting at first_tuple
+void vector_gather_column(int column, uint64_t first_tuple, const uint16_t *selection, size_t n, uint64_t *vector)
+{
+    for (size_t k = 0; k < n; k++)
+        vector[k] = table.data[item_in_file(&data_geometry, first_tuple + selection[k], column)];
+}
+
+struct conjunction_plan
+{
+    uint64_t first_tuple;               // the tuples [first_tuple, end_tuple) pass the predicates on the key
+    uint64_t end_tuple;
+    int number_of_predicates;
+    struct column_predicate predicates[CONJUNCTION_MAX_PREDICATES];     // on the other columns, most selective first
+    double selectivity[CONJUNCTION_MAX_PREDICATES];                     // estimated fraction of the tuples it keeps
+};
+
+struct conjunction
+{
+    int number_of_predicates;
+    struct column_predicate predicates[CONJUNCTION_MAX_PREDICATES];
+};
+
+struct conjunction_stats
+{
+    uint64_t values_read;               // column values read to evaluate predicates
+    uint64_t blocks_skipped;            // blocks where a predicate could not match (zone map)
+    uint64_t predicates_skipped;        // (block, predicate) pairs where the predicate held for the whole block
+};
+
+// Estimated fraction of the tuples of the blocks [first_block, last_block] that pass a predicate (zone map)
+double estimate_selectivity(const struct column_predicate *predicate, size_t first_block, size_t last_block)
+{
+    if (table.zonemap == NULL || last_block < first_block)
+        return 1.0;
+    double selected = 0;
+    for (size_t b = first_block; b <= last_block; b++)
+    {
+        const uint64_t *zone = table.zonemap + (b * col_count + predicate->column) * 2;
+        uint64_t low = predicate->from > zone[0] ? predicate->from : zone[0];
+        uint64_t high = predicate->to < zone[1] ? predicate->to : zone[1];
+        if (low <= high)
+            selected += ((double)(high - low) + 1) / ((double)(zone[1] - zone[0]) + 1);
+    }
+    return selected / (last_block - first_block + 1);
+}
+
+// order_by_selectivity == 0 keeps the predicates in the order of the query
+void conjunction_plan(const struct column_predicate predicates[], int number_of_predicates, int order_by_selectivity, struct conjunction_plan *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+    plan->end_tuple = row_count;
+
+    // Step 1: the predicates on the key narrow the tuple range (the table is clustered on the key)
+    for (int p = 0; p < number_of_predicates; p++)
+    {
+        const struct column_predicate *predicate = &predicates[p];
+        if (predicate->column != 0)
+        {
+            plan->predicates[plan->number_of_predicates++] = *predicate;
+            continue;
+        }
+        uint64_t first = dense_index_lower_bound(predicate->from);
+        uint64_t end = predicate->to == UINT64_MAX ? row_count : dense_index_lower_bound(predicate->to + 1);
+        plan->first_tuple = first > plan->first_tuple ? first : plan->first_tuple;
+        plan->end_tuple = end < plan->end_tuple ? end : plan->end_tuple;
+    }
+    if (plan->end_tuple < plan->first_tuple)
+        plan->end_tuple = plan->first_tuple;
+
+    // Step 2: the other predicates, most selective first (insertion sort, there are a handful)
+    size_t first_block = plan->first_tuple / TUPLES_PER_BLOCK;
+    size_t last_block = plan->end_tuple == 0 ? 0 : (plan->end_tuple - 1) / TUPLES_PER_BLOCK;
+    for (int p = 0; p < plan->number_of_predicates; p++)
+    {
+        struct column_predicate predicate = plan->predicates[p];
+        double selectivity = plan->end_tuple > plan->first_tuple ? estimate_selectivity(&predicate, first_block, last_block) : 0;
+        int q = p;
+        for (; order_by_selectivity && q > 0 && plan->selectivity[q - 1] > selectivity; q--)
+        {
+            plan->predicates[q] = plan->predicates[q - 1];
+            plan->selectivity[q] = plan->selectivity[q - 1];
+        }
+        plan->predicates[q] = predicate;
+        plan->selectivity[q] = selectivity;
+    }
+}
+
+/**
+ * The tuples [first_tuple, first_tuple + n) of one block that pass every planned predicate, as a selection
+ * vector (positions from first_tuple); predicate_vector is a scratch vector of n values
+ * Returns the number of selected tuples; *selection is NULL when every tuple is selected (no predicate had to run)
+ */
+size_t conjunction_select_block(const struct conjunction_plan *plan, uint64_t first_tuple, size_t n, uint64_t *predicate_vector,
+                                uint16_t *selection_vector, const uint16_t **selection, struct conjunction_stats *stats)
+{
+    size_t block = first_tuple / TUPLES_PER_BLOCK;
+    *selection = NULL;
+
+    // Step 1: the zone map of the block, against every predicate before any value is read
+    int whole_block[CONJUNCTION_MAX_PREDICATES] = {0};
+    for (int p = 0; p < plan->number_of_predicates && table.zonemap != NULL; p++)
+    {
+        const struct column_predicate *predicate = &plan->predicates[p];
+        const uint64_t *zone = table.zonemap + (block * col_count + predicate->column) * 2;
+        if (zone[1] < predicate->from || zone[0] > predicate->to)
+        {
+            stats->blocks_skipped++;
+            return 0;
+        }
+        whole_block[p] = predicate->from <= zone[0] && zone[1] <= predicate->to;
+        stats->predicates_skipped += whole_block[p];
+    }
+
+    // Step 2: the other predicates refine the selection vector
+    size_t selected = n;
+    for (int p = 0; p < plan->number_of_predicates && selected > 0; p++)
+    {
+        const struct column_predicate *predicate = &plan->predicates[p];
+        if (whole_block[p])
+            continue;
+
+        // the first predicate to run reads the whole column of the block, the next ones the selected tuples only
+        if (*selection == NULL)
+            vector_scan_column(predicate->column, first_tuple, n, predicate_vector);
+        else
+            vector_gather_column(predicate->column, first_tuple, *selection, selected, predicate_vector);
+        stats->values_read += selected;
+        selected = vector_select(predicate_vector, *selection, selected, predicate->from, predicate->to, selection_vector);
+        *selection = selection_vector;
+    }
+    return selected;
+}
+
+/**
+ * This function returns the count of tuples matching a conjunction, with the PLAN: the key range from the
+ * dense index, then block by block the other predicates, most selective first, refine a selection vector
+ */
+int conjunction_count_by_plan(const struct conjunction_plan *plan, struct conjunction_stats *stats)
+{
+    uint64_t predicate_vector[TUPLES_PER_BLOCK];
+    uint16_t selection_vector[TUPLES_PER_BLOCK];
+    int match_count = 0;
+    uint64_t started = profile_clock(), values_read = stats->values_read, blocks_skipped = stats->blocks_skipped;
+    for (uint64_t tuple = plan->first_tuple; tuple < plan->end_tuple;)
+    {
+        size_t n = TUPLES_PER_BLOCK - tuple % TUPLES_PER_BLOCK;
+        n = plan->end_tuple - tuple < n ? plan->end_tuple - tuple : n;
+        const uint16_t *selection;
+        match_count += conjunction_select_block(plan, tuple, n, predicate_vector, selection_vector, &selection, stats);
+        tuple += n;
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(plan->first_tuple, plan->end_tuple, stats->values_read - values_read);
+    query_profile.blocks_touched -= stats->blocks_skipped - blocks_skipped;        // skipped on the zone map, not read
+    return match_count;
+}
+
+/**
+ * This function returns the count of tuples matching a conjunction ROW AT A TIME: every tuple of the table,
+ * its predicates tested in the order of the query (with a branch, stopping at the first that fails)
+ */
+int conjunction_count_by_row(const struct column_predicate predicates[], int number_of_predicates, struct conjunction_stats *stats)
+{
+    int match_count = 0;
+    uint64_t started = profile_clock(), values_read = stats->values_read;
+    for (uint64_t i = 0; i < row_count; i++)
+    {
+        int match = 1;
+        for (int p = 0; p < number_of_predicates && match; p++)
+        {
+            uint64_t value = table.data[item_in_file(&data_geometry, i, predicates[p].column)];
+            stats->values_read++;
+            match = value >= predicates[p].from && value <= predicates[p].to;
+        }
+        match_count += match;
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(0, row_count, stats->values_read - values_read);
+    return match_count;
+}
+
+// Delta rows matching a conjunction, every delta row is read
+int delta_count_conjunction(const struct column_predicate predicates[], int number_of_predicates)
+{
+    int match_count = 0;
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        const uint64_t *values = delta_index_row(&delta_index, i);
+        int match = 1;
+        for (int p = 0; p < number_of_predicates && match; p++)
+            match = predicate_matches(&predicates[p], values);
+        match_count += match;
+    }
+    return match_count;
+}
+
+void print_conjunction(const struct conjunction *query)
+{
+    for (int p = 0; p < query->number_of_predicates; p++)
+    {
+        printf(p == 0 ? "" : " AND ");
+        print_column_predicate(&query->predicates[p]);
+    }
+}
+
+void print_conjunction_plan(const struct conjunction_plan *plan)
+{
+    printf("Plan: tuples [%lu, %lu) from the dense index", plan->first_tuple, plan->end_tuple);
+    for (int p = 0; p < plan->number_of_predicates; p++)
+    {
+        printf(", then ");
+        print_column_predicate(&plan->predicates[p]);
+        printf(" (selectivity %.4f)", plan->selectivity[p]);
+    }
+    printf("\n");
+}
+
+void print_conjunction_stats(const char *method, const struct conjunction_stats *stats)
+{
+    printf("%s: %lu values read, %lu blocks skipped and %lu predicates skipped by the zone map\n", method,
+           stats->values_read, stats->blocks_skipped, stats->predicates_skipped);
+}
+
+void queries_with_conjunctions(int number_of_queries, const struct conjunction queries[])
+{
+    int *row_result_count = malloc(sizeof(int) * number_of_queries);
+    int *query_order_result_count = malloc(sizeof(int) * number_of_queries);
+    int *plan_result_count = malloc(sizeof(int) * number_of_queries);
+    load_dense_index_file();
+    load_zonemap_file();
+    advise_full_scan();
+
+    // Queries row at a time, the predicates in the order of the query
+    struct conjunction_stats row_stats = {0, 0, 0};
+    clock_t start_g1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        row_result_count[q] = conjunction_count_by_row(queries[q].predicates, queries[q].number_of_predicates, &row_stats) +
+                              delta_count_conjunction(queries[q].predicates, queries[q].number_of_predicates);
+        explain_conjunction("row_at_a_time", queries[q].predicates, queries[q].number_of_predicates, row_result_count[q]);
+        printf("[Row at a time] Count of tuples where ");
+        print_conjunction(&queries[q]);
+        printf(" = %d\n", row_result_count[q]);
+    }
+    clock_t end_g1 = clock();
+    float seconds_g1 = (float)(end_g1 - start_g1) / CLOCKS_PER_SEC;
+    print_conjunction_stats("Row at a time", &row_stats);
+    printf("\n");
+
+    // Queries with selection vectors, the predicates in the order of the query
+    struct conjunction_stats query_order_stats = {0, 0, 0};
+    clock_t start_g2 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        struct conjunction_plan plan;
+        explain_begin();
+        conjunction_plan(queries[q].predicates, queries[q].number_of_predicates, 0, &plan);
+        query_order_result_count[q] = conjunction_count_by_plan(&plan, &query_order_stats) + delta_count_conjunction(queries[q].predicates, queries[q].number_of_predicates);
+        explain_conjunction("selection_vectors_query_order", queries[q].predicates, queries[q].number_of_predicates, query_order_result_count[q]);
+        printf("[Selection vectors, query order] Count of tuples where ");
+        print_conjunction(&queries[q]);
+        printf(" = %d\n", query_order_result_count[q]);
+    }
+    clock_t end_g2 = clock();
+    float seconds_g2 = (float)(end_g2 - start_g2) / CLOCKS_PER_SEC;
+    print_conjunction_stats("Selection vectors, query order", &query_order_stats);
+    printf("\n");
+
+    // Queries with selection vectors, the most selective predicate first
+    struct conjunction_stats plan_stats = {0, 0, 0};
+    clock_t start_g3 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        struct conjunction_plan plan;
+        explain_begin();
+        conjunction_plan(queries[q].predicates, queries[q].number_of_predicates, 1, &plan);
+        plan_result_count[q] = conjunction_count_by_plan(&plan, &plan_stats) + delta_count_conjunction(queries[q].predicates, queries[q].number_of_predicates);
+        explain_conjunction("selection_vectors_by_selectivity", queries[q].predicates, queries[q].number_of_predicates, plan_result_count[q]);
+        printf("[Selection vectors, by selectivity] Count of tuples where ");
+        print_conjunction(&queries[q]);
+        printf(" = %d\n", plan_result_count[q]);
+        print_conjunction_plan(&plan);
+    }
+    clock_t end_g3 = clock();
+    float seconds_g3 = (float)(end_g3 - start_g3) / CLOCKS_PER_SEC;
+    print_conjunction_stats("Selection vectors, by selectivity", &plan_stats);
+    printf("\n");
+
+    int *method_results[3] = {row_result_count, query_order_result_count, plan_result_count};
+    verify_correctness(number_of_queries, 3, method_results);
+    unload_dense_index_file();
+    free(row_result_count);
+    free(query_order_result_count);
+    free(plan_result_count);
+    printf("Time Row at a time method %f | Selection vectors in query order method %f | Selection vectors by selectivity method %f \n",
+           seconds_g1, seconds_g2, seconds_g3);
+}
+
+
+
+/**
+ * Aggregate queries with projection and GROUP BY, the SQL equivalent is:
+ *
+ * SELECT group_column, COUNT(*), SUM(aggregate_column), MIN(aggregate_column), MAX(aggregate_column), AVG(aggregate_column), ...
+ * FROM table
+ * where predicate_1 AND predicate_2 ...
+ * GROUP BY group_column
+ *
+ * They run tuple at a time, and through the vectorized engine (vectorEngine.h): batches of VECTOR_SIZE
+ * tuples go through scan and filter (selection vectors), projection (only the selected tuples of the
+ * aggregate and group columns are read) and array or hash aggregation.
+ */
+struct vector_query
+{
+    int number_of_predicates;
+    struct column_predicate predicates[CONJUNCTION_MAX_PREDICATES]; // ANDed
+    int number_of_aggregates;
+    int aggregate_columns[VECTOR_MAX_AGGREGATES];
+    int group_column;                   // -1 without GROUP BY
+};
+
+uint64_t vector_tuples_scanned;         // tuples of the batches run by the vectorized engine
+
+void print_vector_query(const struct vector_query *query)
+{
+    printf("SELECT ");
+    if (query->group_column >= 0)
+        printf("column %d, ", query->group_column);
+    printf("COUNT(*)");
+    for (int a = 0; a < query->number_of_aggregates; a++)
+        printf(", SUM/MIN/MAX/AVG(column %d)", query->aggregate_columns[a]);
+    for (int p = 0; p < query->number_of_predicates; p++)
+    {
+        printf(p == 0 ? " WHERE " : " AND ");
+        print_column_predicate(&query->predicates[p]);
+    }
+    if (query->group_column >= 0)
+        printf(" GROUP BY column %d", query->group_column);
+}
+
+// Array aggregation when the zone map (and the delta rows) show every value of the group column below VECTOR_ARRAY_GROUPS
+// Returns the number of array groups, 0 for hash aggregation
+uint64_t vector_query_array_groups(const struct vector_query *query)
+{
+    if (query->group_column < 0)
+        return 1;           // a single group
+    if (table.zonemap == NULL)
+        return 0;
+    size_t number_of_blocks = (row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    uint64_t max = 0;
+    for (size_t b = 0; b < number_of_blocks; b++)
+    {
+        uint64_t block_max = table.zonemap[(b * col_count + query->group_column) * 2 + 1];
+        max = block_max > max ? block_max : max;
+    }
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        uint64_t value = delta_index_row(&delta_index, i)[query->group_column];
+        max = value > max ? value : max;
+    }
+    return max < VECTOR_ARRAY_GROUPS ? max + 1 : 0;
+}
+
+/**
+ * This function runs an aggregate query ONE TUPLE AT A TIME: every tuple is tested against every predicate,
+ * then added to its group (always hash aggregation)
+ */
+void vector_query_by_tuple(const struct vector_query *query, struct group_table *groups)
+{
+    struct conjunction_plan plan;
+    conjunction_plan(query->predicates, query->number_of_predicates, 1, &plan);
+    group_table_init(groups, query->number_of_aggregates, query->group_column < 0 ? 1 : 0);
+    uint64_t started = profile_clock(), values_read = 0;
+    for (uint64_t i = plan.first_tuple; i < plan.end_tuple; i++)
+    {
+        int match = 1;
+        for (int p = 0; p < query->number_of_predicates && match; p++)
+        {
+            uint64_t value = table.data[item_in_file(&data_geometry, i, query->predicates[p].column)];
+            match = value >= query->predicates[p].from && value <= query->predicates[p].to;
+            values_read++;
+        }
+        if (!match)
+            continue;
+        values_read += query->number_of_aggregates + (query->group_column >= 0);
+
+        uint64_t group = query->group_column < 0 ? 0 : table.data[item_in_file(&data_geometry, i, query->group_column)];
+        uint64_t slot = group_table_slot(groups, group);
+        groups->counts[slot]++;
+        for (int a = 0; a < query->number_of_aggregates; a++)
+        {
+            uint64_t value = table.data[item_in_file(&data_geometry, i, query->aggregate_columns[a])];
+            struct column_aggregates *aggregates = &groups->aggregates[slot * query->number_of_aggregates + a];
+            aggregates->count++;
+            aggregates->sum += value;
+            aggregates->min = value < aggregates->min ? value : aggregates->min;
+            aggregates->max = value > aggregates->max ? value : aggregates->max;
+        }
+    }
+
+    // then the delta rows, the same way
+    for (uint64_t i = 0; i < delta_index.header.number_of_rows; i++)
+    {
+        const uint64_t *values = delta_index_row(&delta_index, i);
+        int match = 1;
+        for (int p = 0; p < query->number_of_predicates && match; p++)
+            match = predicate_matches(&query->predicates[p], values);
+        if (!match)
+            continue;
+        uint64_t slot = group_table_slot(groups, query->group_column < 0 ? 0 : values[query->group_column]);
+        groups->counts[slot]++;
+        for (int a = 0; a < query->number_of_aggregates; a++)
+        {
+            uint64_t value = values[query->aggregate_columns[a]];
+            struct column_aggregates *aggregates = &groups->aggregates[slot * query->number_of_aggregates + a];
+            aggregates->count++;
+            aggregates->sum += value;
+            aggregates->min = value < aggregates->min ? value : aggregates->min;
+            aggregates->max = value > aggregates->max ? value : aggregates->max;
+        }
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(plan.first_tuple, plan.end_tuple, values_read);
+}
+
+/**
+ * This function runs an aggregate query with the VECTORIZED ENGINE, for every batch of VECTOR_SIZE tuples:
+ * Step 1: scan and filter, the predicates of the conjunction plan (key range from the dense index, then the
+ *         most selective first) refine the selection vector, reading only the tuples still selected
+ * Step 2: projection, the group and aggregate columns are read for the selected tuples only
+ * Step 3: aggregation, the group of every selected tuple, then every aggregate column updated on its own
+ * The delta rows go through the same steps as batches of their own, after the data file
+ */
+void vector_query_by_vector_engine(const struct vector_query *query, struct group_table *groups)
+{
+    struct conjunction_plan plan;
+    conjunction_plan(query->predicates, query->number_of_predicates, 1, &plan);
+    uint64_t first_tuple = plan.first_tuple, end_tuple = plan.end_tuple;
+    group_table_init(groups, query->number_of_aggregates, vector_query_array_groups(query));
+
+    uint64_t predicate_vector[VECTOR_SIZE];
+    uint64_t group_vector[VECTOR_SIZE];
+    uint64_t aggregate_vectors[VECTOR_MAX_AGGREGATES][VECTOR_SIZE];
+    uint64_t *aggregate_values[VECTOR_MAX_AGGREGATES];
+    for (int a = 0; a < VECTOR_MAX_AGGREGATES; a++)
+        aggregate_values[a] = aggregate_vectors[a];
+    uint16_t selection_vector[VECTOR_SIZE];
+
+    uint64_t started = profile_clock(), values_read = 0;
+    for (uint64_t batch = first_tuple; batch < end_tuple; batch += VECTOR_SIZE)
+    {
+        size_t n = end_tuple - batch < VECTOR_SIZE ? end_tuple - batch : VECTOR_SIZE;
+        vector_tuples_scanned += n;
+
+        // Step 1: scan and filter (no selection vector until the first predicate: every tuple is selected)
+        const uint16_t *selection = NULL;
+        size_t selected = n;
+        for (int p = 0; p < plan.number_of_predicates && selected > 0; p++)
+        {
+            const struct column_predicate *predicate = &plan.predicates[p];
+            if (selection == NULL)
+                vector_scan_column(predicate->column, batch, n, predicate_vector);
+            else
+                vector_gather_column(predicate->column, batch, selection, selected, predicate_vector);
+            values_read += selected;
+            selected = vector_select(predicate_vector, selection, selected, predicate->from, predicate->to, selection_vector);
+            selection = selection_vector;
+        }
+        if (selected == 0)
+            continue;
+        values_read += selected * (query->number_of_aggregates + (query->group_column >= 0));
+
+        // Step 2: projection
+        for (int a = 0; a < query->number_of_aggregates; a++)
+        {
+            if (selection == NULL)
+                vector_scan_column(query->aggregate_columns[a], batch, n, aggregate_values[a]);
+            else
+                vector_gather_column(query->aggregate_columns[a], batch, selection, selected, aggregate_values[a]);
+        }
+        if (query->group_column >= 0)
+        {
+            if (selection == NULL)
+                vector_scan_column(query->group_column, batch, n, group_vector);
+            else
+                vector_gather_column(query->group_column, batch, selection, selected, group_vector);
+        }
+
+        // Step 3: aggregation
+        group_table_add_vector(groups, query->group_column >= 0 ? group_vector : NULL, aggregate_values, selected);
+    }
+
+    // The delta rows, VECTOR_SIZE at a time: the selected ones are projected row by row, then aggregated as a batch
+    for (uint64_t batch = 0; batch < delta_index.header.number_of_rows; batch += VECTOR_SIZE)
+    {
+        size_t n = delta_index.header.number_of_rows - batch < VECTOR_SIZE ? delta_index.header.number_of_rows - batch : VECTOR_SIZE;
+        size_t selected = 0;
+        for (size_t k = 0; k < n; k++)
+        {
+            const uint64_t *values = delta_index_row(&delta_index, batch + k);
+            int match = 1;
+            for (int p = 0; p < query->number_of_predicates && match; p++)
+                match = predicate_matches(&query->predicates[p], values);
+            if (!match)
+                continue;
+            for (int a = 0; a < query->number_of_aggregates; a++)
+                aggregate_values[a][selected] = values[query->aggregate_columns[a]];
+            group_vector[selected++] = query->group_column >= 0 ? values[query->group_column] : 0;
+        }
+        if (selected > 0)
+            group_table_add_vector(groups, query->group_column >= 0 ? group_vector : NULL, aggregate_values, selected);
+    }
+    query_profile.compute_ns += profile_clock() - started;
+    profile_tuple_scan(first_tuple, end_tuple, values_read);
+}
+
+// COUNT(*) of the tuples a query selected, over all its groups (the count of its EXPLAIN ANALYZE record)
+uint64_t vector_query_selected_tuples(const struct group_table *groups)
+{
+    uint64_t count = 0;
+    for (uint64_t s = 0; s < groups->capacity; s++)
+        count += groups->used[s] ? groups->counts[s] : 0;
+    return count;
+}
+
+// The number of groups and the first few groups of a result
+void print_vector_query_result(const char *method, const struct vector_query *query, const struct group_table *groups)
+{
+    printf("[%s] ", method);
+    print_vector_query(query);
+    printf(": %lu groups (%s aggregation)\n", groups->number_of_groups, groups->array_groups > 0 ? "array" : "hash");
+    uint64_t *slots = group_table_sorted_slots(groups);
+    for (uint64_t g = 0; g < groups->number_of_groups && g < 3; g++)
+    {
+        printf("    ");
+        if (query->group_column >= 0)
+            printf("column %d = %lu: ", query->group_column, groups->keys[slots[g]]);
+        printf("COUNT %lu", groups->counts[slots[g]]);
+        for (int a = 0; a < query->number_of_aggregates; a++)
+        {
+            const struct column_aggregates *aggregates = &groups->aggregates[slots[g] * query->number_of_aggregates + a];
+            printf(" | column %d SUM %lu MIN %lu MAX %lu AVG %f", query->aggregate_columns[a], aggregates->sum, aggregates->min,
+                   aggregates->max, (double)aggregates->sum / aggregates->count);
+        }
+        printf("\n");
+    }
+    free(slots);
+}
+
+// Both methods must find the same groups with the same aggregates
+int same_vector_query_results(const struct group_table *a, const struct group_table *b)
+{
+    if (a->number_of_groups != b->number_of_groups || a->number_of_aggregates != b->number_of_aggregates)
+        return 0;
+    uint64_t *slots_a = group_table_sorted_slots(a), *slots_b = group_table_sorted_slots(b);
+    int same = 1;
+    for (uint64_t g = 0; g < a->number_of_groups && same; g++)
+        same = a->keys[slots_a[g]] == b->keys[slots_b[g]] && a->counts[slots_a[g]] == b->counts[slots_b[g]] &&
+               memcmp(&a->aggregates[slots_a[g] * a->number_of_aggregates], &b->aggregates[slots_b[g] * b->number_of_aggregates],
+                      a->number_of_aggregates * sizeof(struct column_aggregates)) == 0;
+    free(slots_a);
+    free(slots_b);
+    return same;
+}
+
+void queries_with_vector_engine(int number_of_queries, const struct vector_query queries[])
+{
+    struct group_table *tuple_results = malloc(sizeof(struct group_table) * number_of_queries);
+    struct group_table *vector_results = malloc(sizeof(struct group_table) * number_of_queries);
+    load_dense_index_file();
+    load_zonemap_file();
+    advise_full_scan();
+
+    // Queries one tuple at a time
+    clock_t start_f1 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        vector_query_by_tuple(&queries[q], &tuple_results[q]);
+        explain_conjunction("tuple_at_a_time", queries[q].predicates, queries[q].number_of_predicates, vector_query_selected_tuples(&tuple_results[q]));
+        print_vector_query_result("Tuple at a time", &queries[q], &tuple_results[q]);
+    }
+    clock_t end_f1 = clock();
+    float seconds_f1 = (float)(end_f1 - start_f1) / CLOCKS_PER_SEC;
+    printf("\n");
+
+    // Queries through the vectorized engine
+    vector_tuples_scanned = 0;
+    clock_t start_f2 = clock();
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        explain_begin();
+        vector_query_by_vector_engine(&queries[q], &vector_results[q]);
+        explain_conjunction("vector_engine", queries[q].predicates, queries[q].number_of_predicates, vector_query_selected_tuples(&vector_results[q]));
+        print_vector_query_result("Vectorized engine", &queries[q], &vector_results[q]);
+    }
+    clock_t end_f2 = clock();
+    float seconds_f2 = (float)(end_f2 - start_f2) / CLOCKS_PER_SEC;
+    printf("Vectorized engine: %lu tuples in batches of %d, %.1f million tuples/s\n", vector_tuples_scanned, VECTOR_SIZE,
+           seconds_f2 > 0 ? vector_tuples_scanned / seconds_f2 / 1e6 : 0.0);
+    printf("\n");
+
+    for (int q = 0; q < number_of_queries; q++)
+        if (!same_vector_query_results(&tuple_results[q], &vector_results[q]))
+        {
+            printf("Error or incomplete implementation\n");
+            break;
+        }
+    for (int q = 0; q < number_of_queries; q++)
+    {
+        group_table_free(&tuple_results[q]);
+        group_table_free(&vector_results[q]);
+    }
+    unload_dense_index_file();
+    free(tuple_results);
+    free(vector_results);
+    printf("Time Tuple at a time method %f | Vectorized engine method %f \n", seconds_f1, seconds_f2);
+}
+
+
+
+void usage(char *program)
+{
+    printf("Usage: %s <metadata file> [-r mmap|io_uring|threads|direct|pool] [-d queue depth] [-m pool MiB] [-s binary|eytzinger] [-i populate|hugepage|all] [-c] [-e counters|perf] [-p threads]\n", program);
+    printf("  -r  how the block and index methods read blocks: the mapping (default), the asynchronous\n");
+    printf("      block reader on io_uring or on a pool of pread threads, the same reader on io_uring with O_DIRECT\n");
+    printf("      (page aligned reads bypassing the page cache, best with createDataFast -b page), or the buffer pool\n");
+    printf("  -d  number of block reads the asynchronous reader keeps in flight (default 8)\n");
+    printf("  -m  memory budget of the buffer pool in MiB (default 64)\n");
+    printf("  -s  how the dense and sparse index methods search their keys: binary search (default),\n");
+    printf("      or an Eytzinger-ordered copy of the keys built at load time\n");
+    printf("  -i  mapping hints of the dense and sparse index files: MAP_POPULATE, transparent huge pages, or both\n");
+    printf("  -c  verify the checksums of the dense and sparse index files when they are loaded\n");
+    printf("  -e  print an EXPLAIN ANALYZE record of every query, with the CPU's hardware counters for perf\n");
+    printf("  -p  threads of a wide block scan (block, dense index, B+-tree and column full scan methods, mapped data file):\n");
+    printf("      morsels of %d blocks on a work-stealing pool (default 1, no intra-query parallelism)\n", MORSEL_BLOCKS);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+    while ((option = getopt(argc, argv, "r:d:m:s:i:ce:p:")) != -1)
+    {
+        if (option == 'r' && strcmp(optarg, "mmap") == 0)
+            block_io_mode = BLOCK_IO_MMAP;
+        else if (option == 'r' && strcmp(optarg, "io_uring") == 0)
+        {
+            block_io_mode = BLOCK_IO_ASYNC;
+            block_reader_backend = BLOCK_READER_IO_URING;
+        }
+        else if (option == 'r' && strcmp(optarg, "threads") == 0)
+        {
+            block_io_mode = BLOCK_IO_ASYNC;
+            block_reader_backend = BLOCK_READER_THREADS;
+        }
+        else if (option == 'r' && strcmp(optarg, "direct") == 0)
+        {
+            block_io_mode = BLOCK_IO_ASYNC;
+            block_reader_backend = BLOCK_READER_IO_URING;
+            block_reader_direct = 1;
+        }
+        else if (option == 'r' && strcmp(optarg, "pool") == 0)
+            block_io_mode = BLOCK_IO_BUFFER_POOL;
+        else if (option == 'm' && atoi(optarg) > 0)
+            buffer_pool_budget_in_bytes = (size_t)atoi(optarg) << 20;
+        else if (option == 'd' && atoi(optarg) > 0)
+            block_reader_queue_depth = atoi(optarg);
+        else if (option == 's' && strcmp(optarg, "binary") == 0)
+            key_search = KEY_SEARCH_BINARY;
+        else if (option == 's' && strcmp(optarg, "eytzinger") == 0)
+            key_search = KEY_SEARCH_EYTZINGER;
+        else if (option == 'i' && (strcmp(optarg, "populate") == 0 || strcmp(optarg, "hugepage") == 0 || strcmp(optarg, "all") == 0))
+        {
+            index_map_populate |= strcmp(optarg, "hugepage") != 0;
+            index_map_hugepages |= strcmp(optarg, "populate") != 0;
+        }
+        else if (option == 'c')
+            verify_index_checksums = 1;
+        else if (option == 'p' && atoi(optarg) > 0)
+            scan_threads = atoi(optarg);
+        else if (option == 'e' && (strcmp(optarg, "counters") == 0 || strcmp(optarg, "perf") == 0))
+        {
+            explain_analyze = 1;
+            explain_hardware_counters = strcmp(optarg, "perf") == 0;
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *filename = argv[optind];
+
+    FILE *fptr;
+    char layout[16];
+    fptr = fopen(filename, "r");
+    if (fscanf(fptr, "%s\n%ld\n%d\n%15s", filenameSkeleteon, &row_count, &col_count, layout) == 4)
+        data_layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+    fclose(fptr);
+
+    data_filename = malloc(strlen(filenameSkeleteon) + 6);
+    strcpy(data_filename, filenameSkeleteon);
+    strcat(data_filename, ".data");
+
+    sparse_index_filename = malloc(strlen(filenameSkeleteon) + 14);
+    strcpy(sparse_index_filename, filenameSkeleteon);
+    strcat(sparse_index_filename, ".sparse_index");
+
+    dense_index_filename = malloc(strlen(filenameSkeleteon) + 13);
+    strcpy(dense_index_filename, filenameSkeleteon);
+    strcat(dense_index_filename, ".dense_index");
+
+    btree_index_filename = malloc(strlen(filenameSkeleteon) + 13);
+    strcpy(btree_index_filename, filenameSkeleteon);
+    strcat(btree_index_filename, ".btree_index");
+
+    learned_index_filename = malloc(strlen(filenameSkeleteon) + 15);
+    strcpy(learned_index_filename, filenameSkeleteon);
+    strcat(learned_index_filename, ".learned_index");
+
+    zonemap_filename = malloc(strlen(filenameSkeleteon) + 9);
+    strcpy(zonemap_filename, filenameSkeleteon);
+    strcat(zonemap_filename, ".zonemap");
+
+    bitmap_index_filename = malloc(strlen(filenameSkeleteon) + 14);
+    strcpy(bitmap_index_filename, filenameSkeleteon);
+    strcat(bitmap_index_filename, ".bitmap_index");
+
+    packed_data_filename = malloc(strlen(filenameSkeleteon) + 13);
+    strcpy(packed_data_filename, filenameSkeleteon);
+    strcat(packed_data_filename, ".packed_data");
+
+    aggregate_filename = malloc(strlen(filenameSkeleteon) + 12);
+    strcpy(aggregate_filename, filenameSkeleteon);
+    strcat(aggregate_filename, ".aggregates");
+
+    delta_filename = malloc(strlen(filenameSkeleteon) + 7);
+    strcpy(delta_filename, filenameSkeleteon);
+    strcat(delta_filename, ".delta");
+
+    // Map the data and index files once for all the queries below
+    open_table();
+    printf("Range count kernel: %s\n", select_range_count_kernel()->name);
+    if (block_io_mode == BLOCK_IO_ASYNC)
+        printf("Block reader: %s%s, queue depth %d\n", block_reader_backend_name(block_reader.backend), block_reader.direct ? " (O_DIRECT)" : "",
+               block_reader.queue_depth);
+    if (block_io_mode == BLOCK_IO_BUFFER_POOL)
+        printf("Buffer pool: %u frames of %zu bytes (CLOCK)\n", buffer_pool.number_of_frames, buffer_pool.frame_size_in_bytes);
+    printf("Key search: %s\n", key_search == KEY_SEARCH_EYTZINGER ? "eytzinger" : "binary");
+    if (morsel_pool_start(&morsel_pool, scan_threads) != 0)
+    {
+        perror("Error creating the scan threads");
+        return EXIT_FAILURE;
+    }
+    if (scan_threads > 1)
+        printf("Parallel scans: %d threads, morsels of %d blocks%s\n", scan_threads, MORSEL_BLOCKS,
+               block_io_mode == BLOCK_IO_MMAP ? "" : " (not with this block reader, the scans stay on one thread)");
+    query_profile_timing = explain_analyze;
+    hardware_counters.fds[0] = -1;
+    if (explain_hardware_counters && hardware_counters_open(&hardware_counters) != 0)
+        perror("Hardware counters (perf_event_open) not available, the EXPLAIN ANALYZE records leave them out");
+    if (load_delta_file())
+        printf("Delta segment: %lu rows in %lu runs, every query also counts them\n", delta_index.header.number_of_rows, delta_index.header.number_of_runs);
+
+    // ALl queries on the primary key
+    int number_of_queries = 9;
+    int *query_from_range = malloc(sizeof(int) * number_of_queries);
+    int *query_to_range = malloc(sizeof(int) * number_of_queries);
+    
+    query_from_range[0] = 159999000;
+    query_from_range[1] = 19990000;
+    query_from_range[2] = 1599000;
+    query_from_range[3] = 15999990;
+    query_from_range[4] = 129999000;
+    query_from_range[5] = 1999000;
+    query_from_range[6] = 10;
+    query_from_range[7] = 179999000;
+    query_from_range[8] = 0;
+    
+    query_to_range[0] = 160000000;
+    query_to_range[1] = 20000000;
+    query_to_range[2] = 16000000;
+    query_to_range[3] = 16000000;
+    query_to_range[4] = 139000000;
+    query_to_range[5] = 1700000;
+    query_to_range[6] = 50;
+    query_to_range[7] = 180000000;
+    query_to_range[8] = INT_MAX;        // every tuple, the last block included (a merged table seldom ends on a full block)
+
+    // ALl queries on the primary key
+    queries_on_primary_key(number_of_queries, query_from_range, query_to_range);
+
+    // ALl queries on the non-primary key columns
+    // column 1 is descending (row_count - rc) * 10, columns 2, 3 and 4 are in [0, 1000), [0, 10000) and [0, 100000)
+    int number_of_column_queries = 6;
+    int query_column[] = {1, 1, 2, 3, 4, 4};
+    uint64_t column_from_range[] = {1000000, 0, 0, 5000, 99990, 200000};
+    uint64_t column_to_range[] = {1500000, 100, 9, 5009, 99999, 300000};
+    if (col_count >= 5)
+    {
+        printf("\n");
+        queries_on_columns(number_of_column_queries, query_column, column_from_range, column_to_range);
+
+        // Equality, IN and AND/OR predicates on the low-cardinality columns 2, 3 and 4
+        struct bitmap_query bitmap_queries[] = {
+            {{2, 7, 7}, PREDICATE_ONLY, {0, 0, 0}},
+            {{3, 5000, 5009}, PREDICATE_ONLY, {0, 0, 0}},
+            {{2, 7, 7}, PREDICATE_AND, {3, 0, 999}},
+            {{2, 7, 7}, PREDICATE_OR, {4, 99999, 99999}},
+            {{2, 0, 499}, PREDICATE_AND, {4, 0, 49999}},
+            {{4, 12345, 12345}, PREDICATE_AND, {3, 2345, 2345}},
+        };
+        printf("\n");
+        queries_with_bitmap_index(sizeof(bitmap_queries) / sizeof(bitmap_queries[0]), bitmap_queries);
+
+        // SUM, MIN, MAX and AVG of a column over a key range (the last range is past the keys of the generated tables)
+        int number_of_aggregate_queries = 6;
+        int aggregate_column[] = {1, 2, 4, 3, 0, 2};
+        uint64_t aggregate_from_range[] = {1599000, 1599000, 19990000, 10, 0, 129999000};
+        uint64_t aggregate_to_range[] = {16000000, 16000000, 20000000, 50, UINT64_MAX, 139000000};
+        printf("\n");
+        queries_with_aggregates(number_of_aggregate_queries, aggregate_column, aggregate_from_range, aggregate_to_range);
+
+        // Projections, filters and GROUP BY on the small-domain columns, through the vectorized engine
+        struct vector_query vector_queries[] = {
+            {1, {{0, 1599000, 16000000}}, 2, {1, 4}, -1},
+            {0, {{0}}, 2, {3, 4}, 2},
+            {2, {{3, 0, 999}, {1, 0, 10000000}}, 1, {1}, 2},
+            {1, {{2, 0, 9}}, 1, {4}, 3},
+            {1, {{0, 10000000, 12000000}}, 1, {2}, 4},
+        };
+        printf("\n");
+        queries_with_vector_engine(sizeof(vector_queries) / sizeof(vector_queries[0]), vector_queries);
+
+        // Conjunctions on several columns, in no particular order of selectivity (the last one holds for every tuple)
+        struct conjunction conjunctions[] = {
+            {3, {{0, 1599000, 16000000}, {2, 0, 99}, {3, 5000, 5000}}},
+            {3, {{4, 0, 49999}, {2, 0, 9}, {1, 0, 10000000}}},
+            {2, {{0, 10000000, 12000000}, {4, 99000, UINT64_MAX}}},
+            {3, {{3, 0, 999}, {2, 7, 7}, {1, 5000000, 6000000}}},
+            {2, {{3, 0, 9999}, {2, 0, 999}}},
+        };
+        printf("\n");
+        queries_with_conjunctions(sizeof(conjunctions) / sizeof(conjunctions[0]), conjunctions);
+    }
+
+    if (scan_threads > 1)
+        printf("Parallel scans: %lu scans in morsels, %lu morsels stolen\n", parallel_scans, morsels_stolen);
+    morsel_pool_stop(&morsel_pool);
+
+    free(query_from_range);
+    free(query_to_range);
+    close_table();
+    hardware_counters_close(&hardware_counters);
+    free(data_filename);
+    free(sparse_index_filename);
+    free(dense_index_filename);
+    free(btree_index_filename);
+    free(learned_index_filename);
+    free(zonemap_filename);
+    free(bitmap_index_filename);
+    free(packed_data_filename);
+    free(aggregate_filename);
+    free(delta_filename);
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef QUERY_EXECUTOR_H
+#define QUERY_EXECUTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tableHandle.h"
+#include "threadPool.h"
+
+/**
+ * Thread-pool executor of independent range queries over a table handle
+ *
+ * The worker threads (threadPool.h) are started once and wait for batches. A batch is an array of queries
+ * and an array for their results; the workers claim QUERY_EXECUTOR_CHUNK queries at a time with an atomic
+ * increment of next_query and run them on the shared, read-only table (no lock on the query path), and the
+ * last worker to run out of queries wakes up the caller of query_executor_run.
+ */
+#define QUERY_EXECUTOR_CHUNK 64         // queries claimed at a time by a worker
+
+struct query_executor
+{
+    struct thread_pool workers;
+
+    // the current batch
+    const struct table *table;
+    enum table_method method;
+    const struct range_query *queries;
+    uint64_t *results;
+    size_t number_of_queries;
+    size_t next_query;                  // next query to claim (atomic)
+};
+
+// Claim chunks of queries until there are none left (runs on every worker)
+static void query_executor_task(void *argument, int thread)
+{
+    struct query_executor *executor = argument;
+    size_t first;
+    while ((first = __atomic_fetch_add(&executor->next_query, QUERY_EXECUTOR_CHUNK, __ATOMIC_RELAXED)) < executor->number_of_queries)
+    {
+        size_t end = first + QUERY_EXECUTOR_CHUNK < executor->number_of_queries ? first + QUERY_EXECUTOR_CHUNK : executor->number_of_queries;
+        for (size_t q = first; q < end; q++)
+            executor->results[q] = table_count(executor->table, executor->method, executor->queries[q].from, executor->queries[q].to);
+    }
+}
+
+// Start number_of_threads workers; returns 0, -1 if a thread cannot be created
+static inline int query_executor_start(struct query_executor *executor, int number_of_threads)
+{
+    memset(executor, 0, sizeof(*executor));
+    return thread_pool_start(&executor->workers, number_of_threads);
+}
+
+// Run a batch of queries with "method" on the workers, returns when every result is in
+static inline void query_executor_run(struct query_executor *executor, const struct table *table, enum table_method method,
+                                      const struct range_query *queries, uint64_t *results, size_t number_of_queries)
+{
+    executor->table = table;
+    executor->method = method;
+    executor->queries = queries;
+    executor->results = results;
+    executor->number_of_queries = number_of_queries;
+    executor->next_query = 0;
+    thread_pool_submit(&executor->workers, query_executor_task, executor);
+    thread_pool_wait(&executor->workers);
+}
+
+static inline void query_executor_stop(struct query_executor *executor)
+{
+    thread_pool_stop(&executor->workers);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef QUERY_PROFILE_H
+#define QUERY_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/**
+ * EXPLAIN ANALYZE of one query: what its access path did, counted as it runs
+ *
+ * The counters are plain increments in the access paths (block scan, range-count kernel, index searches),
+ * always on. The time split needs a clock read around every index search, block fetch and kernel call,
+ * so profile_clock only reads the clock when query_profile_timing is set (otherwise it returns 0 and every
+ * elapsed time is 0). With the mapped data file (-r mmap) a page fault is taken inside the kernel call,
+ * so its I/O shows up as compute time; the asynchronous reader and the buffer pool wait in the block
+ * fetch, which is the I/O time.
+ */
+struct query_profile
+{
+    uint64_t syscalls;              // system calls issued for the query (madvise hints, block reads)
+    uint64_t bytes_read;            // bytes of the data file (or of its packed copy) the query read
+    uint64_t blocks_touched;        // data blocks visited
+    uint64_t index_probes;          // index keys (or B+-tree pages, learned index keys) compared
+    uint64_t search_depth;          // steps of the deepest index search of the query
+    uint64_t tuples_examined;       // keys compared with the range
+    uint64_t index_ns;              // time in the index searches
+    uint64_t io_ns;                 // time waiting for blocks
+    uint64_t compute_ns;            // time counting the keys of the blocks
+    uint64_t started_ns;
+};
+
+static int query_profile_timing = 0;
+
+// Wall clock in nanoseconds when timing the profile, 0 otherwise
+static inline uint64_t profile_clock(void)
+{
+    if (!query_profile_timing)
+        return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// A search of "steps" probes: add them and keep the deepest
+static inline void profile_search(struct query_profile *profile, uint64_t steps)
+{
+    profile->index_probes += steps;
+    profile->search_depth = steps > profile->search_depth ? steps : profile->search_depth;
+}
+
+/**
+ * Hardware counters of the CPU (perf_event_open), one group read around a query: cache misses, branch
+ * misses, instructions and cycles of this thread in user space. perf_event_paranoid, a container or a
+ * virtual machine may refuse them, hardware_counters_open then returns -1 and the records omit them.
+ */
+#define NUMBER_OF_HARDWARE_COUNTERS 4
+
+static const uint64_t hardware_counter_events[NUMBER_OF_HARDWARE_COUNTERS] = {
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES};
+static const char *hardware_counter_names[NUMBER_OF_HARDWARE_COUNTERS] = {"cache_misses", "branch_misses", "instructions", "cycles"};
+
+struct hardware_counters
+{
+    int fds[NUMBER_OF_HARDWARE_COUNTERS];       // fds[0] leads the group, -1 when not open
+    uint64_t values[NUMBER_OF_HARDWARE_COUNTERS];
+};
+
+static inline int hardware_counters_open(struct hardware_counters *counters)
+{
+    memset(counters->values, 0, sizeof(counters->values));
+    for (int c = 0; c < NUMBER_OF_HARDWARE_COUNTERS; c++)
+        counters->fds[c] = -1;
+    for (int c = 0; c < NUMBER_OF_HARDWARE_COUNTERS; c++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = hardware_counter_events[c];
+        attr.disabled = c == 0;         // the group starts and stops with its leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        counters->fds[c] = syscall(SYS_perf_event_open, &attr, 0, -1, c == 0 ? -1 : counters->fds[0], 0);
+        if (counters->fds[c] == -1)
+        {
+            int error = errno;
+            for (int o = 0; o < c; o++)
+                close(counters->fds[o]);
+            counters->fds[0] = -1;
+            errno = error;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void hardware_counters_start(struct hardware_counters *counters)
+{
+    if (counters->fds[0] == -1)
+        return;
+    ioctl(counters->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Stop the group and read its values into counters->values
+static inline void hardware_counters_stop(struct hardware_counters *counters)
+{
+    if (counters->fds[0] == -1)
+        return;
+    ioctl(counters->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t group[1 + NUMBER_OF_HARDWARE_COUNTERS];       // number of counters, then their values
+    if (read(counters->fds[0], group, sizeof(group)) == sizeof(group))
+        memcpy(counters->values, group + 1, sizeof(counters->values));
+}
+
+static inline void hardware_counters_close(struct hardware_counters *counters)
+{
+    for (int c = 0; c < NUMBER_OF_HARDWARE_COUNTERS; c++)
+        if (counters->fds[c] != -1)
+            close(counters->fds[c]);
+    counters->fds[0] = -1;
+}
+
+/**
+ * Print the record of a query as one JSON object on a line starting with "EXPLAIN ANALYZE", the blocks
+ * skipped being the blocks of the table the access path did not visit; counters may be NULL
+ * A query on the key has its range [from, to]; any other query has its predicate instead (from and to
+ * are then ignored), e.g. "column 2 = 7 AND column 3 in [0, 999]"
+ */
+static inline void print_query_profile(const char *method, const char *predicate, uint64_t from, uint64_t to, uint64_t count, uint64_t number_of_blocks,
+                                       const struct query_profile *profile, uint64_t total_ns, const struct hardware_counters *counters)
+{
+    printf("EXPLAIN ANALYZE {\"method\": \"%s\", ", method);
+    if (predicate != NULL)
+        printf("\"predicate\": \"%s\", ", predicate);
+    else
+        printf("\"from\": %lu, \"to\": %lu, ", from, to);
+    printf("\"count\": %lu, \"syscalls\": %lu, \"bytes_read\": %lu, "
+           "\"blocks_touched\": %lu, \"blocks_skipped\": %lu, \"index_probes\": %lu, \"search_depth\": %lu, \"tuples_examined\": %lu, "
+           "\"total_us\": %.3f, \"index_us\": %.3f, \"io_us\": %.3f, \"compute_us\": %.3f",
+           count, profile->syscalls, profile->bytes_read, profile->blocks_touched,
+           profile->blocks_touched < number_of_blocks ? number_of_blocks - profile->blocks_touched : 0, profile->index_probes,
+           profile->search_depth, profile->tuples_examined, total_ns / 1e3, profile->index_ns / 1e3, profile->io_ns / 1e3, profile->compute_ns / 1e3);
+    if (counters != NULL && counters->fds[0] != -1)
+        for (int c = 0; c < NUMBER_OF_HARDWARE_COUNTERS; c++)
+            printf(", \"%s\": %lu", hardware_counter_names[c], counters->values[c]);
+    printf("}\n");
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rangeCountKernels.h"
+
+// Wall clock in seconds (the kernels are CPU bound, but clock() is too coarse for short runs)
+double now_in_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Microbenchmark of the range-count kernels: keys/second of every variant the CPU supports,
+ * over a contiguous key array (PAX minipages, index keys) and over the keys of row-major tuples
+ *
+ * Keys follow the generator (rc * 10 + rand() % 10), every run counts a range covering half of them
+ */
+int main(int argc, char *argv[])
+{
+    size_t number_of_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+    int col_count = argc > 2 ? atoi(argv[2]) : 5;
+    int repetitions = argc > 3 ? atoi(argv[3]) : 20;
+
+    uint64_t *keys = malloc(number_of_keys * sizeof(uint64_t));
+    uint64_t *tuples = malloc(number_of_keys * col_count * sizeof(uint64_t));
+    if (keys == NULL || tuples == NULL)
+    {
+        perror("Memory allocation error for benchmark keys");
+        return EXIT_FAILURE;
+    }
+
+    srand(42);
+    for (size_t rc = 0; rc < number_of_keys; rc++)
+    {
+        keys[rc] = rc * 10 + rand() % 10;
+        for (int j = 0; j < col_count; j++)
+            tuples[rc * col_count + j] = j == 0 ? keys[rc] : rand();
+    }
+
+    uint64_t from = number_of_keys * 10 / 4;
+    uint64_t to = number_of_keys * 10 / 4 * 3;
+    size_t expected = scalar_count_contiguous(keys, number_of_keys, from, to);
+
+    __builtin_cpu_init();
+    printf("%zu keys, %d columns, range [%lu, %lu] matches %zu keys\n", number_of_keys, col_count, from, to, expected);
+    printf("%-8s %20s %20s\n", "kernel", "contiguous keys/s", "strided keys/s");
+    for (size_t k = 0; k < NUMBER_OF_RANGE_COUNT_KERNELS; k++)
+    {
+        const struct range_count_kernel *kernel = &range_count_kernels[k];
+        if (!kernel->supported())
+        {
+            printf("%-8s %20s %20s\n", kernel->name, "unsupported", "unsupported");
+            continue;
+        }
+
+        size_t contiguous_count = 0, strided_count = 0;
+        double start = now_in_seconds();
+        for (int r = 0; r < repetitions; r++)
+            contiguous_count = kernel->count_contiguous(keys, number_of_keys, from, to);
+        double contiguous_seconds = now_in_seconds() - start;
+
+        start = now_in_seconds();
+        for (int r = 0; r < repetitions; r++)
+            strided_count = kernel->count_strided(tuples, number_of_keys, col_count, from, to);
+        double strided_seconds = now_in_seconds() - start;
+
+        if (contiguous_count != expected || strided_count != expected)
+            printf("Error: %s counted %zu / %zu keys instead of %zu\n", kernel->name, contiguous_count, strided_count, expected);
+
+        printf("%-8s %20.0f %20.0f\n", kernel->name,
+               number_of_keys * (double)repetitions / contiguous_seconds,
+               number_of_keys * (double)repetitions / strided_seconds);
+    }
+
+    free(keys);
+    free(tuples);
+    return 0;
+}
@@ -0,0 +1,261 @@
+#ifndef RANGE_COUNT_KERNELS_H
+#define RANGE_COUNT_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RANGE_COUNT_X86 1
+#endif
+
+/**
+ * Range-count kernels: count the keys k with from <= k <= to, without any data-dependent branch
+ *
+ * Every kernel uses the same trick: k is in [from, to] exactly when (k - from) <= (to - from)
+ * in unsigned arithmetic, so one subtraction and one unsigned compare per key does the test.
+ * SSE4.2 and AVX2 only have signed 64-bit compares, so both sides are shifted by 2^63 first.
+ *
+ * Two shapes are provided:
+ *   count_contiguous: keys[0 .. n-1] (a PAX key minipage, an index key array)
+ *   count_strided:    keys[0], keys[stride], ... keys[(n-1) * stride] (keys of row-major tuples)
+ *
+ * The widest variant the CPU supports is picked once by select_range_count_kernel (cpuid through
+ * __builtin_cpu_supports); RANGE_COUNT_KERNEL=scalar|sse4.2|avx2|avx512 in the environment forces one.
+ */
+struct range_count_kernel
+{
+    const char *name;
+    int (*supported)(void);
+    size_t (*count_contiguous)(const uint64_t *keys, size_t n, uint64_t from, uint64_t to);
+    size_t (*count_strided)(const uint64_t *keys, size_t n, size_t stride, uint64_t from, uint64_t to);
+};
+
+static int scalar_supported(void)
+{
+    return 1;
+}
+
+static size_t scalar_count_contiguous(const uint64_t *keys, size_t n, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    uint64_t width = to - from;
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += (keys[i] - from) <= width;
+    return count;
+}
+
+static size_t scalar_count_strided(const uint64_t *keys, size_t n, size_t stride, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    uint64_t width = to - from;
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        count += (keys[i * stride] - from) <= width;
+    return count;
+}
+
+#ifdef RANGE_COUNT_X86
+
+static int sse42_supported(void)
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+// Count of lanes in [from, to] for one vector: out-of-range lanes compare to -1 and are accumulated in "out"
+__attribute__((target("sse4.2")))
+static size_t sse42_count_contiguous(const uint64_t *keys, size_t n, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m128i sign = _mm_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m128i from_v = _mm_set1_epi64x((long long)from);
+    const __m128i width_v = _mm_xor_si128(_mm_set1_epi64x((long long)(to - from)), sign);
+    __m128i out = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+        __m128i d = _mm_xor_si128(_mm_sub_epi64(v, from_v), sign);
+        out = _mm_sub_epi64(out, _mm_cmpgt_epi64(d, width_v));
+    }
+    size_t out_count = (size_t)_mm_extract_epi64(out, 0) + (size_t)_mm_extract_epi64(out, 1);
+    return (i - out_count) + scalar_count_contiguous(keys + i, n - i, from, to);
+}
+
+// SSE has no gather, the two lanes are loaded one by one
+__attribute__((target("sse4.2")))
+static size_t sse42_count_strided(const uint64_t *keys, size_t n, size_t stride, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m128i sign = _mm_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m128i from_v = _mm_set1_epi64x((long long)from);
+    const __m128i width_v = _mm_xor_si128(_mm_set1_epi64x((long long)(to - from)), sign);
+    __m128i out = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i v = _mm_set_epi64x((long long)keys[(i + 1) * stride], (long long)keys[i * stride]);
+        __m128i d = _mm_xor_si128(_mm_sub_epi64(v, from_v), sign);
+        out = _mm_sub_epi64(out, _mm_cmpgt_epi64(d, width_v));
+    }
+    size_t out_count = (size_t)_mm_extract_epi64(out, 0) + (size_t)_mm_extract_epi64(out, 1);
+    return (i - out_count) + scalar_count_strided(keys + i * stride, n - i, stride, from, to);
+}
+
+static int avx2_supported(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_sum_lanes(__m256i v)
+{
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return (size_t)_mm_extract_epi64(sum, 0) + (size_t)_mm_extract_epi64(sum, 1);
+}
+
+// Two independent accumulators keep two compares in flight per iteration
+__attribute__((target("avx2")))
+static size_t avx2_count_contiguous(const uint64_t *keys, size_t n, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i from_v = _mm256_set1_epi64x((long long)from);
+    const __m256i width_v = _mm256_xor_si256(_mm256_set1_epi64x((long long)(to - from)), sign);
+    __m256i out0 = _mm256_setzero_si256();
+    __m256i out1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(keys + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(keys + i + 4));
+        __m256i d0 = _mm256_xor_si256(_mm256_sub_epi64(v0, from_v), sign);
+        __m256i d1 = _mm256_xor_si256(_mm256_sub_epi64(v1, from_v), sign);
+        out0 = _mm256_sub_epi64(out0, _mm256_cmpgt_epi64(d0, width_v));
+        out1 = _mm256_sub_epi64(out1, _mm256_cmpgt_epi64(d1, width_v));
+    }
+    size_t out_count = avx2_sum_lanes(_mm256_add_epi64(out0, out1));
+    return (i - out_count) + scalar_count_contiguous(keys + i, n - i, from, to);
+}
+
+// Row-major keys are gathered four at a time, col_count items apart
+__attribute__((target("avx2")))
+static size_t avx2_count_strided(const uint64_t *keys, size_t n, size_t stride, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i from_v = _mm256_set1_epi64x((long long)from);
+    const __m256i width_v = _mm256_xor_si256(_mm256_set1_epi64x((long long)(to - from)), sign);
+    const __m256i index_v = _mm256_set_epi64x(3 * (long long)stride, 2 * (long long)stride, (long long)stride, 0);
+    __m256i out = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i v = _mm256_i64gather_epi64((const long long *)(keys + i * stride), index_v, 8);
+        __m256i d = _mm256_xor_si256(_mm256_sub_epi64(v, from_v), sign);
+        out = _mm256_sub_epi64(out, _mm256_cmpgt_epi64(d, width_v));
+    }
+    size_t out_count = avx2_sum_lanes(out);
+    return (i - out_count) + scalar_count_strided(keys + i * stride, n - i, stride, from, to);
+}
+
+static int avx512_supported(void)
+{
+    return __builtin_cpu_supports("avx512f");
+}
+
+// AVX-512 has an unsigned compare into a mask register, the count is the popcount of the mask
+__attribute__((target("avx512f,popcnt")))
+static size_t avx512_count_contiguous(const uint64_t *keys, size_t n, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m512i from_v = _mm512_set1_epi64((long long)from);
+    const __m512i width_v = _mm512_set1_epi64((long long)(to - from));
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512i d0 = _mm512_sub_epi64(_mm512_loadu_si512(keys + i), from_v);
+        __m512i d1 = _mm512_sub_epi64(_mm512_loadu_si512(keys + i + 8), from_v);
+        __mmask8 in0 = _mm512_cmple_epu64_mask(d0, width_v);
+        __mmask8 in1 = _mm512_cmple_epu64_mask(d1, width_v);
+        count += __builtin_popcount(((unsigned)in1 << 8) | in0);
+    }
+    if (i < n)
+    {
+        // masked load of the tail, lanes past n are not compared
+        __mmask8 tail = (__mmask8)((1u << ((n - i) < 8 ? (n - i) : 8)) - 1);
+        __m512i d = _mm512_sub_epi64(_mm512_maskz_loadu_epi64(tail, keys + i), from_v);
+        count += __builtin_popcount(_mm512_mask_cmple_epu64_mask(tail, d, width_v));
+        i += (n - i) < 8 ? (n - i) : 8;
+    }
+    return count + scalar_count_contiguous(keys + i, n - i, from, to);
+}
+
+__attribute__((target("avx512f,popcnt")))
+static size_t avx512_count_strided(const uint64_t *keys, size_t n, size_t stride, uint64_t from, uint64_t to)
+{
+    if (from > to)
+        return 0;
+    const __m512i from_v = _mm512_set1_epi64((long long)from);
+    const __m512i width_v = _mm512_set1_epi64((long long)(to - from));
+    const long long s = (long long)stride;
+    const __m512i index_v = _mm512_set_epi64(7 * s, 6 * s, 5 * s, 4 * s, 3 * s, 2 * s, s, 0);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i v = _mm512_i64gather_epi64(index_v, (const long long *)(keys + i * stride), 8);
+        count += __builtin_popcount(_mm512_cmple_epu64_mask(_mm512_sub_epi64(v, from_v), width_v));
+    }
+    return count + scalar_count_strided(keys + i * stride, n - i, stride, from, to);
+}
+
+#endif
+
+// Every variant, widest first
+static const struct range_count_kernel range_count_kernels[] = {
+#ifdef RANGE_COUNT_X86
+    {"avx512", avx512_supported, avx512_count_contiguous, avx512_count_strided},
+    {"avx2", avx2_supported, avx2_count_contiguous, avx2_count_strided},
+    {"sse4.2", sse42_supported, sse42_count_contiguous, sse42_count_strided},
+#endif
+    {"scalar", scalar_supported, scalar_count_contiguous, scalar_count_strided},
+};
+
+#define NUMBER_OF_RANGE_COUNT_KERNELS (sizeof(range_count_kernels) / sizeof(range_count_kernels[0]))
+
+// The kernel used by the queries, set by select_range_count_kernel
+static const struct range_count_kernel *range_count = &range_count_kernels[NUMBER_OF_RANGE_COUNT_KERNELS - 1];
+
+// Pick the widest kernel the CPU supports (or the one named by RANGE_COUNT_KERNEL), call once at startup
+static inline const struct range_count_kernel *select_range_count_kernel(void)
+{
+#ifdef RANGE_COUNT_X86
+    __builtin_cpu_init();
+#endif
+    const char *forced = getenv("RANGE_COUNT_KERNEL");
+    for (size_t k = 0; k < NUMBER_OF_RANGE_COUNT_KERNELS; k++)
+    {
+        if (!range_count_kernels[k].supported())
+            continue;
+        if (forced != NULL && strcmp(forced, range_count_kernels[k].name) != 0)
+            continue;
+        range_count = &range_count_kernels[k];
+        return range_count;
+    }
+    range_count = &range_count_kernels[NUMBER_OF_RANGE_COUNT_KERNELS - 1];
+    return range_count;
+}
+
+#endif
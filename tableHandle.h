@@ -0,0 +1,273 @@
+#ifndef TABLE_HANDLE_H
+#define TABLE_HANDLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tableLayout.h"
+#include "rangeCountKernels.h"
+#include "keyIndexFile.h"
+#include "deltaSegment.h"
+#include "levelIndex.h"
+
+/**
+ * A table opened for queries: the metadata, the mapped data file, the dense and sparse indexes (searched
+ * in place in their mappings, keyIndexFile.h) and the delta index of the rows appended since the last
+ * merge (deltaSegment.h), all owned by one handle instead of globals. A process can open several tables,
+ * and once table_open returns the handle is read-only: the table_count_* queries below can run on it
+ * from any number of threads at the same time.
+ */
+
+struct table
+{
+    char skeleton[1024];
+    uint64_t row_count;
+    int col_count;
+    enum table_layout layout;
+    struct data_file_geometry geometry; // where the blocks are in the data file (its header)
+    uint64_t *data;                     // mapping of the data file
+    size_t data_size_in_bytes;
+    void *dense_mapping;                // mapping of the dense index file
+    size_t dense_size_in_bytes;
+    struct key_index dense;
+    void *sparse_mapping;               // mapping of the sparse index file
+    size_t sparse_size_in_bytes;
+    struct key_index sparse;
+    struct level_index sparse_levels;   // levels above the sparse keys (levelIndex.h)
+    void *delta_mapping;                // mapping of the delta segment, if any
+    size_t delta_size_in_bytes;
+    struct delta_index delta;           // empty without a delta segment
+};
+
+enum table_method
+{
+    TABLE_DENSE_INDEX_ONLY = 0,         // positions of the first and last key from the dense index, no data read
+    TABLE_DENSE_INDEX = 1,              // blocks from the dense index pointers, keys counted in the data file
+    TABLE_SPARSE_INDEX = 2              // tuples between the bracketing sparse entries, keys counted in the data file
+};
+
+// A key range [from, to]
+struct range_query
+{
+    uint64_t from;
+    uint64_t to;
+};
+
+static inline const char *table_method_name(enum table_method method)
+{
+    return method == TABLE_DENSE_INDEX_ONLY ? "dense_only" : method == TABLE_DENSE_INDEX ? "dense" : "sparse";
+}
+
+// Map "<skeleton><extension>" read-only; NULL with *size_in_bytes = 0 if the file is missing or empty
+static inline void *table_map_file(const struct table *table, const char *extension, size_t *size_in_bytes, int flags)
+{
+    char filename[1100];
+    snprintf(filename, sizeof(filename), "%s%s", table->skeleton, extension);
+    *size_in_bytes = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    struct stat file_stat;
+    void *mapping = NULL;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED | flags, fd, 0);
+        if (mapping == MAP_FAILED)
+            mapping = NULL;
+        else
+            *size_in_bytes = file_stat.st_size;
+    }
+    close(fd);
+    return mapping;
+}
+
+static inline void table_close(struct table *table)
+{
+    key_index_close(&table->dense);
+    key_index_close(&table->sparse);
+    level_index_free(&table->sparse_levels);
+    delta_index_free(&table->delta);
+    if (table->data != NULL)
+        munmap(table->data, table->data_size_in_bytes);
+    if (table->dense_mapping != NULL)
+        munmap(table->dense_mapping, table->dense_size_in_bytes);
+    if (table->sparse_mapping != NULL)
+        munmap(table->sparse_mapping, table->sparse_size_in_bytes);
+    if (table->delta_mapping != NULL)
+        munmap(table->delta_mapping, table->delta_size_in_bytes);
+    memset(table, 0, sizeof(*table));
+}
+
+/**
+ * Open the table described by a metadata file; index_map_flags are added to the mmap flags of the
+ * index files (MAP_POPULATE)
+ * Returns 0, or -1 with a message if a file is missing or does not match the metadata
+ */
+static inline int table_open(struct table *table, const char *metadata_filename, int index_map_flags)
+{
+    memset(table, 0, sizeof(*table));
+    FILE *fptr = fopen(metadata_filename, "r");
+    if (fptr == NULL)
+    {
+        perror(metadata_filename);
+        return -1;
+    }
+    char layout[16];
+    int fields = fscanf(fptr, "%1023s\n%lu\n%d\n%15s", table->skeleton, &table->row_count, &table->col_count, layout);
+    fclose(fptr);
+    if (fields != 4 || table->col_count <= 0)
+    {
+        fprintf(stderr, "Metadata file %s is not valid\n", metadata_filename);
+        return -1;
+    }
+    table->layout = parse_layout_name(layout) == LAYOUT_PAX ? LAYOUT_PAX : LAYOUT_ROW_MAJOR;
+
+    size_t number_of_blocks = (table->row_count + TUPLES_PER_BLOCK - 1) / TUPLES_PER_BLOCK;
+    char data_filename[1100];
+    snprintf(data_filename, sizeof(data_filename), "%s.data", table->skeleton);
+    int data_fd = open(data_filename, O_RDONLY);
+    int geometry_read = data_fd != -1 && read_data_file_geometry(data_fd, table->layout, table->col_count, &table->geometry) == 0;
+    if (data_fd != -1)
+        close(data_fd);
+    table->data = table_map_file(table, ".data", &table->data_size_in_bytes, 0);
+    table->dense_mapping = table_map_file(table, ".dense_index", &table->dense_size_in_bytes, index_map_flags);
+    table->sparse_mapping = table_map_file(table, ".sparse_index", &table->sparse_size_in_bytes, index_map_flags);
+    uint64_t sparse_interval = key_index_file_stride(table->sparse_mapping, table->sparse_size_in_bytes, KEY_INDEX_SPARSE_DEFAULT_STRIDE);
+    if (!geometry_read || table->data_size_in_bytes < data_file_size_in_bytes(&table->geometry, number_of_blocks) ||
+        key_index_open(&table->dense, table->dense_mapping, table->dense_size_in_bytes, table->row_count, 1, TUPLES_PER_BLOCK, KEY_INDEX_POINTER_ITEMS) != 0 ||
+        key_index_open(&table->sparse, table->sparse_mapping, table->sparse_size_in_bytes, table->row_count, sparse_interval, TUPLES_PER_BLOCK, KEY_INDEX_POINTER_BYTES) != 0)
+    {
+        fprintf(stderr, "The data and index files of %s do not match its metadata, run createPrimaryKeyIndexFiles\n", table->skeleton);
+        table_close(table);
+        return -1;
+    }
+    madvise(table->dense_mapping, table->dense_size_in_bytes, MADV_RANDOM);
+    madvise(table->sparse_mapping, table->sparse_size_in_bytes, MADV_RANDOM);
+    level_index_build(&table->sparse_levels, table->sparse.keys, table->sparse.header.number_of_entries);
+
+    table->delta_mapping = table_map_file(table, ".delta", &table->delta_size_in_bytes, 0);
+    if (table->delta_mapping != NULL && delta_index_build(&table->delta, table->delta_mapping, table->delta_size_in_bytes, table->col_count) != 0)
+    {
+        fprintf(stderr, "%s.delta is not a delta segment of this table\n", table->skeleton);
+        table_close(table);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Evict the files of the table from the page cache, so the next queries read them from the device
+ * (cold cache): the pages are first unmapped from the process (MADV_DONTNEED, the mappings stay valid and
+ * fault the pages back in), since the kernel does not drop pages that are still mapped, then the clean
+ * pages of the files are dropped (POSIX_FADV_DONTNEED). Not for a handle that other threads are querying.
+ */
+static inline void table_drop_caches(struct table *table)
+{
+    const char *extensions[] = {".data", ".dense_index", ".sparse_index"};
+    void *mappings[] = {table->data, table->dense_mapping, table->sparse_mapping};
+    size_t sizes[] = {table->data_size_in_bytes, table->dense_size_in_bytes, table->sparse_size_in_bytes};
+    for (int f = 0; f < 3; f++)
+    {
+        madvise(mappings[f], sizes[f], MADV_DONTNEED);
+        char filename[1100];
+        snprintf(filename, sizeof(filename), "%s%s", table->skeleton, extensions[f]);
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1)
+            continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Position of the first key >= value in a sorted key array of n keys (n if there is none)
+static inline uint64_t table_lower_bound(const uint64_t *keys, uint64_t n, uint64_t value)
+{
+    uint64_t low = 0, high = n;
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        if (keys[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Keys in [from, to] among the tuples [first_tuple, end_tuple) of the data file, block by block
+static inline uint64_t table_count_keys_in_tuples(const struct table *table, uint64_t first_tuple, uint64_t end_tuple, uint64_t from, uint64_t to)
+{
+    size_t stride = key_stride(table->layout, table->col_count);
+    uint64_t match_count = 0;
+    for (uint64_t tuple = first_tuple; tuple < end_tuple;)
+    {
+        size_t n = TUPLES_PER_BLOCK - tuple % TUPLES_PER_BLOCK;
+        n = end_tuple - tuple < n ? end_tuple - tuple : n;
+        const uint64_t *keys = table->data + item_in_file(&table->geometry, tuple, 0);
+        match_count += stride == 1 ? range_count->count_contiguous(keys, n, from, to) : range_count->count_strided(keys, n, stride, from, to);
+        tuple += n;
+    }
+    return match_count;
+}
+
+/**
+ * The queries: COUNT(*) of the tuples with a key in [from, to], over the data file and the delta rows
+ *
+ * SELECT COUNT(*)
+ * FROM table
+ * where primary_key_column_value >= from AND primary_key_column_value <= to
+ */
+static inline uint64_t table_count_by_dense_index_only(const struct table *table, uint64_t from, uint64_t to)
+{
+    uint64_t first_tuple = table_lower_bound(table->dense.keys, table->row_count, from);
+    uint64_t end_tuple = to == UINT64_MAX ? table->row_count : table_lower_bound(table->dense.keys, table->row_count, to + 1);
+    return end_tuple > first_tuple ? end_tuple - first_tuple : 0;
+}
+
+static inline uint64_t table_count_by_dense_index(const struct table *table, uint64_t from, uint64_t to)
+{
+    uint64_t first_entry = table_lower_bound(table->dense.keys, table->row_count, from);
+    uint64_t end_entry = to == UINT64_MAX ? table->row_count : table_lower_bound(table->dense.keys, table->row_count, to + 1);
+    if (end_entry <= first_entry)
+        return 0;
+
+    // the blocks of the first and the last matching tuple, every key of those blocks is checked
+    uint64_t first_block = key_index_pointer(&table->dense, first_entry) / table->col_count / TUPLES_PER_BLOCK;
+    uint64_t last_block = key_index_pointer(&table->dense, end_entry - 1) / table->col_count / TUPLES_PER_BLOCK;
+    uint64_t end_tuple = (last_block + 1) * TUPLES_PER_BLOCK < table->row_count ? (last_block + 1) * TUPLES_PER_BLOCK : table->row_count;
+    return table_count_keys_in_tuples(table, first_block * TUPLES_PER_BLOCK, end_tuple, from, to);
+}
+
+static inline uint64_t table_count_by_sparse_index(const struct table *table, uint64_t from, uint64_t to)
+{
+    // the last entry with a key below "from" and the first entry with a key above "to" bracket the range
+    uint64_t number_of_entries = table->sparse.header.number_of_entries;
+    uint64_t start_entry = level_index_last_below(&table->sparse_levels, from, 0);
+    start_entry = start_entry == UINT64_MAX ? 0 : start_entry;
+    uint64_t end_entry = level_index_last_below(&table->sparse_levels, to, 1) + 1;     // 0 if every key is above "to"
+
+    size_t tuple_size_in_bytes = table->col_count * sizeof(uint64_t);
+    uint64_t start_tuple = key_index_pointer(&table->sparse, start_entry) / tuple_size_in_bytes;
+    uint64_t end_tuple = end_entry < number_of_entries ? key_index_pointer(&table->sparse, end_entry) / tuple_size_in_bytes : table->row_count;
+    return end_tuple > start_tuple ? table_count_keys_in_tuples(table, start_tuple, end_tuple, from, to) : 0;
+}
+
+static inline uint64_t table_count(const struct table *table, enum table_method method, uint64_t from, uint64_t to)
+{
+    uint64_t match_count;
+    if (method == TABLE_DENSE_INDEX_ONLY)
+        match_count = table_count_by_dense_index_only(table, from, to);
+    else if (method == TABLE_DENSE_INDEX)
+        match_count = table_count_by_dense_index(table, from, to);
+    else
+        match_count = table_count_by_sparse_index(table, from, to);
+    return match_count + delta_index_count(&table->delta, from, to);
+}
+
+#endif
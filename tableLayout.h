@@ -0,0 +1,196 @@
+#ifndef TABLE_LAYOUT_H
+#define TABLE_LAYOUT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+// Every block of the data file is composed of 400 tuples
+#define TUPLES_PER_BLOCK 400
+
+/**
+ * How the tuples of a block are laid out in the data file
+ *
+ * LAYOUT_ROW_MAJOR: tuple after tuple, every tuple is col_count uint64_t values
+ * LAYOUT_PAX:       column after column inside every block, one minipage of TUPLES_PER_BLOCK values
+ *                   per column; the key column (column 0) is the first minipage of the block, so a
+ *                   key-only scan touches TUPLES_PER_BLOCK * 8 bytes of each block instead of all of it
+ *
+ * Blocks have the same size and the same position in the file in both layouts (struct data_file_geometry).
+ * The dense and sparse index pointers are logical: they are derived from the tuple position
+ * (tuple_index * col_count items, tuple_index * col_count * 8 bytes) and not from where the
+ * key physically sits, so the same index files work against both layouts.
+ */
+enum table_layout
+{
+    LAYOUT_ROW_MAJOR = 0,
+    LAYOUT_PAX = 1
+};
+
+// Name of the layout as written in the metadata file
+static inline const char *layout_name(enum table_layout layout)
+{
+    return layout == LAYOUT_PAX ? "pax" : "row";
+}
+
+// Parse the layout name of the metadata file (or the command line), returns -1 for unknown names
+static inline int parse_layout_name(const char *name)
+{
+    if (strcmp(name, "row") == 0)
+        return LAYOUT_ROW_MAJOR;
+    if (strcmp(name, "pax") == 0)
+        return LAYOUT_PAX;
+    return -1;
+}
+
+// Position (in number of items) of the value of "column" of a tuple inside its block
+static inline size_t item_in_block(enum table_layout layout, int col_count, size_t tuple_in_block, int column)
+{
+    if (layout == LAYOUT_PAX)
+        return (size_t)column * TUPLES_PER_BLOCK + tuple_in_block;
+    return tuple_in_block * col_count + column;
+}
+
+/**
+ * Data file: a header page (struct data_file_header) recording the layout, then the blocks, each
+ * padded to block_size_in_bytes. The block size is chosen when the table is created (createDataFast -b):
+ * the 400 tuples of a block as they are, or rounded up to the sector (512 bytes) or the page (4096 bytes),
+ * and since the header is a page, blocks of a multiple of 4096 bytes start on page boundaries in the
+ * file: a block never straddles pages and can be read with O_DIRECT.
+ *
+ * A file without the header (written before it existed) is read as blocks packed from offset 0.
+ * The tuples per block stay TUPLES_PER_BLOCK whatever the block size: the zone map, the aggregates,
+ * the packed copy and the index pointers are all per 400 tuples.
+ */
+#define DATA_FILE_MAGIC 0x454c494641544144ULL      // "DATAFILE"
+#define DATA_FILE_VERSION 1
+#define DATA_FILE_HEADER_SIZE 4096
+#define DATA_FILE_SECTOR_SIZE 512
+#define DATA_FILE_PAGE_SIZE 4096
+
+struct data_file_header
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t row_count;
+    uint64_t col_count;
+    uint64_t layout;                    // enum table_layout
+    uint64_t tuples_per_block;
+    uint64_t block_size_in_bytes;       // a block and its padding
+    uint64_t data_offset_in_bytes;      // the first block
+};
+
+// Where the blocks of a data file are
+struct data_file_geometry
+{
+    enum table_layout layout;
+    int col_count;
+    size_t data_offset_in_items;        // items before the first block (the header)
+    size_t block_stride_in_items;       // items from the start of a block to the start of the next
+};
+
+// Bytes of the tuples of a block, without padding
+static inline size_t block_payload_in_bytes(int col_count)
+{
+    return (size_t)col_count * TUPLES_PER_BLOCK * sizeof(uint64_t);
+}
+
+static inline void data_file_geometry_init(struct data_file_geometry *geometry, enum table_layout layout, int col_count,
+                                           size_t data_offset_in_bytes, size_t block_size_in_bytes)
+{
+    geometry->layout = layout;
+    geometry->col_count = col_count;
+    geometry->data_offset_in_items = data_offset_in_bytes / sizeof(uint64_t);
+    geometry->block_stride_in_items = block_size_in_bytes / sizeof(uint64_t);
+}
+
+static inline size_t block_stride_in_bytes(const struct data_file_geometry *geometry)
+{
+    return geometry->block_stride_in_items * sizeof(uint64_t);
+}
+
+// Position (in number of items) of the first item of a block in the data file
+static inline size_t block_in_file(const struct data_file_geometry *geometry, size_t block_index)
+{
+    return geometry->data_offset_in_items + block_index * geometry->block_stride_in_items;
+}
+
+// Position (in bytes) of a block in the data file
+static inline size_t block_offset_in_bytes(const struct data_file_geometry *geometry, size_t block_index)
+{
+    return block_in_file(geometry, block_index) * sizeof(uint64_t);
+}
+
+// Position (in number of items) of the value of "column" of a tuple in the data file
+static inline size_t item_in_file(const struct data_file_geometry *geometry, size_t tuple_index, int column)
+{
+    return block_in_file(geometry, tuple_index / TUPLES_PER_BLOCK) +
+           item_in_block(geometry->layout, geometry->col_count, tuple_index % TUPLES_PER_BLOCK, column);
+}
+
+// Size of a data file of number_of_blocks blocks
+static inline size_t data_file_size_in_bytes(const struct data_file_geometry *geometry, size_t number_of_blocks)
+{
+    return block_offset_in_bytes(geometry, number_of_blocks);
+}
+
+/**
+ * Block size of a -b option: "compact" (the tuples only), "sector" or "page" (the tuples rounded up to
+ * 512 or 4096 bytes), or a number of bytes, at least the tuples and a multiple of 512
+ * Returns 0 for a size that cannot hold the tuples of a block
+ */
+static inline size_t parse_block_size(const char *name, int col_count)
+{
+    size_t payload = block_payload_in_bytes(col_count);
+    if (strcmp(name, "compact") == 0)
+        return payload;
+    if (strcmp(name, "sector") == 0)
+        return (payload + DATA_FILE_SECTOR_SIZE - 1) / DATA_FILE_SECTOR_SIZE * DATA_FILE_SECTOR_SIZE;
+    if (strcmp(name, "page") == 0)
+        return (payload + DATA_FILE_PAGE_SIZE - 1) / DATA_FILE_PAGE_SIZE * DATA_FILE_PAGE_SIZE;
+    size_t size = strtoull(name, NULL, 10);
+    return size >= payload && size % DATA_FILE_SECTOR_SIZE == 0 ? size : 0;
+}
+
+static inline void data_file_header_init(struct data_file_header *header, uint64_t row_count, const struct data_file_geometry *geometry)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = DATA_FILE_MAGIC;
+    header->version = DATA_FILE_VERSION;
+    header->row_count = row_count;
+    header->col_count = geometry->col_count;
+    header->layout = geometry->layout;
+    header->tuples_per_block = TUPLES_PER_BLOCK;
+    header->block_size_in_bytes = block_stride_in_bytes(geometry);
+    header->data_offset_in_bytes = geometry->data_offset_in_items * sizeof(uint64_t);
+}
+
+/**
+ * Geometry of a data file from its header, or of packed blocks from offset 0 for a file without one
+ * Returns 0, -1 if the header does not describe a table of col_count columns in this layout
+ */
+static inline int read_data_file_geometry(int fd, enum table_layout layout, int col_count, struct data_file_geometry *geometry)
+{
+    struct data_file_header header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != DATA_FILE_MAGIC)
+    {
+        data_file_geometry_init(geometry, layout, col_count, 0, block_payload_in_bytes(col_count));
+        return 0;
+    }
+    if (header.version != DATA_FILE_VERSION || header.col_count != (uint64_t)col_count || header.layout != (uint64_t)layout ||
+        header.tuples_per_block != TUPLES_PER_BLOCK || header.block_size_in_bytes < block_payload_in_bytes(col_count) ||
+        header.block_size_in_bytes % sizeof(uint64_t) != 0 || header.data_offset_in_bytes % sizeof(uint64_t) != 0)
+        return -1;
+    data_file_geometry_init(geometry, layout, col_count, header.data_offset_in_bytes, header.block_size_in_bytes);
+    return 0;
+}
+
+// Distance (in number of items) between the keys of two consecutive tuples of the same block
+static inline size_t key_stride(enum table_layout layout, int col_count)
+{
+    return layout == LAYOUT_PAX ? 1 : (size_t)col_count;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TABLE_UTILITIES_H
+#define TABLE_UTILITIES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tableHandle.h"
+
+/**
+ * Helpers shared by the programs around a table: the names of its files, the pseudo-random numbers of the
+ * generated rows and queries, and the uniform query ranges of the benchmarks
+ */
+
+// Build "<skeleton><extension>" (caller frees)
+static inline char *filename_with_extension(const char *skeleton, const char *extension)
+{
+    char *filename = malloc(strlen(skeleton) + strlen(extension) + 1);
+    if (filename == NULL)
+    {
+        perror("Memory allocation error for a file name");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(filename, skeleton);
+    strcat(filename, extension);
+    return filename;
+}
+
+// splitmix64: a cheap generator, the appended rows and the query ranges only need to change with the seed
+static inline uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform double in [0, 1)
+static inline double next_random_double(uint64_t *state)
+{
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * n ranges of width keys starting anywhere between the smallest and the largest key of the data file
+ * (a range ending past the largest possible key stops at UINT64_MAX)
+ */
+static inline void generate_uniform_ranges(const struct table *table, struct range_query *queries, size_t n, uint64_t width, uint64_t *state)
+{
+    uint64_t min_key = table->row_count > 0 ? table->dense.keys[0] : 0;
+    uint64_t max_key = table->row_count > 0 ? table->dense.keys[table->row_count - 1] : 0;
+    uint64_t span = max_key - min_key + 1;          // 0 when the keys cover the whole 64-bit range
+    for (size_t q = 0; q < n; q++)
+    {
+        queries[q].from = min_key + (span == 0 ? next_random(state) : next_random(state) % span);
+        queries[q].to = queries[q].from > UINT64_MAX - width ? UINT64_MAX : queries[q].from + width;
+    }
+}
+
+#endif
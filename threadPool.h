@@ -0,0 +1,126 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/**
+ * Persistent pool of worker threads, shared by the query executor (queryExecutor.h) and the morsel pool
+ * (morselPool.h)
+ *
+ * The workers are started once and wait for jobs. thread_pool_submit hands a task to every worker, each
+ * running task(argument, thread) with its own thread number from 1 to number_of_threads (0 is left to the
+ * caller, which may run its own share before thread_pool_wait); the last worker to finish the task wakes
+ * up the caller waiting in thread_pool_wait.
+ */
+typedef void (*thread_pool_task)(void *argument, int thread);
+
+struct thread_pool
+{
+    int number_of_threads;              // workers, the caller not included
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;           // signalled when a job starts (or the pool stops)
+    pthread_cond_t job_done;            // signalled when the last worker finishes the job
+    uint64_t job;                       // number of the current job
+    int stopping;
+    int busy_threads;                   // workers still running the current job
+    int next_thread;                    // thread number handed to the next worker joining the job
+
+    // the current job
+    thread_pool_task task;
+    void *argument;
+};
+
+static void *thread_pool_worker(void *argument)
+{
+    struct thread_pool *pool = argument;
+    uint64_t job = 0;
+    while (1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->job == job && !pool->stopping)
+            pthread_cond_wait(&pool->job_ready, &pool->lock);
+        if (pool->stopping)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        job = pool->job;
+        int thread = pool->next_thread++;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->task(pool->argument, thread);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy_threads == 0)
+            pthread_cond_signal(&pool->job_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Stop the workers once they are done with the current job and free the pool
+static inline void thread_pool_stop(struct thread_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 0; t < pool->number_of_threads; t++)
+        pthread_join(pool->threads[t], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->job_ready);
+    pthread_cond_destroy(&pool->job_done);
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->number_of_threads = 0;
+}
+
+// Start number_of_threads workers; returns 0, -1 if a thread cannot be created (the ones started are stopped)
+static inline int thread_pool_start(struct thread_pool *pool, int number_of_threads)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = malloc((number_of_threads > 0 ? number_of_threads : 1) * sizeof(pthread_t));
+    if (pool->threads == NULL)
+        return -1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_ready, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        if (pthread_create(&pool->threads[t], NULL, thread_pool_worker, pool) != 0)
+        {
+            thread_pool_stop(pool);
+            return -1;
+        }
+        pool->number_of_threads++;
+    }
+    return 0;
+}
+
+// Hand task(argument, thread) to every worker and return at once
+static inline void thread_pool_submit(struct thread_pool *pool, thread_pool_task task, void *argument)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->argument = argument;
+    pool->next_thread = 1;
+    pool->busy_threads = pool->number_of_threads;
+    pool->job++;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Wait until every worker is done with the job submitted last
+static inline void thread_pool_wait(struct thread_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy_threads > 0)
+        pthread_cond_wait(&pool->job_done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef VECTOR_ENGINE_H
+#define VECTOR_ENGINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aggregateIndex.h"
+
+/**
+ * Building blocks of the vectorized execution engine: every operator works on a batch of up to
+ * VECTOR_SIZE tuples at a time, one column at a time, in tight loops without per-tuple calls
+ *
+ * A batch is described by column vectors (the values of one column for the tuples of the batch) and a
+ * selection vector: the positions in the batch of the tuples that passed the filters so far.
+ * vector_select refines a selection with one range predicate, branch-free; group_table_add_vector
+ * finds the group of every selected tuple, then updates the aggregates one aggregate column at a time.
+ *
+ * Groups are kept in a group_table: a plain array indexed by the group value when the domain of the
+ * group column is small (known up front), an open-addressing hash table otherwise.
+ */
+#define VECTOR_SIZE 1024
+#define VECTOR_MAX_AGGREGATES 4
+#define VECTOR_ARRAY_GROUPS (1 << 16)       // group columns whose values are all below this use array aggregation
+
+/**
+ * Filter: keep the positions k of the selection whose value values[k] is in [from, to]
+ * values holds one value per position of the input selection (selection == NULL: positions 0 to n - 1)
+ * Returns the size of selection_out (which may be the input selection)
+ */
+static inline size_t vector_select(const uint64_t *values, const uint16_t *selection, size_t n, uint64_t from, uint64_t to, uint16_t *selection_out)
+{
+    if (to < from)
+        return 0;
+    uint64_t span = to - from;
+    size_t selected = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        selection_out[selected] = selection == NULL ? (uint16_t)k : selection[k];
+        selected += values[k] - from <= span;
+    }
+    return selected;
+}
+
+struct group_table
+{
+    int number_of_aggregates;
+    uint64_t array_groups;              // > 0: slot = group value, for values below array_groups
+    uint64_t capacity;                  // slots (a power of two for the hash table)
+    uint64_t number_of_groups;
+    uint64_t *keys;                     // group value of every slot
+    uint8_t *used;
+    uint64_t *counts;                   // COUNT(*) of every slot
+    struct column_aggregates *aggregates;       // number_of_aggregates per slot
+};
+
+static inline void group_table_allocate(struct group_table *table, uint64_t capacity)
+{
+    table->capacity = capacity;
+    table->keys = malloc(capacity * sizeof(uint64_t));
+    table->used = calloc(capacity, 1);
+    table->counts = calloc(capacity, sizeof(uint64_t));
+    uint64_t number_of_slot_aggregates = capacity * table->number_of_aggregates;       // 0 for a COUNT(*) only group by
+    table->aggregates = malloc(number_of_slot_aggregates * sizeof(struct column_aggregates) + (number_of_slot_aggregates == 0));
+    if (table->keys == NULL || table->used == NULL || table->counts == NULL || table->aggregates == NULL)
+    {
+        perror("Memory allocation error for the group table");
+        exit(EXIT_FAILURE);
+    }
+    for (uint64_t s = 0; s < number_of_slot_aggregates; s++)
+        column_aggregates_init(&table->aggregates[s]);
+}
+
+// array_groups > 0 for array aggregation over the values [0, array_groups), 0 for hash aggregation
+static inline void group_table_init(struct group_table *table, int number_of_aggregates, uint64_t array_groups)
+{
+    memset(table, 0, sizeof(*table));
+    table->number_of_aggregates = number_of_aggregates;
+    table->array_groups = array_groups;
+    group_table_allocate(table, array_groups > 0 ? array_groups : 1024);
+}
+
+static inline void group_table_free(struct group_table *table)
+{
+    free(table->keys);
+    free(table->used);
+    free(table->counts);
+    free(table->aggregates);
+}
+
+static inline uint64_t group_table_hash(uint64_t key, uint64_t capacity)
+{
+    return (key * 0x9e3779b97f4a7c15ULL) >> 17 & (capacity - 1);
+}
+
+// Double the hash table, every group is inserted again
+static inline void group_table_grow(struct group_table *table)
+{
+    struct group_table old = *table;
+    group_table_allocate(table, 2 * old.capacity);
+    for (uint64_t s = 0; s < old.capacity; s++)
+    {
+        if (!old.used[s])
+            continue;
+        uint64_t slot = group_table_hash(old.keys[s], table->capacity);
+        while (table->used[slot])
+            slot = (slot + 1) & (table->capacity - 1);
+        table->used[slot] = 1;
+        table->keys[slot] = old.keys[s];
+        table->counts[slot] = old.counts[s];
+        memcpy(&table->aggregates[slot * table->number_of_aggregates], &old.aggregates[s * old.number_of_aggregates],
+               table->number_of_aggregates * sizeof(struct column_aggregates));
+    }
+    group_table_free(&old);
+}
+
+// Slot of a group value, created on first use
+static inline uint64_t group_table_slot(struct group_table *table, uint64_t key)
+{
+    if (table->array_groups > 0)
+    {
+        if (!table->used[key])
+        {
+            table->used[key] = 1;
+            table->keys[key] = key;
+            table->number_of_groups++;
+        }
+        return key;
+    }
+
+    uint64_t slot = group_table_hash(key, table->capacity);
+    while (table->used[slot] && table->keys[slot] != key)
+        slot = (slot + 1) & (table->capacity - 1);
+    if (!table->used[slot])
+    {
+        if (2 * (table->number_of_groups + 1) > table->capacity)
+        {
+            group_table_grow(table);
+            return group_table_slot(table, key);
+        }
+        table->used[slot] = 1;
+        table->keys[slot] = key;
+        table->number_of_groups++;
+    }
+    return slot;
+}
+
+/**
+ * Aggregation of n selected tuples: group_values[k] is the group of the k-th one (NULL without GROUP BY,
+ * everything goes to the group 0) and aggregate_values[a][k] its value of the a-th aggregate column
+ */
+static inline void group_table_add_vector(struct group_table *table, const uint64_t *group_values, uint64_t *const aggregate_values[], size_t n)
+{
+    if (group_values == NULL)
+    {
+        // A single group: every aggregate column is reduced in registers, then merged once
+        uint64_t slot = group_table_slot(table, 0);
+        table->counts[slot] += n;
+        for (int a = 0; a < table->number_of_aggregates; a++)
+        {
+            const uint64_t *values = aggregate_values[a];
+            struct column_aggregates vector_aggregates = {n, 0, UINT64_MAX, 0};
+            for (size_t k = 0; k < n; k++)
+            {
+                vector_aggregates.sum += values[k];
+                vector_aggregates.min = values[k] < vector_aggregates.min ? values[k] : vector_aggregates.min;
+                vector_aggregates.max = values[k] > vector_aggregates.max ? values[k] : vector_aggregates.max;
+            }
+            column_aggregates_merge(&table->aggregates[slot * table->number_of_aggregates + a], &vector_aggregates);
+        }
+        return;
+    }
+
+    // Step 1: the slot of every tuple (the hash table first makes room for n new groups: the slots must not move)
+    while (table->array_groups == 0 && 2 * (table->number_of_groups + n) > table->capacity)
+        group_table_grow(table);
+    uint32_t slots[VECTOR_SIZE];
+    for (size_t k = 0; k < n; k++)
+        slots[k] = (uint32_t)group_table_slot(table, group_values[k]);
+
+    // Step 2: COUNT(*), then every aggregate column on its own
+    for (size_t k = 0; k < n; k++)
+        table->counts[slots[k]]++;
+    for (int a = 0; a < table->number_of_aggregates; a++)
+    {
+        const uint64_t *values = aggregate_values[a];
+        struct column_aggregates *aggregates = table->aggregates + a;
+        for (size_t k = 0; k < n; k++)
+        {
+            struct column_aggregates *group = &aggregates[(size_t)slots[k] * table->number_of_aggregates];
+            group->count++;
+            group->sum += values[k];
+            group->min = values[k] < group->min ? values[k] : group->min;
+            group->max = values[k] > group->max ? values[k] : group->max;
+        }
+    }
+}
+
+static int group_table_compare_groups(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;       // (group value, slot) pairs
+    return x < y ? -1 : x > y;
+}
+
+// The slots of the groups in increasing group value (number_of_groups entries, to free)
+static inline uint64_t *group_table_sorted_slots(const struct group_table *table)
+{
+    uint64_t *pairs = malloc(2 * table->number_of_groups * sizeof(uint64_t) + (table->number_of_groups == 0));
+    if (pairs == NULL)
+    {
+        perror("Memory allocation error for the group table");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t number_of_groups = 0;
+    for (uint64_t s = 0; s < table->capacity; s++)
+        if (table->used[s])
+        {
+            pairs[2 * number_of_groups] = table->keys[s];
+            pairs[2 * number_of_groups + 1] = s;
+            number_of_groups++;
+        }
+    if (table->array_groups == 0)
+        qsort(pairs, number_of_groups, 2 * sizeof(uint64_t), group_table_compare_groups);
+    for (uint64_t g = 0; g < number_of_groups; g++)
+        pairs[g] = pairs[2 * g + 1];
+    return pairs;
+}
+
+#endif